@@ -1,53 +1,353 @@
 #include "include/AGMM.h"
+#include "include/BatchProcessor.h"
+#include "include/FramePipeline.h"
+#include "include/MaskArchive.h"
 #include <getopt.h>
+#include <sys/resource.h>
 #include <opencv2/opencv.hpp>
 
 using namespace cv;
 using namespace std;
 
+// Peak resident set size of the process so far, in megabytes
+static double peakResidentMemory()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1024.0;
+}
+
 // play video frame by frame and show the result
 int main(int argc, char **argv)
 {
     if (argc < 2)
     {
-        cout << "Usage: BackgroundSubtraction <video_path> [-s|--step]" << endl;
+        cout << "Usage: BackgroundSubtraction <video_path|file.y4m|-> [-s|--step] [-t|--threads <count>] [-p|--precision double|float|fixed16] [-P|--pipeline] [--profile <file.csv|file.json>] [--profile-interval <frames>]" << endl;
+        cout << "       [--scale 1|2|4] [--gate <block size>] [--gate-sensitivity <difference>] [--gate-reference background|previous]" << endl;
+        cout << "       [--load-model <file>] [--save-model <file>] [--archive runs|blobs|both] [--seed <seed>]" << endl;
+        cout << "       [--raw <width>x<height>[@<fps>]] [--prefilter gaussian|fixed-gaussian|box|none] [--tiles auto|<rows>]" << endl;
+        cout << "       BackgroundSubtraction -H <video|directory|list.txt>... [-o|--output <directory>] [-j|--jobs <count>] [-t|--threads <count>] [-p|--precision ...] [-P|--pipeline]" << endl;
+        cout << "       [--host] [--priority <video>=high|normal|low]..." << endl;
         return -1;
     }
 
     bool step = false;
+    bool pipelined = false;
+    bool headless = false;
+    string outputDirectory = ".";
+    int jobs = 0;
+    int threads = 0;
+    string profilePath;
+    unsigned long profileInterval = 100;
+    ModelPrecision precision = PRECISION_DOUBLE;
+    int scale = 1;
+    string loadModelPath;
+    string saveModelPath;
+    int gateBlockSize = 0;
+    double gateSensitivity = 4;
+    GateReference gateReference = GATE_BACKGROUND;
+    bool hosted = false;
+    vector<pair<string, TaskPriority>> priorities;
+    int archiveContents = 0;
+    bool seeded = false;
+    uint64 seed = 0;
+    Size rawFrameSize;
+    double rawFrameRate = 25;
+    PrefilterType prefilterType = PREFILTER_GAUSSIAN;
+    bool tiled = false;
+    int tileRows = 0;
     int c;
 
     static struct option long_options[] = {
         {"step", no_argument, NULL, 's'},
+        {"threads", required_argument, NULL, 't'},
+        {"precision", required_argument, NULL, 'p'},
+        {"pipeline", no_argument, NULL, 'P'},
+        {"headless", no_argument, NULL, 'H'},
+        {"output", required_argument, NULL, 'o'},
+        {"jobs", required_argument, NULL, 'j'},
+        {"profile", required_argument, NULL, 256},
+        {"profile-interval", required_argument, NULL, 257},
+        {"gate", required_argument, NULL, 258},
+        {"gate-sensitivity", required_argument, NULL, 259},
+        {"gate-reference", required_argument, NULL, 260},
+        {"scale", required_argument, NULL, 261},
+        {"load-model", required_argument, NULL, 262},
+        {"save-model", required_argument, NULL, 263},
+        {"host", no_argument, NULL, 264},
+        {"priority", required_argument, NULL, 265},
+        {"archive", required_argument, NULL, 266},
+        {"seed", required_argument, NULL, 267},
+        {"raw", required_argument, NULL, 268},
+        {"prefilter", required_argument, NULL, 269},
+        {"tiles", required_argument, NULL, 270},
         {NULL, 0, NULL, 0}};
 
-    while ((c = getopt_long(argc, argv, "s", long_options, NULL)) != -1)
+    while ((c = getopt_long(argc, argv, "st:p:PHo:j:", long_options, NULL)) != -1)
     {
         switch (c)
         {
         case 's':
             step = true;
             break;
+        case 't':
+            threads = atoi(optarg);
+            break;
+        case 'p':
+            if (string(optarg) == "float")
+            {
+                precision = PRECISION_FLOAT;
+            }
+            else if (string(optarg) == "fixed16")
+            {
+                precision = PRECISION_FIXED16;
+            }
+            break;
+        case 'P':
+            pipelined = true;
+            break;
+        case 'H':
+            headless = true;
+            break;
+        case 'o':
+            outputDirectory = optarg;
+            break;
+        case 'j':
+            jobs = atoi(optarg);
+            break;
+        case 256:
+            profilePath = optarg;
+            break;
+        case 257:
+            profileInterval = strtoul(optarg, NULL, 10);
+            break;
+        case 258:
+            gateBlockSize = atoi(optarg);
+            break;
+        case 259:
+            gateSensitivity = atof(optarg);
+            break;
+        case 260:
+            gateReference = string(optarg) == "previous" ? GATE_PREVIOUS_FRAME : GATE_BACKGROUND;
+            break;
+        case 261:
+            scale = atoi(optarg);
+            break;
+        case 262:
+            loadModelPath = optarg;
+            break;
+        case 263:
+            saveModelPath = optarg;
+            break;
+        case 264:
+            hosted = true;
+            break;
+        case 265:
+        {
+            string argument = optarg;
+            size_t separator = argument.find_last_of('=');
+            if (separator == string::npos)
+            {
+                cout << "Error: Priority must be given as <video>=high|normal|low." << endl;
+                return -1;
+            }
+
+            string level = argument.substr(separator + 1);
+            TaskPriority priority = level == "high" ? PRIORITY_HIGH : level == "low" ? PRIORITY_LOW
+                                                                                     : PRIORITY_NORMAL;
+            priorities.push_back(make_pair(argument.substr(0, separator), priority));
+            break;
+        }
+        case 266:
+            if (string(optarg) == "runs")
+            {
+                archiveContents = ARCHIVE_RUNS;
+            }
+            else if (string(optarg) == "blobs")
+            {
+                archiveContents = ARCHIVE_BLOBS;
+            }
+            else if (string(optarg) == "both")
+            {
+                archiveContents = ARCHIVE_RUNS | ARCHIVE_BLOBS;
+            }
+            else
+            {
+                cout << "Error: Archive must be runs, blobs or both." << endl;
+                return -1;
+            }
+            break;
+        case 267:
+            seeded = true;
+            seed = strtoull(optarg, NULL, 10);
+            break;
+        case 268:
+            if (sscanf(optarg, "%dx%d@%lf", &rawFrameSize.width, &rawFrameSize.height, &rawFrameRate) < 2 || rawFrameSize.empty())
+            {
+                cout << "Error: Raw frame size must be given as <width>x<height>[@<fps>]." << endl;
+                return -1;
+            }
+            break;
+        case 269:
+            if (string(optarg) == "gaussian")
+            {
+                prefilterType = PREFILTER_GAUSSIAN;
+            }
+            else if (string(optarg) == "fixed-gaussian")
+            {
+                prefilterType = PREFILTER_FIXED_GAUSSIAN;
+            }
+            else if (string(optarg) == "box")
+            {
+                prefilterType = PREFILTER_BOX;
+            }
+            else if (string(optarg) == "none")
+            {
+                prefilterType = PREFILTER_NONE;
+            }
+            else
+            {
+                cout << "Error: Prefilter must be gaussian, fixed-gaussian, box or none." << endl;
+                return -1;
+            }
+            break;
+        case 270:
+            tiled = true;
+            tileRows = string(optarg) == "auto" ? 0 : atoi(optarg);
+            break;
         default:
             break;
         }
     }
 
-    AGMM agmm(argv[optind]);
-    agmm.initializeModel(10);
+    if (headless)
+    {
+        vector<string> videoPaths;
+        for (int i = optind; i < argc; i++)
+        {
+            vector<string> expanded = BatchProcessor::expandVideoPaths(argv[i]);
+            videoPaths.insert(videoPaths.end(), expanded.begin(), expanded.end());
+        }
+
+        // Without --threads the cores are shared between the jobs
+        BatchProcessor batch(videoPaths, outputDirectory, jobs);
+        batch.setThreadsPerJob(threads);
+        batch.setModelPrecision(precision);
+        batch.setPipelined(pipelined);
+        batch.setPyramidScale(scale);
+        batch.setCheckpoint(loadModelPath);
+        batch.setChangeGating(gateBlockSize, gateSensitivity, gateReference);
+        batch.setHosted(hosted);
+        batch.setArchive(archiveContents);
+        batch.setRawFrameSize(rawFrameSize, rawFrameRate);
+        batch.setPrefilter(prefilterType);
+        batch.setTiling(tiled, tileRows);
+        if (seeded)
+        {
+            batch.setRandomSeed(seed);
+        }
+        for (const pair<string, TaskPriority> &priority : priorities)
+        {
+            batch.setPriority(priority.first, priority.second);
+        }
+        if (!profilePath.empty())
+        {
+            batch.setProfiling(profilePath.size() >= 5 && profilePath.compare(profilePath.size() - 5, 5, ".json") == 0 ? "json" : "csv", profileInterval);
+        }
 
-    Mat frame, foregroundMask, foregroundMaskBGR, foregroundImage, combinedFrame, resizedFrame;
+        int failures = 0;
+        for (const BatchResult &result : batch.run())
+        {
+            if (result.succeeded)
+            {
+                cout << result.videoPath << " -> " << result.outputPath << ": " << result.frames << " frames, "
+                     << result.seconds << " s, " << result.frames / max(result.seconds, 1e-9) << " fps";
+                if (result.meanFrameTime > 0)
+                {
+                    cout << ", frame time " << result.meanFrameTime << " ms mean, " << result.maximumFrameTime << " ms max";
+                }
+                if (gateBlockSize > 0)
+                {
+                    cout << ", " << result.skippedBlockFraction * 100 << " % of blocks skipped";
+                }
+                cout << endl;
+            }
+            else
+            {
+                cout << result.videoPath << ": failed" << endl;
+                failures++;
+            }
+        }
+
+        return failures > 0 ? 1 : 0;
+    }
+
+    threads = max(threads, 1);
+    if (threads > 1)
+    {
+        setNumThreads(threads);
+    }
+
+    int64 startTicks = getTickCount();
+
+    AGMM agmm(argv[optind], rawFrameSize, rawFrameRate);
+    if (!agmm.isOpened())
+    {
+        return -1;
+    }
+    agmm.setNumberOfThreads(threads);
+    agmm.setModelPrecision(precision);
+    agmm.setPyramidScale(scale);
+    agmm.setChangeGating(gateBlockSize, gateSensitivity, gateReference);
+    agmm.setPrefilter(prefilterType);
+    agmm.setTiling(tiled, tileRows);
+    if (seeded)
+    {
+        agmm.setRandomSeed(seed);
+    }
+
+    // A checkpoint of the same camera replaces the initialization frames
+    if (!loadModelPath.empty())
+    {
+        if (!agmm.loadCheckpoint(loadModelPath))
+        {
+            return -1;
+        }
+    }
+    else
+    {
+        agmm.initializeModel(10);
+        if (!agmm.isOpened())
+        {
+            return -1;
+        }
+    }
+
+    StageProfiler profiler;
+    if (!profilePath.empty())
+    {
+        profiler.setExport(profilePath, profileInterval);
+        agmm.setProfiler(&profiler);
+    }
+
+    double initializationTime = (getTickCount() - startTicks) * 1000 / getTickFrequency();
+    bool isFirstMask = true;
+
+    Mat foregroundMaskBGR, combinedFrame, resizedFrame;
 
     VideoWriter videoWriter;
+    MaskArchiveWriter archiveWriter;
     bool isVideoWriterInitialized = false;
 
-    while (true)
+    // Show and encode or archive one result, returns false when the user quits
+    auto display = [&](const Mat &frame, const Mat &foregroundMask, const vector<Blob> &blobs)
     {
-        tie(foregroundMask, foregroundImage, frame) = agmm.processNextFrame();
-
-        if (frame.empty())
+        if (isFirstMask)
         {
-            break;
+            double firstMaskTime = (getTickCount() - startTicks) * 1000 / getTickFrequency();
+            cout << "Initialization: " << initializationTime << " ms, first mask: " << firstMaskTime
+                 << " ms, peak RSS: " << peakResidentMemory() << " MB" << endl;
+            isFirstMask = false;
         }
 
         cvtColor(foregroundMask, foregroundMaskBGR, COLOR_GRAY2BGR);
@@ -56,11 +356,25 @@ int main(int argc, char **argv)
 
         if (!isVideoWriterInitialized && !step)
         {
-            videoWriter.open("output.avi", VideoWriter::fourcc('x', '2', '6', '4'), 25, resizedFrame.size());
+            if (archiveContents != 0)
+            {
+                if (!archiveWriter.open("output.masks", foregroundMask.rows, foregroundMask.cols, agmm.getFrameRate(), archiveContents))
+                {
+                    cout << "Error: " << archiveWriter.getError() << endl;
+                }
+            }
+            else
+            {
+                videoWriter.open("output.avi", VideoWriter::fourcc('x', '2', '6', '4'), 25, resizedFrame.size());
+            }
             isVideoWriterInitialized = true;
         }
 
-        if (!step)
+        if (!step && archiveWriter.isOpened())
+        {
+            archiveWriter.write(foregroundMask, blobs);
+        }
+        else if (!step)
         {
             videoWriter.write(resizedFrame);
         }
@@ -68,16 +382,48 @@ int main(int argc, char **argv)
         imshow("Background Subtraction", resizedFrame);
 
         int key = waitKey(step ? 0 : 30);
-        if (key == 27)
+        return key != 27;
+    };
+
+    if (pipelined)
+    {
+        FramePipeline pipeline(agmm);
+        pipeline.run([&](PipelineFrame &item)
+                     { return display(item.frame, item.mask, item.blobs); });
+
+        for (const PipelineStageStats &stage : pipeline.getStats())
         {
-            break;
+            cout << stage.name << ": " << stage.frames << " frames, busy " << stage.busyTime
+                 << " s, waiting " << stage.inputWaitTime << " s, stalled " << stage.outputStallTime
+                 << " s, queue depth " << stage.maximumQueueDepth << "/" << stage.queueCapacity << endl;
         }
-        else if (step && key == 32)
+    }
+    else
+    {
+        // The outputs are allocated on the first frame and written in place afterwards
+        Mat frame, foregroundMask, foregroundImage;
+        vector<Blob> blobs;
+        while (agmm.readFrame(frame) && agmm.processFrame(frame, foregroundMask, foregroundImage, &blobs))
         {
-            continue;
+            if (!display(frame, foregroundMask, blobs))
+            {
+                break;
+            }
         }
     }
 
+    if (gateBlockSize > 0)
+    {
+        cout << "Skipped blocks: " << agmm.getSkippedBlockFraction() * 100 << " %" << endl;
+    }
+
+    if (!saveModelPath.empty())
+    {
+        agmm.saveCheckpoint(saveModelPath);
+    }
+
+    profiler.flush();
     videoWriter.release();
+    archiveWriter.close();
     return 0;
 }
@@ -0,0 +1,1226 @@
+#include "include/AGMM.h"
+#include "include/Mixture.h"
+#include "include/SyntheticScene.h"
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <getopt.h>
+#include <new>
+#include <opencv2/opencv.hpp>
+
+using namespace cv;
+using namespace std;
+
+// Heap allocations through operator new, which covers the standard containers
+static atomic<unsigned long long> heapAllocations(0);
+
+void *operator new(size_t size)
+{
+    heapAllocations++;
+    if (void *pointer = malloc(max<size_t>(size, 1)))
+    {
+        return pointer;
+    }
+    throw bad_alloc();
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *pointer) noexcept
+{
+    free(pointer);
+}
+
+void operator delete[](void *pointer) noexcept
+{
+    free(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept
+{
+    free(pointer);
+}
+
+void operator delete[](void *pointer, size_t) noexcept
+{
+    free(pointer);
+}
+
+/**
+ * Counts the matrix buffers OpenCV allocates and hands the work to its default allocator,
+ * which also frees them.
+ */
+class CountingMatAllocator : public MatAllocator
+{
+private:
+    MatAllocator *allocator = Mat::getStdAllocator();
+
+public:
+    mutable atomic<unsigned long long> allocations{0};
+
+    UMatData *allocate(int dims, const int *sizes, int type, void *data, size_t *step, AccessFlag flags, UMatUsageFlags usageFlags) const override
+    {
+        // Headers on existing data do not allocate a buffer
+        if (data == nullptr)
+        {
+            this->allocations++;
+        }
+        return this->allocator->allocate(dims, sizes, type, data, step, flags, usageFlags);
+    }
+
+    bool allocate(UMatData *data, AccessFlag accessFlags, UMatUsageFlags usageFlags) const override
+    {
+        return this->allocator->allocate(data, accessFlags, usageFlags);
+    }
+
+    void deallocate(UMatData *data) const override
+    {
+        this->allocator->deallocate(data);
+    }
+};
+
+static CountingMatAllocator matAllocator;
+
+/**
+ * Access to the individual stages of AGMM for timing.
+ */
+class AGMMBenchmark
+{
+public:
+    static void backgroundMaintenance(AGMM &agmm, const Mat &frame, Mat &foregroundMask)
+    {
+        agmm.backgroundMaintenance(frame, foregroundMask);
+    }
+
+    static void shadowDetection(const AGMM &agmm, const Mat &frame, const Mat &foregroundMask, Mat &background, Mat &mask)
+    {
+        agmm.copyBackground(background);
+        agmm.shadowDetection(frame, background, foregroundMask, mask, nullptr);
+    }
+
+    static void maskCleaner(const AGMM &agmm, Mat &mask, vector<Blob> &blobs)
+    {
+        agmm.maskCleaner(mask, &blobs);
+    }
+
+    static void reduceFrame(AGMM &agmm, const Mat &frame, Mat &reducedFrame)
+    {
+        agmm.reduceFrame(frame, reducedFrame);
+    }
+};
+
+/**
+ * Per-frame times of one measured stage.
+ */
+struct StageTimes
+{
+    string name;
+    // Pixels handled per call, for the time per pixel
+    size_t pixels;
+    vector<double> milliseconds;
+};
+
+template <typename Function>
+static double timeMilliseconds(Function function)
+{
+    int64 startTicks = getTickCount();
+    function();
+    return (getTickCount() - startTicks) * 1000 / getTickFrequency();
+}
+
+static double median(vector<double> values)
+{
+    if (values.empty())
+    {
+        return 0;
+    }
+
+    sort(values.begin(), values.end());
+    size_t middle = values.size() / 2;
+    return values.size() % 2 == 1 ? values[middle] : (values[middle - 1] + values[middle]) / 2;
+}
+
+static void writeStage(ostream &out, const StageTimes &stage, bool last)
+{
+    double total = 0;
+    double minimum = stage.milliseconds.empty() ? 0 : stage.milliseconds[0];
+    for (double value : stage.milliseconds)
+    {
+        total += value;
+        minimum = min(minimum, value);
+    }
+    double mean = stage.milliseconds.empty() ? 0 : total / stage.milliseconds.size();
+
+    out << "        \"" << stage.name << "\": {\"mean_ms\": " << mean << ", \"median_ms\": " << median(stage.milliseconds)
+        << ", \"min_ms\": " << minimum << ", \"ns_per_pixel\": " << mean * 1e6 / max<size_t>(stage.pixels, 1)
+        << ", \"pixels\": " << stage.pixels << "}" << (last ? "" : ",") << "\n";
+}
+
+// Measure every stage on a synthetic scene of the given size and append the JSON object of the run
+static void benchmarkResolution(ostream &out, Size resolution, int frames, int warmup, int threads, ModelPrecision precision, MixtureKernelType kernel, PrefilterType prefilter, uint64 seed, unsigned int referencePixels, bool last)
+{
+    const int rows = resolution.height;
+    const int cols = resolution.width;
+    const double backgroundRatio = 0.9;
+
+    SyntheticScene scene(rows, cols, seed);
+
+    vector<Mat> initializationFrames(10);
+    for (Mat &frame : initializationFrames)
+    {
+        scene.nextFrame(frame);
+    }
+
+    // One instance is timed stage by stage, the other through processFrame
+    AGMM stages(rows, cols);
+    AGMM endToEnd(rows, cols);
+    for (AGMM *agmm : {&stages, &endToEnd})
+    {
+        agmm->setNumberOfThreads(threads);
+        agmm->setModelPrecision(precision);
+        agmm->setMixtureKernel(kernel);
+        agmm->setPrefilter(prefilter);
+        agmm->setRandomSeed(seed);
+        agmm->initializeModel(initializationFrames);
+    }
+
+    // The original per-pixel objects are slow, so only the first pixels are timed. That the model
+    // computes the same as these objects is checked by --check-kernels.
+    unsigned int referenceCount = min(referencePixels, static_cast<unsigned int>(rows * cols));
+    vector<Mixture> reference(referenceCount, Mixture(7, 0.001, 36, 8));
+    Mat blurred;
+    vector<Mat> blurredFrames(initializationFrames.size());
+    for (size_t f = 0; f < initializationFrames.size(); f++)
+    {
+        GaussianBlur(initializationFrames[f], blurredFrames[f], Size(9, 9), 2, 2);
+    }
+    vector<Vec3b> samples(initializationFrames.size());
+    RNG rng(seed);
+    for (unsigned int p = 0; p < referenceCount; p++)
+    {
+        for (size_t f = 0; f < blurredFrames.size(); f++)
+        {
+            samples[f] = blurredFrames[f].at<Vec3b>(p / cols, p % cols);
+        }
+        reference[p].initializeMixture(samples, rng);
+    }
+
+    StageTimes updateMixture = {"Mixture::updateMixture", referenceCount, {}};
+    StageTimes backgroundMaintenance = {"backgroundMaintenance", static_cast<size_t>(rows * cols), {}};
+    StageTimes shadowDetection = {"shadowDetection", static_cast<size_t>(rows * cols), {}};
+    StageTimes maskCleaner = {"maskCleaner", static_cast<size_t>(rows * cols), {}};
+    StageTimes processFrame = {"processFrame", static_cast<size_t>(rows * cols), {}};
+
+    // Allocations of processFrame are counted after the warmup, with outputs reused across frames
+    unsigned long long matAllocations = 0;
+    unsigned long long processFrameAllocations = 0;
+
+    Mat frame, foregroundMask, background, mask, cleanedMask, result;
+    vector<Blob> blobs, endToEndBlobs;
+    for (int i = 0; i < warmup + frames; i++)
+    {
+        scene.nextFrame(frame);
+        GaussianBlur(frame, blurred, Size(9, 9), 2, 2);
+        bool measured = i >= warmup;
+
+        double time = timeMilliseconds([&]()
+                                       {
+            for (unsigned int p = 0; p < referenceCount; p++)
+            {
+                reference[p].updateMixture(blurred.at<Vec3b>(p / cols, p % cols), backgroundRatio);
+            } });
+        if (measured)
+        {
+            updateMixture.milliseconds.push_back(time);
+        }
+
+        time = timeMilliseconds([&]()
+                                { AGMMBenchmark::backgroundMaintenance(stages, frame, foregroundMask); });
+        if (measured)
+        {
+            backgroundMaintenance.milliseconds.push_back(time);
+        }
+
+        // shadowDetection ends with maskCleaner, as in the pipeline
+        time = timeMilliseconds([&]()
+                                { AGMMBenchmark::shadowDetection(stages, frame, foregroundMask, background, mask); });
+        if (measured)
+        {
+            shadowDetection.milliseconds.push_back(time);
+        }
+
+        foregroundMask.copyTo(cleanedMask);
+        time = timeMilliseconds([&]()
+                                { AGMMBenchmark::maskCleaner(stages, cleanedMask, blobs); });
+        if (measured)
+        {
+            maskCleaner.milliseconds.push_back(time);
+        }
+
+        unsigned long long matAllocationsBefore = matAllocator.allocations;
+        unsigned long long heapAllocationsBefore = heapAllocations;
+        time = timeMilliseconds([&]()
+                                { endToEnd.processFrame(frame, mask, result, &endToEndBlobs); });
+        // Read before the time is stored, the vector of times grows now and then
+        unsigned long long matAllocationsAfter = matAllocator.allocations;
+        unsigned long long heapAllocationsAfter = heapAllocations;
+        if (measured)
+        {
+            processFrame.milliseconds.push_back(time);
+            matAllocations += matAllocationsAfter - matAllocationsBefore;
+            processFrameAllocations += heapAllocationsAfter - heapAllocationsBefore;
+        }
+    }
+
+    double meanFrameTime = 0;
+    for (double value : processFrame.milliseconds)
+    {
+        meanFrameTime += value / processFrame.milliseconds.size();
+    }
+    double framesPerSecond = meanFrameTime > 0 ? 1000 / meanFrameTime : 0;
+
+    cout << cols << "x" << rows << ": " << framesPerSecond << " fps, background maintenance " << median(backgroundMaintenance.milliseconds)
+         << " ms, shadow detection " << median(shadowDetection.milliseconds) << " ms, mask cleaner " << median(maskCleaner.milliseconds) << " ms" << endl;
+    cout << "    per frame after warmup: " << static_cast<double>(matAllocations) / frames << " matrix buffers, "
+         << static_cast<double>(processFrameAllocations) / frames << " other heap allocations" << endl;
+
+    out << "    {\n";
+    out << "      \"width\": " << cols << ",\n";
+    out << "      \"height\": " << rows << ",\n";
+    out << "      \"kernel\": \"" << getMixtureKernelName(stages.getMixtureKernel()) << "\",\n";
+    out << "      \"fps\": " << framesPerSecond << ",\n";
+    out << "      \"mat_allocations_per_frame\": " << static_cast<double>(matAllocations) / frames << ",\n";
+    out << "      \"heap_allocations_per_frame\": " << static_cast<double>(processFrameAllocations) / frames << ",\n";
+    out << "      \"stages\": {\n";
+    writeStage(out, updateMixture, false);
+    writeStage(out, backgroundMaintenance, false);
+    writeStage(out, shadowDetection, false);
+    writeStage(out, maskCleaner, false);
+    writeStage(out, processFrame, true);
+    out << "      }\n";
+    out << "    }" << (last ? "" : ",") << "\n";
+}
+
+// Count the matrix buffers and other heap allocations processFrame makes per frame after the
+// warmup, with its outputs and blob list reused
+static void countAllocations(Size resolution, int frames, int warmup, int threads, ModelPrecision precision, MixtureKernelType kernel, PrefilterType prefilter, int scale, uint64 seed, double &matAllocations, double &otherAllocations)
+{
+    SyntheticScene scene(resolution.height, resolution.width, seed);
+    vector<Mat> initializationFrames(10);
+    for (Mat &frame : initializationFrames)
+    {
+        scene.nextFrame(frame);
+    }
+
+    AGMM agmm(resolution.height, resolution.width);
+    agmm.setNumberOfThreads(threads);
+    agmm.setModelPrecision(precision);
+    agmm.setMixtureKernel(kernel);
+    agmm.setPrefilter(prefilter);
+    agmm.setPyramidScale(scale);
+    agmm.setRandomSeed(seed);
+    agmm.initializeModel(initializationFrames);
+
+    unsigned long long matCount = 0;
+    unsigned long long heapCount = 0;
+    Mat frame, mask, result;
+    vector<Blob> blobs;
+    for (int i = 0; i < warmup + frames; i++)
+    {
+        scene.nextFrame(frame);
+        unsigned long long matAllocationsBefore = matAllocator.allocations;
+        unsigned long long heapAllocationsBefore = heapAllocations;
+        agmm.processFrame(frame, mask, result, &blobs);
+        if (i >= warmup)
+        {
+            matCount += matAllocator.allocations - matAllocationsBefore;
+            heapCount += heapAllocations - heapAllocationsBefore;
+        }
+    }
+
+    matAllocations = static_cast<double>(matCount) / frames;
+    otherAllocations = static_cast<double>(heapCount) / frames;
+}
+
+// Check that processFrame does not allocate after the warmup, with the given prefilter and the
+// fixed-point Gaussian, each at full size and with --scale 2. A configuration that runs code
+// known to allocate inside OpenCV is reported as an expected failure with those sites.
+static bool checkFrameAllocations(const vector<Size> &resolutions, int frames, int warmup, int threads, ModelPrecision precision, MixtureKernelType kernel, PrefilterType prefilter, uint64 seed)
+{
+    vector<PrefilterType> prefilters = {prefilter};
+    if (prefilter != PREFILTER_FIXED_GAUSSIAN)
+    {
+        prefilters.push_back(PREFILTER_FIXED_GAUSSIAN);
+    }
+
+    bool passed = true;
+    for (Size resolution : resolutions)
+    {
+        for (int scale : {1, 2})
+        {
+            for (PrefilterType type : prefilters)
+            {
+                vector<string> sites;
+                if (type == PREFILTER_GAUSSIAN)
+                {
+                    sites.push_back("GaussianBlur builds its filter on every call");
+                }
+                else if (type == PREFILTER_BOX)
+                {
+                    sites.push_back("blur builds its filter on every call");
+                }
+                if (scale > 1)
+                {
+                    sites.push_back("resize allocates inside OpenCV");
+                }
+                if (threads > 1)
+                {
+                    sites.push_back("OpenCV's thread pool may allocate, depending on the build");
+                }
+
+                double matAllocations = 0;
+                double otherAllocations = 0;
+                countAllocations(resolution, frames, warmup, threads, precision, kernel, type, scale, seed, matAllocations, otherAllocations);
+
+                bool allocated = matAllocations > 0 || otherAllocations > 0;
+                cout << "allocations " << resolution.width << "x" << resolution.height << ", " << getPrefilterName(type) << ", scale " << scale
+                     << ": " << matAllocations << " matrix buffers, " << otherAllocations << " other heap allocations per frame";
+                if (!allocated)
+                {
+                    cout << endl;
+                }
+                else if (!sites.empty())
+                {
+                    cout << ", expected failure:";
+                    for (size_t s = 0; s < sites.size(); s++)
+                    {
+                        cout << (s > 0 ? "; " : " ") << sites[s];
+                    }
+                    cout << endl;
+                }
+                else
+                {
+                    cout << " FAILED" << endl;
+                    passed = false;
+                }
+            }
+        }
+    }
+
+    return passed;
+}
+
+// Time every prefilter on the same synthetic scene and score its masks against the ground truth
+static void benchmarkPrefilters(ostream &out, Size resolution, int frames, int warmup, int threads, ModelPrecision precision, MixtureKernelType kernel, uint64 seed, bool last)
+{
+    const int rows = resolution.height;
+    const int cols = resolution.width;
+    const PrefilterType types[] = {PREFILTER_GAUSSIAN, PREFILTER_FIXED_GAUSSIAN, PREFILTER_BOX, PREFILTER_NONE};
+    const size_t numberOfTypes = sizeof(types) / sizeof(types[0]);
+
+    for (size_t t = 0; t < numberOfTypes; t++)
+    {
+        // Every filter sees the same frames
+        SyntheticScene scene(rows, cols, seed);
+        vector<Mat> initializationFrames(10);
+        for (Mat &frame : initializationFrames)
+        {
+            scene.nextFrame(frame);
+        }
+
+        AGMM agmm(rows, cols);
+        agmm.setNumberOfThreads(threads);
+        agmm.setModelPrecision(precision);
+        agmm.setMixtureKernel(kernel);
+        agmm.setPrefilter(types[t]);
+        agmm.setRandomSeed(seed);
+        agmm.initializeModel(initializationFrames);
+
+        StageTimes prefilter = {"prefilter", static_cast<size_t>(rows * cols), {}};
+        StageTimes processFrame = {"processFrame", static_cast<size_t>(rows * cols), {}};
+        double truePositives = 0, falsePositives = 0, falseNegatives = 0;
+
+        Mat frame, groundTruth, reduced, mask, result, overlap;
+        for (int i = 0; i < warmup + frames; i++)
+        {
+            scene.nextFrame(frame, &groundTruth);
+            bool measured = i >= warmup;
+
+            double time = timeMilliseconds([&]()
+                                           { AGMMBenchmark::reduceFrame(agmm, frame, reduced); });
+            if (measured)
+            {
+                prefilter.milliseconds.push_back(time);
+            }
+
+            time = timeMilliseconds([&]()
+                                    { agmm.processFrame(frame, mask, result); });
+            if (measured)
+            {
+                processFrame.milliseconds.push_back(time);
+
+                bitwise_and(mask, groundTruth, overlap);
+                int hits = countNonZero(overlap);
+                truePositives += hits;
+                falsePositives += countNonZero(mask) - hits;
+                falseNegatives += countNonZero(groundTruth) - hits;
+            }
+        }
+
+        double precisionScore = truePositives + falsePositives > 0 ? truePositives / (truePositives + falsePositives) : 0;
+        double recall = truePositives + falseNegatives > 0 ? truePositives / (truePositives + falseNegatives) : 0;
+        double f1 = precisionScore + recall > 0 ? 2 * precisionScore * recall / (precisionScore + recall) : 0;
+
+        cout << cols << "x" << rows << " " << getPrefilterName(types[t]) << ": prefilter " << median(prefilter.milliseconds)
+             << " ms, processFrame " << median(processFrame.milliseconds) << " ms, precision " << precisionScore
+             << ", recall " << recall << ", F1 " << f1 << endl;
+
+        out << "    {\n";
+        out << "      \"width\": " << cols << ",\n";
+        out << "      \"height\": " << rows << ",\n";
+        out << "      \"prefilter\": \"" << getPrefilterName(types[t]) << "\",\n";
+        out << "      \"precision\": " << precisionScore << ",\n";
+        out << "      \"recall\": " << recall << ",\n";
+        out << "      \"f1\": " << f1 << ",\n";
+        out << "      \"stages\": {\n";
+        writeStage(out, prefilter, false);
+        writeStage(out, processFrame, true);
+        out << "      }\n";
+        out << "    }" << (last && t + 1 == numberOfTypes ? "" : ",") << "\n";
+    }
+}
+
+// Time processFrame stage by stage and band by band on the same frames and count the mask pixels they disagree on
+static void benchmarkTiling(ostream &out, Size resolution, int frames, int warmup, int threads, ModelPrecision precision, MixtureKernelType kernel, uint64 seed, bool last)
+{
+    const int rows = resolution.height;
+    const int cols = resolution.width;
+    const PrefilterType types[] = {PREFILTER_GAUSSIAN, PREFILTER_FIXED_GAUSSIAN};
+    const size_t numberOfTypes = sizeof(types) / sizeof(types[0]);
+
+    for (size_t t = 0; t < numberOfTypes; t++)
+    {
+        SyntheticScene scene(rows, cols, seed);
+        vector<Mat> initializationFrames(10);
+        for (Mat &frame : initializationFrames)
+        {
+            scene.nextFrame(frame);
+        }
+
+        AGMM staged(rows, cols);
+        AGMM tiled(rows, cols);
+        for (AGMM *agmm : {&staged, &tiled})
+        {
+            agmm->setNumberOfThreads(threads);
+            agmm->setModelPrecision(precision);
+            agmm->setMixtureKernel(kernel);
+            agmm->setPrefilter(types[t]);
+            agmm->setRandomSeed(seed);
+            agmm->initializeModel(initializationFrames);
+        }
+        tiled.setTiling(true);
+
+        StageTimes stagedFrame = {"processFrame", static_cast<size_t>(rows * cols), {}};
+        StageTimes tiledFrame = {"processFrame_tiled", static_cast<size_t>(rows * cols), {}};
+        unsigned long long mismatchedPixels = 0;
+
+        Mat frame, stagedMask, stagedResult, tiledMask, tiledResult, difference;
+        for (int i = 0; i < warmup + frames; i++)
+        {
+            scene.nextFrame(frame);
+            bool measured = i >= warmup;
+
+            double time = timeMilliseconds([&]()
+                                           { staged.processFrame(frame, stagedMask, stagedResult); });
+            if (measured)
+            {
+                stagedFrame.milliseconds.push_back(time);
+            }
+
+            time = timeMilliseconds([&]()
+                                    { tiled.processFrame(frame, tiledMask, tiledResult); });
+            if (measured)
+            {
+                tiledFrame.milliseconds.push_back(time);
+            }
+
+            compare(stagedMask, tiledMask, difference, CMP_NE);
+            mismatchedPixels += countNonZero(difference);
+        }
+
+        cout << cols << "x" << rows << " " << getPrefilterName(types[t]) << ": processFrame " << median(stagedFrame.milliseconds)
+             << " ms stage by stage, " << median(tiledFrame.milliseconds) << " ms in bands of " << tiled.getTileRows() << " rows, "
+             << mismatchedPixels << " mask pixels differ" << endl;
+
+        out << "    {\n";
+        out << "      \"width\": " << cols << ",\n";
+        out << "      \"height\": " << rows << ",\n";
+        out << "      \"prefilter\": \"" << getPrefilterName(types[t]) << "\",\n";
+        out << "      \"tile_rows\": " << tiled.getTileRows() << ",\n";
+        out << "      \"mismatched_pixels\": " << mismatchedPixels << ",\n";
+        out << "      \"stages\": {\n";
+        writeStage(out, stagedFrame, false);
+        writeStage(out, tiledFrame, true);
+        out << "      }\n";
+        out << "    }" << (last && t + 1 == numberOfTypes ? "" : ",") << "\n";
+    }
+}
+
+// Largest difference between the planes of two models, relative to the range of each plane
+static double compareModels(const MixtureModel &a, const MixtureModel &b)
+{
+    double lowerbound = a.getLowerboundVariance();
+    double upperbound = a.getUpperboundVariance();
+    double difference = 0;
+    for (unsigned int p = 0; p < a.getNumberOfPixels(); p++)
+    {
+        for (int k = 0; k < a.getNumberOfGaussians(); k++)
+        {
+            difference = max(difference, fabs(a.getMeanB(p, k) - b.getMeanB(p, k)) / 255);
+            difference = max(difference, fabs(a.getMeanG(p, k) - b.getMeanG(p, k)) / 255);
+            difference = max(difference, fabs(a.getMeanR(p, k) - b.getMeanR(p, k)) / 255);
+            difference = max(difference, fabs(a.getVariance(p, k) - b.getVariance(p, k)) / (5 * upperbound));
+            difference = max(difference, fabs(a.getWeight(p, k) - b.getWeight(p, k)));
+            difference = max(difference, fabs(a.getWeightDistrRatio(p, k) - b.getWeightDistrRatio(p, k)) * sqrt(lowerbound));
+        }
+    }
+    return difference;
+}
+
+// Copy the components of a pixel of a model into Gaussian objects, as the original Mixture holds them
+static vector<Gaussian> getGaussians(const MixtureModel &model, unsigned int pixel)
+{
+    vector<Gaussian> gaussians;
+    for (int k = 0; k < model.getNumberOfGaussians(); k++)
+    {
+        Gaussian gaussian(model.getMeanB(pixel, k), model.getMeanG(pixel, k), model.getMeanR(pixel, k), model.getLowerboundVariance(), model.getUpperboundVariance(), model.getWeight(pixel, k));
+        gaussian.setVariance(model.getVariance(pixel, k));
+        gaussian.setWeightDistrRatio(model.getWeightDistrRatio(pixel, k));
+        gaussians.push_back(gaussian);
+    }
+    return gaussians;
+}
+
+// Largest difference between the components of a pixel in a model and the closest components in a Mixture,
+// relative to the range of each parameter. Components of almost the same ratio may be sorted either way.
+static double compareMixture(const MixtureModel &model, unsigned int pixel, const vector<Gaussian> &gaussians)
+{
+    double upperbound = model.getUpperboundVariance();
+    vector<bool> matched(gaussians.size(), false);
+    double difference = 0;
+    for (int k = 0; k < model.getNumberOfGaussians(); k++)
+    {
+        double closest = numeric_limits<double>::max();
+        int match = 0;
+        for (size_t g = 0; g < gaussians.size(); g++)
+        {
+            if (matched[g])
+            {
+                continue;
+            }
+
+            Gaussian gaussian = gaussians[g];
+            double componentDifference = fabs(model.getMeanB(pixel, k) - gaussian.getMeanB()) / 255;
+            componentDifference = max(componentDifference, fabs(model.getMeanG(pixel, k) - gaussian.getMeanG()) / 255);
+            componentDifference = max(componentDifference, fabs(model.getMeanR(pixel, k) - gaussian.getMeanR()) / 255);
+            componentDifference = max(componentDifference, fabs(model.getVariance(pixel, k) - gaussian.getVariance()) / (5 * upperbound));
+            componentDifference = max(componentDifference, fabs(model.getWeight(pixel, k) - gaussian.getWeight()));
+            if (componentDifference < closest)
+            {
+                closest = componentDifference;
+                match = g;
+            }
+        }
+        matched[match] = true;
+        difference = max(difference, closest);
+    }
+    return difference;
+}
+
+// Run the original Mixture objects, and MixtureModel with the scalar update and every vectorized kernel
+// the CPU has, on the same pixels and compare every update and the masks of the whole run
+static bool checkMixture(int frames, uint64 seed)
+{
+    const int rows = 48;
+    const int cols = 97;
+    const unsigned int numberOfPixels = rows * cols;
+    const double alpha = 0.01;
+    const double threshold = 0.9;
+
+    // Every update of the model is repeated by a Mixture holding the same components, decoded.
+    // The decision is computed the same way and must match. The updated components are rounded
+    // to the precision of the planes, 6e-8 of a float value and at most 4.3e-5 of the range of a
+    // fixed16 plane, and in the kernels the exponential is off by about 1e-13.
+    const double componentTolerance[] = {1e-12, 1e-7, 5e-5};
+
+    // Over the whole run, seeded with the same samples, rounded ratios can swap two components of
+    // almost the same ratio and pixels close to a bound can match another component, so a few
+    // pixels follow their own course. Masks may differ in this fraction of the pixels. In fixed16
+    // the share grows with the length of the run, to about 4e-3 after 1000 frames.
+    const double maskTolerance[] = {1e-4, 1e-4, 1e-2};
+
+    bool passed = true;
+    for (int numberOfGaussians : {3, 5, 7})
+    {
+        // Every pixel keeps a colour with some noise, and now and then shows another or moves to it
+        RNG rng(seed);
+        vector<Mixture> reference(numberOfPixels, Mixture(numberOfGaussians, alpha, 36, 8));
+        vector<Vec3b> samples(numberOfGaussians);
+        vector<Vec3b> colours(numberOfPixels);
+        // The samples in the order Mixture sorted them, so MixtureModel starts from the same components
+        vector<Vec3b> sortedSamples(static_cast<size_t>(numberOfPixels) * numberOfGaussians);
+        for (unsigned int p = 0; p < numberOfPixels; p++)
+        {
+            colours[p] = Vec3b(rng.uniform(0, 256), rng.uniform(0, 256), rng.uniform(0, 256));
+            for (Vec3b &sample : samples)
+            {
+                sample = Vec3b(rng.uniform(0, 256), rng.uniform(0, 256), rng.uniform(0, 256));
+            }
+            samples[0] = colours[p];
+            reference[p].initializeMixture(samples, rng);
+
+            vector<Gaussian> gaussians = reference[p].getGaussians();
+            for (int k = 0; k < numberOfGaussians; k++)
+            {
+                sortedSamples[p * numberOfGaussians + k] = Vec3b(gaussians[k].getMeanB(), gaussians[k].getMeanG(), gaussians[k].getMeanR());
+            }
+        }
+
+        vector<Vec3b> pixels(static_cast<size_t>(numberOfPixels) * frames);
+        vector<uchar> referenceMasks(pixels.size());
+        for (int f = 0; f < frames; f++)
+        {
+            for (unsigned int p = 0; p < numberOfPixels; p++)
+            {
+                Vec3b &colour = colours[p];
+                if (rng.uniform(0, 500) == 0)
+                {
+                    colour = Vec3b(rng.uniform(0, 256), rng.uniform(0, 256), rng.uniform(0, 256));
+                }
+                bool other = rng.uniform(0, 10) == 0;
+                Vec3b &pixel = pixels[static_cast<size_t>(f) * numberOfPixels + p];
+                for (int c = 0; c < 3; c++)
+                {
+                    pixel[c] = other ? rng.uniform(0, 256) : saturate_cast<uchar>(colour[c] + rng.uniform(-3, 4));
+                }
+                referenceMasks[static_cast<size_t>(f) * numberOfPixels + p] = reference[p].updateMixture(pixel, threshold) ? 0 : 255;
+            }
+        }
+
+        for (MixtureKernelType requested : {KERNEL_SCALAR, KERNEL_SSE41, KERNEL_AVX2, KERNEL_AVX512})
+        {
+            MixtureKernelType type = requested;
+            getMixtureRowKernel(type);
+            if (type != requested)
+            {
+                continue;
+            }
+
+            for (ModelPrecision precision : {PRECISION_DOUBLE, PRECISION_FLOAT, PRECISION_FIXED16})
+            {
+                MixtureModel model(numberOfPixels, numberOfGaussians, alpha, 36, 8, precision);
+                model.setKernel(type);
+                for (unsigned int p = 0; p < numberOfPixels; p++)
+                {
+                    model.initializePixel(p, &sortedSamples[p * numberOfGaussians], numberOfGaussians);
+                }
+
+                vector<Mixture> step(cols, Mixture(numberOfGaussians, alpha, 36, 8));
+                vector<uchar> mask(cols);
+                double componentDifference = 0;
+                unsigned long long decisionDifferences = 0;
+                unsigned long long maskDifferences = 0;
+                for (int f = 0; f < frames; f++)
+                {
+                    for (int i = 0; i < rows; i++)
+                    {
+                        for (int j = 0; j < cols; j++)
+                        {
+                            step[j].setGaussians(getGaussians(model, i * cols + j));
+                        }
+
+                        size_t first = static_cast<size_t>(f) * numberOfPixels + i * cols;
+                        model.updateRow(i * cols, cols, &pixels[first], threshold, mask.data());
+                        for (int j = 0; j < cols; j++)
+                        {
+                            decisionDifferences += mask[j] != (step[j].updateMixture(pixels[first + j], threshold) ? 0 : 255);
+                            maskDifferences += mask[j] != referenceMasks[first + j];
+
+                            componentDifference = max(componentDifference, compareMixture(model, i * cols + j, step[j].getGaussians()));
+                        }
+                    }
+                }
+
+                double updates = static_cast<double>(numberOfPixels) * frames;
+                bool ok = componentDifference <= componentTolerance[precision] && decisionDifferences == 0 &&
+                          maskDifferences <= maskTolerance[precision] * updates;
+                passed = passed && ok;
+
+                cout << "Mixture vs " << getMixtureKernelName(type) << " " << getPrecisionName(precision) << " K=" << numberOfGaussians
+                     << ": updates differ by " << componentDifference << " of the range (at most " << componentTolerance[precision]
+                     << "), " << decisionDifferences << " decisions differ; masks of the run differ in " << maskDifferences / updates
+                     << " of the pixels (at most " << maskTolerance[precision] << ")" << (ok ? "" : " FAILED") << endl;
+            }
+        }
+    }
+
+    return passed;
+}
+
+// Run the scalar update and every vectorized kernel the CPU has on the same pixels and compare the results
+static bool checkKernels(int frames, uint64 seed)
+{
+    // An odd row width leaves pixels to the scalar path at the end of every row
+    const int rows = 48;
+    const int cols = 97;
+    const unsigned int numberOfPixels = rows * cols;
+    const double alpha = 0.01;
+    const double threshold = 0.9;
+
+    // Tolerances by precision. In double the kernels differ by the exponential, about 1e-13 of
+    // a value. In float and fixed16 that can flip the rounding of a stored value, by 6e-8 of the
+    // value or one fixed-point step, below 1e-4 of the range of every plane, and then the
+    // classification of a pixel close to a bound. Masks may differ in this fraction of the pixels.
+    const double planeTolerance[] = {1e-12, 1e-6, 5e-4};
+    const double maskTolerance[] = {0, 1e-4, 1e-3};
+
+    bool passed = true;
+    for (MixtureKernelType requested : {KERNEL_SSE41, KERNEL_AVX2, KERNEL_AVX512})
+    {
+        MixtureKernelType type = requested;
+        getMixtureRowKernel(type);
+        if (type != requested)
+        {
+            cout << getMixtureKernelName(requested) << ": not supported by this CPU, skipped" << endl;
+            continue;
+        }
+
+        for (ModelPrecision precision : {PRECISION_DOUBLE, PRECISION_FLOAT, PRECISION_FIXED16})
+        {
+            for (int numberOfGaussians : {3, 5, 7})
+            {
+                MixtureModel scalar(numberOfPixels, numberOfGaussians, alpha, 36, 8, precision);
+                MixtureModel vectorized(numberOfPixels, numberOfGaussians, alpha, 36, 8, precision);
+                scalar.setKernel(KERNEL_SCALAR);
+                vectorized.setKernel(type);
+
+                // Every pixel keeps a colour with some noise, and now and then shows another or moves to it
+                RNG rng(seed);
+                vector<Vec3b> colours(numberOfPixels);
+                vector<Vec3b> samples(numberOfGaussians);
+                for (unsigned int p = 0; p < numberOfPixels; p++)
+                {
+                    colours[p] = Vec3b(rng.uniform(0, 256), rng.uniform(0, 256), rng.uniform(0, 256));
+                    for (Vec3b &sample : samples)
+                    {
+                        sample = Vec3b(rng.uniform(0, 256), rng.uniform(0, 256), rng.uniform(0, 256));
+                    }
+                    samples[0] = colours[p];
+                    scalar.initializePixel(p, samples.data(), numberOfGaussians);
+                    vectorized.initializePixel(p, samples.data(), numberOfGaussians);
+                }
+
+                vector<Vec3b> pixels(cols);
+                vector<uchar> scalarMask(cols), vectorizedMask(cols);
+                unsigned long long maskDifferences = 0;
+                unsigned long long unmatchedDifferences = 0;
+                for (int f = 0; f < frames; f++)
+                {
+                    for (int i = 0; i < rows; i++)
+                    {
+                        for (int j = 0; j < cols; j++)
+                        {
+                            Vec3b &colour = colours[i * cols + j];
+                            if (rng.uniform(0, 500) == 0)
+                            {
+                                colour = Vec3b(rng.uniform(0, 256), rng.uniform(0, 256), rng.uniform(0, 256));
+                            }
+                            bool other = rng.uniform(0, 10) == 0;
+                            for (int c = 0; c < 3; c++)
+                            {
+                                pixels[j][c] = other ? rng.uniform(0, 256) : saturate_cast<uchar>(colour[c] + rng.uniform(-3, 4));
+                            }
+                        }
+
+                        unsigned int scalarUnmatched = 0, vectorizedUnmatched = 0;
+                        scalar.updateRow(i * cols, cols, pixels.data(), threshold, scalarMask.data(), &scalarUnmatched);
+                        vectorized.updateRow(i * cols, cols, pixels.data(), threshold, vectorizedMask.data(), &vectorizedUnmatched);
+                        for (int j = 0; j < cols; j++)
+                        {
+                            maskDifferences += scalarMask[j] != vectorizedMask[j];
+                        }
+                        unmatchedDifferences += abs(static_cast<int>(scalarUnmatched) - static_cast<int>(vectorizedUnmatched));
+                    }
+                }
+
+                double planeDifference = compareModels(scalar, vectorized);
+                double maskDifference = static_cast<double>(maskDifferences) / (static_cast<double>(numberOfPixels) * frames);
+                bool ok = planeDifference <= planeTolerance[precision] && maskDifference <= maskTolerance[precision] &&
+                          unmatchedDifferences <= maskTolerance[precision] * numberOfPixels * frames;
+                passed = passed && ok;
+
+                cout << getMixtureKernelName(type) << " " << getPrecisionName(precision) << " K=" << numberOfGaussians
+                     << ": planes differ by " << planeDifference << " of their range (at most " << planeTolerance[precision]
+                     << "), masks in " << maskDifference << " of the pixels (at most " << maskTolerance[precision]
+                     << "), " << unmatchedDifferences << " unmatched counts differ" << (ok ? "" : " FAILED") << endl;
+            }
+        }
+    }
+
+    return passed;
+}
+
+// Run the full pipeline in each reduced precision and in double on the same scene and compare the masks,
+// with variance bounds inside and outside of what fixed16 can hold
+static bool checkPrecisions(int frames, uint64 seed)
+{
+    const int rows = 120;
+    const int cols = 160;
+
+    // Masks may differ in this fraction of the pixels, by precision. On this scene float
+    // masks rarely differ at all and fixed16 masks in at most about 3e-5 of the pixels.
+    const double maskTolerance[] = {0, 1e-4, 1e-3};
+    const double bounds[][2] = {{8, 36}, {4.001, 36}, {8, 204.7}, {3, 36}, {8, 300}};
+
+    bool passed = true;
+    for (ModelPrecision precision : {PRECISION_FLOAT, PRECISION_FIXED16})
+    {
+        for (const double *bound : bounds)
+        {
+            AGMMParameters parameters;
+            parameters.lowerboundVariance = bound[0];
+            parameters.upperboundVariance = bound[1];
+
+            AGMM reference(rows, cols);
+            AGMM reduced(rows, cols);
+            reference.setRandomSeed(seed);
+            reduced.setRandomSeed(seed);
+            reference.setParameters(parameters);
+            reduced.setModelPrecision(precision);
+
+            // Bounds the planes cannot hold must be rejected rather than saturate
+            if (!fitsPrecision(precision, bound[0], bound[1]))
+            {
+                bool ok = !reduced.setParameters(parameters);
+                passed = passed && ok;
+                cout << getPrecisionName(precision) << " variance " << bound[0] << " .. " << bound[1] << ": "
+                     << (ok ? "rejected" : "accepted FAILED") << endl;
+                continue;
+            }
+            reduced.setParameters(parameters);
+
+            SyntheticScene scene(rows, cols, seed);
+            vector<Mat> initializationFrames(10);
+            for (Mat &frame : initializationFrames)
+            {
+                scene.nextFrame(frame);
+            }
+            reference.initializeModel(initializationFrames);
+            reduced.initializeModel(initializationFrames);
+
+            Mat frame, referenceMask, reducedMask, result, difference;
+            unsigned long long maskDifferences = 0;
+            for (int i = 0; i < frames; i++)
+            {
+                scene.nextFrame(frame);
+                reference.processFrame(frame, referenceMask, result);
+                reduced.processFrame(frame, reducedMask, result);
+                compare(referenceMask, reducedMask, difference, CMP_NE);
+                maskDifferences += countNonZero(difference);
+            }
+
+            double maskDifference = static_cast<double>(maskDifferences) / (static_cast<double>(rows) * cols * frames);
+            bool ok = maskDifference <= maskTolerance[precision];
+            passed = passed && ok;
+
+            cout << getPrecisionName(precision) << " variance " << bound[0] << " .. " << bound[1] << ": masks differ from double in "
+                 << maskDifference << " of the pixels (at most " << maskTolerance[precision] << ")" << (ok ? "" : " FAILED") << endl;
+        }
+    }
+
+    return passed;
+}
+
+// Run the model with and without change gating on the same scene, in which an object stops half
+// way, and compare the masks
+static bool checkGate(int frames, uint64 seed)
+{
+    const int rows = 120;
+    const int cols = 160;
+    // Blocks are updated at least every tenth of 1 / alpha frames, the object stands still for longer
+    frames = max(frames, 400);
+
+    // Masks may differ in this fraction of the pixels, by reference. Against the background they
+    // differed in 3e-5 to 2.5e-4 of the pixels, against the previous frame, where a static block
+    // repeats its mask until it is updated, in 1.3e-3 to 6.7e-3.
+    const double maskTolerance[] = {5e-4, 1.5e-2};
+    const Rect object(20, 20, 24, 24);
+
+    bool passed = true;
+    for (GateReference reference : {GATE_BACKGROUND, GATE_PREVIOUS_FRAME})
+    {
+        for (double alpha : {0.001, 0.01})
+        {
+            AGMMParameters parameters;
+            parameters.alpha = alpha;
+
+            AGMM ungated(rows, cols);
+            AGMM gated(rows, cols);
+            ungated.setRandomSeed(seed);
+            gated.setRandomSeed(seed);
+            ungated.setParameters(parameters);
+            gated.setParameters(parameters);
+            gated.setChangeGating(8, 8, reference);
+
+            SyntheticScene scene(rows, cols, seed);
+            vector<Mat> initializationFrames(10);
+            for (Mat &frame : initializationFrames)
+            {
+                scene.nextFrame(frame);
+            }
+            ungated.initializeModel(initializationFrames);
+            gated.initializeModel(initializationFrames);
+
+            Mat frame, ungatedMask, gatedMask, result, difference;
+            unsigned long long maskDifferences = 0;
+            for (int i = 0; i < frames; i++)
+            {
+                scene.nextFrame(frame);
+                if (i >= frames / 2)
+                {
+                    frame(object).setTo(Scalar(40, 200, 90));
+                }
+                ungated.processFrame(frame, ungatedMask, result);
+                gated.processFrame(frame, gatedMask, result);
+                compare(ungatedMask, gatedMask, difference, CMP_NE);
+                maskDifferences += countNonZero(difference);
+            }
+
+            // Once the stopped object is learned without the gate, it must not stay foreground with it
+            int ungatedObject = countNonZero(ungatedMask(object));
+            int gatedObject = countNonZero(gatedMask(object));
+            double maskDifference = static_cast<double>(maskDifferences) / (static_cast<double>(rows) * cols * frames);
+            bool ok = maskDifference <= maskTolerance[reference] && gatedObject <= ungatedObject;
+            passed = passed && ok;
+
+            cout << "gate against the " << (reference == GATE_BACKGROUND ? "background" : "previous frame") << ", alpha " << alpha
+                 << ": " << gated.getSkippedBlockFraction() << " of the blocks skipped, masks differ in " << maskDifference
+                 << " of the pixels (at most " << maskTolerance[reference] << "), stopped object " << gatedObject
+                 << " foreground pixels gated and " << ungatedObject << " ungated" << (ok ? "" : " FAILED") << endl;
+        }
+    }
+
+    return passed;
+}
+
+int main(int argc, char **argv)
+{
+    vector<Size> resolutions;
+    int frames = 100;
+    int warmup = 10;
+    int threads = 1;
+    uint64 seed = 1;
+    unsigned int referencePixels = 65536;
+    ModelPrecision precision = PRECISION_DOUBLE;
+    MixtureKernelType kernel = KERNEL_AUTO;
+    PrefilterType prefilter = PREFILTER_GAUSSIAN;
+    string outputPath = "benchmark.json";
+    bool checkAllocations = false;
+    bool comparePrefilters = false;
+    bool compareTiling = false;
+    bool checkKernelsOnly = false;
+    int c;
+
+    static struct option long_options[] = {
+        {"resolution", required_argument, NULL, 'r'},
+        {"frames", required_argument, NULL, 'n'},
+        {"warmup", required_argument, NULL, 'w'},
+        {"threads", required_argument, NULL, 't'},
+        {"precision", required_argument, NULL, 'p'},
+        {"kernel", required_argument, NULL, 'k'},
+        {"prefilter", required_argument, NULL, 'P'},
+        {"seed", required_argument, NULL, 'S'},
+        {"reference-pixels", required_argument, NULL, 'R'},
+        {"output", required_argument, NULL, 'o'},
+        {"check-allocations", no_argument, NULL, 'a'},
+        {"compare-prefilters", no_argument, NULL, 'f'},
+        {"compare-tiling", no_argument, NULL, 'T'},
+        {"check-kernels", no_argument, NULL, 'K'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}};
+
+    while ((c = getopt_long(argc, argv, "r:n:w:t:p:k:P:S:R:o:afTKh", long_options, NULL)) != -1)
+    {
+        switch (c)
+        {
+        case 'r':
+        {
+            int width = 0, height = 0;
+            if (sscanf(optarg, "%dx%d", &width, &height) == 2 && width > 0 && height > 0)
+            {
+                resolutions.push_back(Size(width, height));
+            }
+            else
+            {
+                cout << "Error: Resolution must be given as <width>x<height>." << endl;
+                return -1;
+            }
+            break;
+        }
+        case 'n':
+            frames = max(atoi(optarg), 1);
+            break;
+        case 'w':
+            warmup = max(atoi(optarg), 0);
+            break;
+        case 't':
+            threads = max(atoi(optarg), 1);
+            break;
+        case 'p':
+            if (string(optarg) == "float")
+            {
+                precision = PRECISION_FLOAT;
+            }
+            else if (string(optarg) == "fixed16")
+            {
+                precision = PRECISION_FIXED16;
+            }
+            break;
+        case 'k':
+            for (MixtureKernelType type : {KERNEL_AUTO, KERNEL_SCALAR, KERNEL_SSE41, KERNEL_AVX2, KERNEL_AVX512})
+            {
+                if (string(optarg) == getMixtureKernelName(type))
+                {
+                    kernel = type;
+                }
+            }
+            break;
+        case 'P':
+            for (PrefilterType type : {PREFILTER_GAUSSIAN, PREFILTER_FIXED_GAUSSIAN, PREFILTER_BOX, PREFILTER_NONE})
+            {
+                if (string(optarg) == getPrefilterName(type))
+                {
+                    prefilter = type;
+                }
+            }
+            break;
+        case 'S':
+            seed = strtoull(optarg, NULL, 10);
+            break;
+        case 'R':
+            referencePixels = atoi(optarg);
+            break;
+        case 'o':
+            outputPath = optarg;
+            break;
+        case 'a':
+            checkAllocations = true;
+            break;
+        case 'f':
+            comparePrefilters = true;
+            break;
+        case 'T':
+            compareTiling = true;
+            break;
+        case 'K':
+            checkKernelsOnly = true;
+            break;
+        default:
+            cout << "Usage: Benchmark [-r|--resolution <width>x<height>]... [-n|--frames <count>] [-w|--warmup <count>] [-t|--threads <count>]" << endl;
+            cout << "                 [-p|--precision double|float|fixed16] [-k|--kernel auto|scalar|sse4.1|avx2|avx512] [-S|--seed <seed>]" << endl;
+            cout << "                 [-P|--prefilter gaussian|fixed-gaussian|box|none] [-R|--reference-pixels <count>] [-o|--output <file.json>]" << endl;
+            cout << "                 [-a|--check-allocations] [-f|--compare-prefilters] [-T|--compare-tiling] [-K|--check-kernels]" << endl;
+            return c == 'h' ? 0 : -1;
+        }
+    }
+
+    // The self-test runs instead of the benchmark
+    if (checkKernelsOnly)
+    {
+        if (!checkMixture(frames, seed))
+        {
+            cout << "Error: MixtureModel does not match the original Mixture." << endl;
+            return 1;
+        }
+        if (!checkKernels(frames, seed))
+        {
+            cout << "Error: The vectorized kernels do not match the scalar update." << endl;
+            return 1;
+        }
+        if (!checkPrecisions(frames, seed))
+        {
+            cout << "Error: The reduced precisions do not match the double model." << endl;
+            return 1;
+        }
+        if (!checkGate(frames, seed))
+        {
+            cout << "Error: The gated model does not match the ungated one." << endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    if (resolutions.empty())
+    {
+        resolutions = {Size(640, 360), Size(1280, 720), Size(1920, 1080)};
+    }
+
+    if (threads > 1)
+    {
+        setNumThreads(threads);
+    }
+
+    // Every matrix allocated from here on is counted
+    Mat::setDefaultAllocator(&matAllocator);
+
+    ofstream out(outputPath);
+    if (!out.is_open())
+    {
+        cout << "Error: " << outputPath << " cannot be written." << endl;
+        return -1;
+    }
+
+    out << "{\n";
+    out << "  \"frames\": " << frames << ",\n";
+    out << "  \"warmup\": " << warmup << ",\n";
+    out << "  \"threads\": " << threads << ",\n";
+    out << "  \"precision\": \"" << getPrecisionName(precision) << "\",\n";
+    out << "  \"prefilter\": \"" << getPrefilterName(prefilter) << "\",\n";
+    out << "  \"seed\": " << seed << ",\n";
+    out << "  \"results\": [\n";
+    for (size_t i = 0; i < resolutions.size(); i++)
+    {
+        benchmarkResolution(out, resolutions[i], frames, warmup, threads, precision, kernel, prefilter, seed, referencePixels, i + 1 == resolutions.size());
+    }
+    if (comparePrefilters)
+    {
+        out << "  ],\n";
+        out << "  \"prefilters\": [\n";
+        for (size_t i = 0; i < resolutions.size(); i++)
+        {
+            benchmarkPrefilters(out, resolutions[i], frames, warmup, threads, precision, kernel, seed, i + 1 == resolutions.size());
+        }
+    }
+    if (compareTiling)
+    {
+        out << "  ],\n";
+        out << "  \"tiling\": [\n";
+        for (size_t i = 0; i < resolutions.size(); i++)
+        {
+            benchmarkTiling(out, resolutions[i], frames, warmup, threads, precision, kernel, seed, i + 1 == resolutions.size());
+        }
+    }
+    out << "  ]\n";
+    out << "}\n";
+
+    if (checkAllocations && !checkFrameAllocations(resolutions, frames, warmup, threads, precision, kernel, prefilter, seed))
+    {
+        cout << "Error: processFrame allocated after the warmup." << endl;
+        return 1;
+    }
+
+    return 0;
+}
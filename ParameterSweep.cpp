@@ -0,0 +1,364 @@
+#include "include/AGMM.h"
+#include "include/FrameSource.h"
+#include "include/MaskArchive.h"
+#include "include/ParameterSweep.h"
+#include "include/SyntheticScene.h"
+#include <fstream>
+#include <getopt.h>
+#include <iomanip>
+#include <set>
+#include <sstream>
+#include <opencv2/opencv.hpp>
+
+using namespace cv;
+using namespace std;
+
+/**
+ * The values given for one parameter.
+ */
+struct SweepAxis
+{
+    const char *name;
+    double AGMMParameters::*member;
+    vector<double> values;
+};
+
+// Parse a comma separated list of values and <first>:<last>:<step> ranges
+static bool parseValues(const char *argument, vector<double> &values)
+{
+    values.clear();
+    stringstream list(argument);
+    string item;
+    while (getline(list, item, ','))
+    {
+        double first, last, step;
+        char end;
+        if (sscanf(item.c_str(), "%lf:%lf:%lf%c", &first, &last, &step, &end) == 3 && step > 0 && first <= last)
+        {
+            // Half a step of slack so the last value is not lost to rounding
+            for (int i = 0; first + i * step <= last + step / 2; i++)
+            {
+                values.push_back(first + i * step);
+            }
+        }
+        else if (sscanf(item.c_str(), "%lf%c", &first, &end) == 1)
+        {
+            values.push_back(first);
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return !values.empty();
+}
+
+// Every combination of the values of the axes, the other parameters keep their defaults
+static vector<AGMMParameters> expandGrid(const vector<SweepAxis> &axes)
+{
+    vector<AGMMParameters> configurations(1);
+    for (const SweepAxis &axis : axes)
+    {
+        vector<AGMMParameters> expanded;
+        for (const AGMMParameters &configuration : configurations)
+        {
+            for (double value : axis.values)
+            {
+                AGMMParameters parameters = configuration;
+                parameters.*axis.member = value;
+                expanded.push_back(parameters);
+            }
+        }
+        configurations.swap(expanded);
+    }
+    return configurations;
+}
+
+static void writeReport(ostream &out, const vector<SweepResult> &results, bool json)
+{
+    if (!json)
+    {
+        out << "rank,f1,precision,recall,fps,frames,scored_frames,alpha,background_ratio,upperbound_variance,lowerbound_variance,"
+            << "hue_threshold,saturation_threshold,value_upperbound,value_lowerbound\n";
+    }
+    else
+    {
+        out << "[\n";
+    }
+
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const SweepResult &result = results[i];
+        const AGMMParameters &parameters = result.parameters;
+        if (!json)
+        {
+            out << i + 1 << "," << result.f1 << "," << result.precision << "," << result.recall << "," << result.framesPerSecond << ","
+                << result.frames << "," << result.scoredFrames << "," << parameters.alpha << "," << parameters.backgroundRatio << ","
+                << parameters.upperboundVariance << "," << parameters.lowerboundVariance << "," << parameters.hueThreshold << ","
+                << parameters.saturationThreshold << "," << parameters.valueUpperbound << "," << parameters.valueLowerbound << "\n";
+        }
+        else
+        {
+            out << "  {\"rank\": " << i + 1 << ", \"f1\": " << result.f1 << ", \"precision\": " << result.precision
+                << ", \"recall\": " << result.recall << ", \"fps\": " << result.framesPerSecond << ", \"frames\": " << result.frames
+                << ", \"scored_frames\": " << result.scoredFrames << ", \"alpha\": " << parameters.alpha
+                << ", \"background_ratio\": " << parameters.backgroundRatio << ", \"upperbound_variance\": " << parameters.upperboundVariance
+                << ", \"lowerbound_variance\": " << parameters.lowerboundVariance << ", \"hue_threshold\": " << parameters.hueThreshold
+                << ", \"saturation_threshold\": " << parameters.saturationThreshold << ", \"value_upperbound\": " << parameters.valueUpperbound
+                << ", \"value_lowerbound\": " << parameters.valueLowerbound << "}" << (i + 1 == results.size() ? "" : ",") << "\n";
+        }
+    }
+
+    if (json)
+    {
+        out << "]\n";
+    }
+}
+
+int main(int argc, char **argv)
+{
+    string groundTruthPath;
+    Size syntheticSize;
+    unsigned long frames = 0;
+    int warmup = 0;
+    int jobs = 0;
+    int batchSize = 16;
+    ModelPrecision precision = PRECISION_DOUBLE;
+    uint64 seed = 0;
+    string outputPath = "sweep.csv";
+    size_t top = 10;
+    vector<SweepAxis> axes;
+    int c;
+
+    // Long options from 256 on select the axes, in the order of this table
+    static const SweepAxis axisOptions[] = {
+        {"alpha", &AGMMParameters::alpha, {}},
+        {"background-ratio", &AGMMParameters::backgroundRatio, {}},
+        {"upperbound-variance", &AGMMParameters::upperboundVariance, {}},
+        {"lowerbound-variance", &AGMMParameters::lowerboundVariance, {}},
+        {"hue-threshold", &AGMMParameters::hueThreshold, {}},
+        {"saturation-threshold", &AGMMParameters::saturationThreshold, {}},
+        {"value-upperbound", &AGMMParameters::valueUpperbound, {}},
+        {"value-lowerbound", &AGMMParameters::valueLowerbound, {}}};
+
+    static struct option long_options[] = {
+        {"ground-truth", required_argument, NULL, 'g'},
+        {"synthetic", required_argument, NULL, 'y'},
+        {"frames", required_argument, NULL, 'n'},
+        {"warmup", required_argument, NULL, 'w'},
+        {"jobs", required_argument, NULL, 'j'},
+        {"batch", required_argument, NULL, 'b'},
+        {"precision", required_argument, NULL, 'p'},
+        {"seed", required_argument, NULL, 'S'},
+        {"output", required_argument, NULL, 'o'},
+        {"top", required_argument, NULL, 'T'},
+        {"help", no_argument, NULL, 'h'},
+        {"alpha", required_argument, NULL, 256},
+        {"background-ratio", required_argument, NULL, 257},
+        {"upperbound-variance", required_argument, NULL, 258},
+        {"lowerbound-variance", required_argument, NULL, 259},
+        {"hue-threshold", required_argument, NULL, 260},
+        {"saturation-threshold", required_argument, NULL, 261},
+        {"value-upperbound", required_argument, NULL, 262},
+        {"value-lowerbound", required_argument, NULL, 263},
+        {NULL, 0, NULL, 0}};
+
+    while ((c = getopt_long(argc, argv, "g:y:n:w:j:b:p:S:o:T:h", long_options, NULL)) != -1)
+    {
+        switch (c)
+        {
+        case 'g':
+            groundTruthPath = optarg;
+            break;
+        case 'y':
+            if (sscanf(optarg, "%dx%d", &syntheticSize.width, &syntheticSize.height) != 2 || syntheticSize.empty())
+            {
+                cout << "Error: Synthetic frame size must be given as <width>x<height>." << endl;
+                return -1;
+            }
+            break;
+        case 'n':
+            frames = strtoul(optarg, NULL, 10);
+            break;
+        case 'w':
+            warmup = atoi(optarg);
+            break;
+        case 'j':
+            jobs = atoi(optarg);
+            break;
+        case 'b':
+            batchSize = atoi(optarg);
+            break;
+        case 'p':
+            if (string(optarg) == "float")
+            {
+                precision = PRECISION_FLOAT;
+            }
+            else if (string(optarg) == "fixed16")
+            {
+                precision = PRECISION_FIXED16;
+            }
+            else
+            {
+                precision = PRECISION_DOUBLE;
+            }
+            break;
+        case 'S':
+            seed = strtoull(optarg, NULL, 10);
+            break;
+        case 'o':
+            outputPath = optarg;
+            break;
+        case 'T':
+            top = strtoul(optarg, NULL, 10);
+            break;
+        case 256:
+        case 257:
+        case 258:
+        case 259:
+        case 260:
+        case 261:
+        case 262:
+        case 263:
+        {
+            SweepAxis axis = axisOptions[c - 256];
+            if (!parseValues(optarg, axis.values))
+            {
+                cout << "Error: --" << axis.name << " takes values and <first>:<last>:<step> ranges separated by commas." << endl;
+                return -1;
+            }
+            axes.push_back(axis);
+            break;
+        }
+        default:
+            cout << "Usage: ParameterSweep <video> -g|--ground-truth <masks.masks|mask video|masks/%06d.png> [-n|--frames <count>] [-w|--warmup <count>]" << endl;
+            cout << "       ParameterSweep -y|--synthetic <width>x<height> [-n|--frames <count>] [-w|--warmup <count>]" << endl;
+            cout << "       [--alpha <values>] [--background-ratio <values>] [--upperbound-variance <values>] [--lowerbound-variance <values>]" << endl;
+            cout << "       [--hue-threshold <values>] [--saturation-threshold <values>] [--value-upperbound <values>] [--value-lowerbound <values>]" << endl;
+            cout << "       [-j|--jobs <count>] [-b|--batch <frames>] [-p|--precision double|float|fixed16] [-S|--seed <seed>]" << endl;
+            cout << "       [-o|--output <file.csv|file.json>] [-T|--top <count>]" << endl;
+            cout << "Values are separated by commas, <first>:<last>:<step> adds a range. Every combination is run." << endl;
+            return c == 'h' ? 0 : -1;
+        }
+    }
+
+    // The clip and its ground truth, read once for all configurations
+    FrameSource source;
+    FrameSource groundTruthSource;
+    MaskArchiveReader groundTruthArchive;
+    unique_ptr<SyntheticScene> scene;
+    function<bool(Mat &, Mat &)> nextFrame;
+
+    if (!syntheticSize.empty())
+    {
+        scene.reset(new SyntheticScene(syntheticSize.height, syntheticSize.width, seed + 1));
+        frames = frames > 0 ? frames : 300;
+        nextFrame = [&](Mat &frame, Mat &groundTruth)
+        {
+            scene->nextFrame(frame, &groundTruth);
+            return true;
+        };
+    }
+    else
+    {
+        if (optind >= argc || groundTruthPath.empty())
+        {
+            cout << "Error: Give a video and its ground truth, or --synthetic." << endl;
+            return -1;
+        }
+        if (!source.open(argv[optind]))
+        {
+            cout << "Error: " << source.getError() << endl;
+            return -1;
+        }
+
+        bool isArchive = groundTruthPath.size() >= 6 && groundTruthPath.compare(groundTruthPath.size() - 6, 6, ".masks") == 0;
+        if (isArchive ? !groundTruthArchive.open(groundTruthPath) : !groundTruthSource.open(groundTruthPath))
+        {
+            cout << "Error: " << (isArchive ? groundTruthArchive.getError() : groundTruthSource.getError()) << endl;
+            return -1;
+        }
+
+        size_t frameIndex = 0;
+        Mat groundTruthFrame;
+        nextFrame = [&, isArchive, frameIndex, groundTruthFrame](Mat &frame, Mat &groundTruth) mutable
+        {
+            if (!source.read(frame))
+            {
+                return false;
+            }
+            if (isArchive)
+            {
+                return groundTruthArchive.readMask(frameIndex++, groundTruth);
+            }
+            if (!groundTruthSource.read(groundTruthFrame))
+            {
+                return false;
+            }
+
+            // Mask videos and images decode to BGR
+            if (groundTruthFrame.channels() == 3)
+            {
+                cvtColor(groundTruthFrame, groundTruth, COLOR_BGR2GRAY);
+            }
+            else
+            {
+                groundTruthFrame.copyTo(groundTruth);
+            }
+            return true;
+        };
+    }
+
+    vector<AGMMParameters> configurations = expandGrid(axes);
+    ParameterSweep sweep(configurations, jobs);
+    sweep.setModelPrecision(precision);
+    sweep.setRandomSeed(seed);
+    sweep.setWarmup(warmup);
+    sweep.setBatchSize(batchSize);
+
+    cout << "Running " << configurations.size() << " configurations" << endl;
+    int64 startTicks = getTickCount();
+    vector<SweepResult> results = sweep.run(nextFrame, frames);
+    double seconds = (getTickCount() - startTicks) / getTickFrequency();
+    if (!sweep.getSkipped().empty())
+    {
+        set<pair<double, double>> bounds;
+        for (const AGMMParameters &parameters : sweep.getSkipped())
+        {
+            bounds.insert(make_pair(parameters.lowerboundVariance, parameters.upperboundVariance));
+        }
+        cout << "Skipped " << sweep.getSkipped().size() << " configurations, " << getPrecisionName(precision) << " models cannot hold the variance";
+        for (const pair<double, double> &bound : bounds)
+        {
+            cout << " " << bound.first << ".." << bound.second;
+        }
+        cout << endl;
+    }
+    if (results.empty())
+    {
+        cout << "Error: " << sweep.getError() << endl;
+        return -1;
+    }
+
+    cout << results[0].frames + 10 << " frames in " << seconds << " s" << endl;
+    cout << "rank      F1  precision  recall     fps  parameters" << endl;
+    for (size_t i = 0; i < min(top, results.size()); i++)
+    {
+        const SweepResult &result = results[i];
+        const AGMMParameters &parameters = result.parameters;
+        cout << fixed << setw(4) << i + 1 << setprecision(4) << setw(8) << result.f1 << setw(11) << result.precision << setw(8) << result.recall
+             << setprecision(1) << setw(8) << result.framesPerSecond << "  " << defaultfloat << setprecision(6) << "alpha " << parameters.alpha << ", background ratio " << parameters.backgroundRatio << ", variance "
+             << parameters.lowerboundVariance << ".." << parameters.upperboundVariance << ", hue " << parameters.hueThreshold
+             << ", saturation " << parameters.saturationThreshold << ", value " << parameters.valueLowerbound << ".." << parameters.valueUpperbound << endl;
+    }
+
+    ofstream out(outputPath);
+    if (!out.is_open())
+    {
+        cout << "Error: " << outputPath << " cannot be written." << endl;
+        return -1;
+    }
+    writeReport(out, results, outputPath.size() >= 5 && outputPath.compare(outputPath.size() - 5, 5, ".json") == 0);
+
+    return 0;
+}
@@ -1,12 +1,38 @@
 #ifndef AGMM_H
 #define AGMM_H
 
-#include "Mixture.h"
+#include "ChangeGate.h"
+#include "FrameSource.h"
+#include "FrameWorkspace.h"
+#include "MixtureModel.h"
+#include "Prefilter.h"
+#include "StageProfiler.h"
+#include "ThreadPool.h"
+#include <functional>
 #include <opencv2/opencv.hpp>
 
 using namespace cv;
 using namespace std;
 
+/**
+ * Tuning parameters of the background model and of shadow detection, see AGMM::setParameters.
+ */
+struct AGMMParameters
+{
+    // Learning rate of the mixtures
+    double alpha = 0.001;
+    // Share of the weight ratios, best first, whose components are background
+    double backgroundRatio = 0.9;
+    double upperboundVariance = 36;
+    double lowerboundVariance = 8;
+    // Largest mean hue and saturation differences to the background of a shadow window
+    double hueThreshold = 62;
+    double saturationThreshold = 93;
+    // Range of the ratio of the value of a shadow pixel to that of the background
+    double valueUpperbound = 1;
+    double valueLowerbound = 0.6;
+};
+
 /**
  * Class to implement the adaptive Gaussian mixture model (AGMM) algorithm.
  * The algorithm is described in the paper:
@@ -15,13 +41,18 @@ using namespace std;
  */
 class AGMM
 {
+    friend class AGMMBenchmark;
+
 private:
     // Background maintenance parameters
-    double BM_numberOfGaussians = 7;
+    int BM_numberOfGaussians = 7;
     double BM_alpha = 0.001;
     double BM_backgroundRatio = 0.9;
     double BM_upperboundVariance = 36;
     double BM_lowerboundVariance = 8;
+    // Seed of the initialization sampling, drawn for every initialization unless set
+    bool BM_seeded = false;
+    uint64 BM_seed = 0;
 
     // Shadow detection parameters
     double SD_hueThreshold = 62;
@@ -29,43 +60,382 @@ private:
     double SD_valueUpperbound = 1;
     double SD_valueLowerbound = 0.6;
 
-    VideoCapture cap;
-    Mat frame;
+    // Change gating parameters, a block size of 0 updates every pixel
+    int CG_blockSize = 0;
+    double CG_sensitivity = 4;
+    GateReference CG_reference = GATE_BACKGROUND;
+
+    // Pyramid parameters, the model runs on frames reduced by this factor
+    int PM_scale = 1;
+
+    // Prefilter parameters, the filter of the frames the model sees
+    PrefilterType PF_type = PREFILTER_GAUSSIAN;
+
+    // Tiling parameters, processFrame runs the per-pixel stages band by band, 0 rows to fit a band in the L2 cache
+    bool FT_enabled = false;
+    int FT_tileRows = 0;
+
+    // Mask cleaning parameters, blobs of at most this many pixels in either direction are noise
+    int MC_minimumSize = 4;
+    int MC_minimumArea = 0;
+
+    // Execution parameters
+    int numberOfThreads = 1;
+    ThreadPool *threadPool = nullptr;
+    TaskPriority poolPriority = PRIORITY_NORMAL;
+    MixtureKernelType kernelType = KERNEL_AUTO;
+    ModelPrecision modelPrecision = PRECISION_DOUBLE;
+    StageProfiler *profiler = nullptr;
+
+    FrameSource source;
     Mat background;
-    Mat mask;
-    Mat result;
 
-    unsigned int rows;
-    unsigned int cols;
-    unsigned int numberOfPixels;
+    unsigned int rows = 0;
+    unsigned int cols = 0;
+    unsigned int numberOfPixels = 0;
+
+    // Size of the model, the frame size divided by PM_scale and rounded up
+    unsigned int modelRows = 0;
+    unsigned int modelCols = 0;
+    unsigned int numberOfModelPixels = 0;
+
+    MixtureModel mixtures;
+    ChangeGate changeGate;
+    Prefilter prefilter;
+
+    // Per-frame buffers, sized once the model is initialized
+    UpdateWorkspace updateWorkspace;
+    mutable PostProcessWorkspace postProcessWorkspace;
 
-    vector<Mixture> mixtures;
+    bool initializeModel(const function<bool(int, Mat &)> &nextFrame, int numberOfFrames);
 
-    void backgroundMaintenance();
-    void shadowDetection();
+    void allocateWorkspaces();
 
-    Mat maskCleaner(Mat mask);
+    // The longest gap a static block may be skipped for, after which its update runs anyway
+    unsigned int getMaximumSkippedFrames() const;
+
+    void reduceFrame(const Mat &frame, Mat &reducedFrame);
+    void backgroundMaintenance(const Mat &frame, Mat &foregroundMask);
+    void updateRows(const Mat &workingFrame, Mat &modelMask, const Range &range, unsigned int &updated, unsigned int &unmatched);
+    void refineMask(const Mat &frame, const Mat &coarseMask, Mat &mask);
+    void copyBackground(Mat &background) const;
+    void shadowDetection(const Mat &frame, const Mat &background, const Mat &foregroundMask, Mat &mask, vector<Blob> *blobs) const;
+    void testShadows(const Mat &frame, const Mat &background, const Mat &foregroundMask, Mat &mask, const Range &range, ShadowRows &rows, bool resume) const;
+    void processTiles(const Mat &frame, Mat &foregroundMask, Mat &mask);
+    void composeResult(const Mat &frame, const Mat &mask, Mat &result) const;
+
+    // Templates rather than std::function, so the serial path calls the body without allocating
+    template <typename Body>
+    void forEachRange(const Range &range, const Body &body) const;
+
+    template <typename Body>
+    void forEachRowRange(const Body &body) const;
+
+    void filterMask(const Mat &mask, Mat &filtered, Mat &rowFiltered, int radius, bool dilate) const;
+
+    void maskCleaner(Mat &mask, vector<Blob> *blobs) const;
 
 public:
     /**
      * Initialize the AGMM algorithm.
-     * @param videoPath The path to the video file.
+     * @param videoPath The path to the video file, a raw BGR or Y4M file, or "-" for standard input.
+     * @param rawFrameSize The size of raw BGR frames, empty if the input is not raw, see FrameSource.
+     * @param rawFrameRate The frame rate of raw frames.
+     */
+    explicit AGMM(const string &videoPath, Size rawFrameSize = Size(), double rawFrameRate = 25);
+
+    /**
+     * Initialize the AGMM algorithm without a video, frames are passed to processFrame.
+     * @param rows The height of the frames.
+     * @param cols The width of the frames.
      */
-    explicit AGMM(string videoPath);
+    AGMM(unsigned int rows, unsigned int cols);
 
     ~AGMM();
 
     /**
-     * Initialize the model.
+     * Initialize the model. The frames are streamed, only K samples per pixel are kept.
      * @param numberOfFrames The number of frames to use for initialization.
      */
     void initializeModel(int numberOfFrames);
 
+    /**
+     * Initialize the model from frames read elsewhere.
+     * @param frames The frames to use for initialization.
+     * @return False if there is no frame or one of them is empty, the model is then left uninitialized.
+     */
+    bool initializeModel(const vector<Mat> &frames);
+
+    /**
+     * Save the mixtures and the background, to resume on another video of the same camera
+     * with loadCheckpoint.
+     * @param path The checkpoint file, replaced if it exists.
+     * @return False if the model is not initialized or the file cannot be written.
+     */
+    bool saveCheckpoint(const string &path) const;
+
+    /**
+     * Resume from a checkpoint instead of calling initializeModel. The file is mapped, so
+     * this returns before the model is read from disk. The pyramid scale and model precision
+     * are taken from the checkpoint.
+     * @param path The checkpoint file.
+     * @return False if the file cannot be read or was saved for another frame size or other
+     * model parameters, the current model is kept.
+     */
+    bool loadCheckpoint(const string &path);
+
     /**
      * Process the next frame and return the foreground mask.
      * @return The foreground mask.
      */
     tuple<Mat, Mat, Mat> processNextFrame();
+
+    /**
+     * @return False without a video, if it could not be opened, or once it ran out of frames
+     * during initialization or in processNextFrame.
+     */
+    bool isOpened();
+
+    /**
+     * @return The frame rate of the video, 25 when the input does not store one.
+     */
+    double getFrameRate();
+
+    /**
+     * Decode the next frame of the video. Frames of a raw file are read-only headers on its mapping.
+     * @param frame Receives the frame, empty at the end of the video.
+     * @return False at the end of the video.
+     */
+    bool readFrame(Mat &frame);
+
+    /**
+     * Run every stage on one frame, same as processNextFrame for a frame read elsewhere.
+     * @param frame The frame.
+     * @return The foreground mask, the masked frame and the frame.
+     */
+    tuple<Mat, Mat, Mat> processFrame(const Mat &frame);
+
+    /**
+     * Run every stage on a frame owned by the caller and write into the caller's buffers.
+     * Outputs that already have the frame size and type are written in place, so a header on
+     * shared memory receives the results without a copy; others are allocated once and reused.
+     * With reused outputs no frame buffer is allocated after initialization.
+     * @param frame The frame, BGR of the size given to the constructor.
+     * @param mask Receives the foreground mask, CV_8U.
+     * @param result Receives the masked frame, CV_8UC3.
+     * @param blobs If not null, receives the blobs of the mask.
+     * @return False if the frame has another size or type, the outputs are left unchanged.
+     */
+    bool processFrame(const Mat &frame, Mat &mask, Mat &result, vector<Blob> *blobs = nullptr);
+
+    /**
+     * Same as above for raw buffers of the size given to the constructor.
+     * @param frame The BGR frame.
+     * @param frameStep The bytes between the starts of two rows of the frame.
+     * @param mask Receives the foreground mask, one byte per pixel.
+     * @param maskStep The bytes between the starts of two rows of the mask.
+     * @param result Receives the masked frame, BGR.
+     * @param resultStep The bytes between the starts of two rows of the masked frame.
+     * @return Always true, the sizes are implied.
+     */
+    bool processFrame(const uchar *frame, size_t frameStep, uchar *mask, size_t maskStep, uchar *result, size_t resultStep);
+
+    /**
+     * First half of processFrame: update the model and the background with a frame.
+     * Frames must be passed in video order.
+     * @param frame The frame.
+     * @param foregroundMask Receives the foreground mask before shadow removal, written in place if it has the frame size.
+     * @param background If not null, receives a copy of the background after the update.
+     */
+    void updateModel(const Mat &frame, Mat &foregroundMask, Mat *background);
+
+    /**
+     * Second half of processFrame: shadow removal and mask cleaning. Only reads the
+     * parameters, so it may run concurrently with updateModel on a later frame, but not
+     * with another call of postProcess, which shares its buffers.
+     * @param frame The frame.
+     * @param foregroundMask The mask returned by updateModel for the frame.
+     * @param background The background returned by updateModel for the frame.
+     * @param mask Receives the foreground mask, written in place if it has the frame size.
+     * @param result Receives the masked frame, written in place if it has the frame size.
+     * @param blobs If not null, receives the blobs of the mask.
+     */
+    void postProcess(const Mat &frame, const Mat &foregroundMask, const Mat &background, Mat &mask, Mat &result, vector<Blob> *blobs = nullptr) const;
+
+    /**
+     * Set the number of row stripes the per-pixel stages are split into.
+     * The output does not depend on this value, only the run time does.
+     * @param numberOfThreads The number of workers, 1 runs serially.
+     */
+    void setNumberOfThreads(int numberOfThreads);
+
+    int getNumberOfThreads();
+
+    /**
+     * Run the per-pixel stages on a pool shared with other instances instead of OpenCV's.
+     * The stages are split into as many tiles as set with setNumberOfThreads, and idle
+     * workers of the pool take over the tiles of busy instances.
+     * @param threadPool The pool, owned by the caller, or nullptr to use OpenCV's again.
+     * @param priority The priority of the tiles relative to those of other instances.
+     */
+    void setThreadPool(ThreadPool *threadPool, TaskPriority priority = PRIORITY_NORMAL);
+
+    ThreadPool *getThreadPool();
+
+    /**
+     * Select the instruction set of the mixture update.
+     * @param kernelType KERNEL_AUTO picks the widest one the CPU supports.
+     */
+    void setMixtureKernel(MixtureKernelType kernelType);
+
+    MixtureKernelType getMixtureKernel();
+
+    /**
+     * Time every stage and count foreground and unmatched pixels. Without a profiler
+     * nothing is measured.
+     * @param profiler The profiler, owned by the caller, or nullptr to stop profiling.
+     */
+    void setProfiler(StageProfiler *profiler);
+
+    StageProfiler *getProfiler();
+
+    /**
+     * Select the element type of the model, see ModelPrecision for the error bounds.
+     * Takes effect on the next call to initializeModel.
+     * @param modelPrecision The precision of the stored means, variances and weights.
+     * @return False, leaving the precision unchanged, if it cannot hold the variance bounds, see fitsPrecision.
+     */
+    bool setModelPrecision(ModelPrecision modelPrecision);
+
+    ModelPrecision getModelPrecision();
+
+    /**
+     * Run the mixture model on frames reduced by a factor and upsample its mask. Pixels
+     * within one model pixel of a foreground boundary are classified again at full
+     * resolution against the model pixel they fall in, so blob outlines stay sharp.
+     * Model memory and update cost fall by the square of the factor.
+     * Takes effect on the next call to initializeModel.
+     * @param scale The reduction factor, 1 for full resolution, 2 or 4 for half or quarter.
+     */
+    void setPyramidScale(int scale);
+
+    int getPyramidScale();
+
+    /**
+     * Select the filter applied to every frame before the model update. Its output is
+     * computed once per frame and shared by the initialization, the change gate and the
+     * mixture update; shadow detection works on the unfiltered frame. With a pyramid the
+     * filter is scaled down with the frame.
+     * @param type PREFILTER_GAUSSIAN for the original 9x9 Gaussian of sigma 2.
+     */
+    void setPrefilter(PrefilterType type);
+
+    PrefilterType getPrefilter();
+
+    /**
+     * Run the prefilter, the mixture update, the shadow test and the mask subtraction of
+     * processFrame band by band, so the rows of a band are still in the L2 cache when the
+     * next stage reads them instead of every stage streaming the frame through memory.
+     * Mask cleaning and the masked frame work on the whole mask as before. The masks are
+     * the same as stage by stage. Not used with a pyramid, nor by updateModel and
+     * postProcess, which the pipeline runs on different frames.
+     * @param enabled False to run every stage on the whole frame.
+     * @param tileRows The rows of a band, 0 to fit a band in half the L2 cache. With change
+     * gating bands are rounded up to whole blocks.
+     */
+    void setTiling(bool enabled, int tileRows = 0);
+
+    /**
+     * @return The rows of the bands processFrame runs, 0 if it runs stage by stage.
+     */
+    int getTileRows();
+
+    /**
+     * Skip the mixture update of blocks that did not change. A static block keeps its
+     * background and repeats its previous foreground mask; the weight decay it missed is
+     * applied once it changes again, see MixtureModel::decayPixel. A block is updated at least
+     * every tenth of 1 / alpha frames, so an object that stopped in it stays foreground no
+     * longer than that before the model starts to learn it.
+     * @param blockSize The side of the blocks in model pixels, 0 to update every pixel.
+     * @param sensitivity The largest difference of any channel of a blurred pixel a static block may have.
+     * @param reference The image the blocks are compared with.
+     */
+    void setChangeGating(int blockSize, double sensitivity = 4, GateReference reference = GATE_BACKGROUND);
+
+    /**
+     * @return The fraction of blocks whose update was skipped since the gate was set or the model initialized.
+     */
+    double getSkippedBlockFraction();
+
+    /**
+     * Set which blobs mask cleaning removes as noise. Kept blobs have their holes filled.
+     * @param minimumSize Blobs whose bounding box is at most this many pixels wide or high are removed.
+     * @param minimumArea Blobs of fewer pixels, holes included, are removed.
+     */
+    void setBlobFilter(int minimumSize, int minimumArea = 0);
+
+    /**
+     * Seed the sampling of the initialization frames, so that runs on the same frames give
+     * the same model and masks, whatever the number of threads. Without a seed every
+     * initialization draws a new one. Takes effect on the next call to initializeModel.
+     * @param seed The seed.
+     */
+    void setRandomSeed(uint64 seed);
+
+    /**
+     * Set the tuning parameters. The background ratio and the shadow thresholds apply from
+     * the next frame, the learning rate and the variance bounds from the next call to
+     * initializeModel or loadCheckpoint.
+     * @param parameters The parameters.
+     * @return False, leaving every parameter unchanged, if the model precision cannot hold the variance bounds, see fitsPrecision.
+     */
+    bool setParameters(const AGMMParameters &parameters);
+
+    AGMMParameters getParameters();
+};
+
+/**
+ * Hands a body to OpenCV's parallel_for_ by reference, a lambda would be copied into a std::function.
+ */
+template <typename Body>
+class RangeLoopBody : public ParallelLoopBody
+{
+private:
+    const Body &body;
+
+public:
+    explicit RangeLoopBody(const Body &body) : body(body)
+    {
+    }
+
+    void operator()(const Range &range) const override
+    {
+        this->body(range);
+    }
 };
 
+template <typename Body>
+void AGMM::forEachRange(const Range &range, const Body &body) const
+{
+    if (this->threadPool != nullptr)
+    {
+        this->threadPool->parallelFor(range, this->numberOfThreads, this->poolPriority, body);
+    }
+    else if (this->numberOfThreads > 1)
+    {
+        // One stripe per worker; OpenCV's pool decides which thread runs each stripe
+        parallel_for_(range, RangeLoopBody<Body>(body), this->numberOfThreads);
+    }
+    else
+    {
+        body(range);
+    }
+}
+
+template <typename Body>
+void AGMM::forEachRowRange(const Body &body) const
+{
+    this->forEachRange(Range(0, this->rows), body);
+}
+
 #endif
\ No newline at end of file
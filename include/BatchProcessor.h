@@ -0,0 +1,172 @@
+#ifndef BatchProcessor_H
+#define BatchProcessor_H
+
+#include "AGMM.h"
+#include <map>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+using namespace cv;
+using namespace std;
+
+/**
+ * Outcome of one video of a batch.
+ */
+struct BatchResult
+{
+    string videoPath;
+    string outputPath;
+    bool succeeded;
+    unsigned long frames;
+    double seconds;
+    double skippedBlockFraction;
+    // Time from reading a frame to its mask in milliseconds, 0 when pipelined
+    double meanFrameTime;
+    double maximumFrameTime;
+};
+
+/**
+ * Processes many videos without a display. Each video gets its own AGMM instance and a
+ * fixed number of videos run at the same time. Videos are started largest file first, so
+ * the last ones to finish are short and the cores stay busy until the end of the batch.
+ */
+class BatchProcessor
+{
+private:
+    vector<string> videoPaths;
+    string outputDirectory;
+
+    int numberOfJobs;
+    int threadsPerJob;
+    ModelPrecision modelPrecision = PRECISION_DOUBLE;
+    bool pipelined = false;
+    string profileFormat;
+    unsigned long profileInterval = 0;
+    int pyramidScale = 1;
+    string checkpointPath;
+    int gateBlockSize = 0;
+    double gateSensitivity = 4;
+    GateReference gateReference = GATE_BACKGROUND;
+    bool hosted = false;
+    map<string, TaskPriority> priorities;
+    int archiveContents = 0;
+    bool seeded = false;
+    uint64 seed = 0;
+    Size rawFrameSize;
+    double rawFrameRate = 25;
+    PrefilterType prefilterType = PREFILTER_GAUSSIAN;
+    bool tiled = false;
+    int tileRows = 0;
+
+    void configure(AGMM &agmm, int numberOfThreads) const;
+
+    bool initialize(AGMM &agmm) const;
+
+    void startProfiling(AGMM &agmm, StageProfiler &profiler, const string &outputPath) const;
+
+    BatchResult processVideo(const string &videoPath, const string &outputPath) const;
+
+    void runHosted(const vector<string> &outputPaths, vector<BatchResult> &results) const;
+
+public:
+    /**
+     * @param videoPaths The videos to process.
+     * @param outputDirectory The directory the outputs are written to, created if missing.
+     * @param numberOfJobs The number of videos processed at the same time, 0 for one per core.
+     */
+    BatchProcessor(const vector<string> &videoPaths, const string &outputDirectory, int numberOfJobs = 0);
+
+    /**
+     * Expand a video argument: a directory gives the video files it contains, a .txt or
+     * .list file gives the paths listed one per line, anything else is taken as a video.
+     * @param path The argument.
+     * @return The video paths.
+     */
+    static vector<string> expandVideoPaths(const string &path);
+
+    /**
+     * @param threadsPerJob The row stripes of each AGMM, 0 to share the cores between the jobs.
+     * When hosted, the number of workers of the shared pool, 0 for one per core.
+     */
+    void setThreadsPerJob(int threadsPerJob);
+
+    void setModelPrecision(ModelPrecision modelPrecision);
+
+    /**
+     * @param pipelined True to run each video through a FramePipeline.
+     */
+    void setPipelined(bool pipelined);
+
+    /**
+     * Profile every video into <output name>.profile.<format> next to its output.
+     * @param profileFormat "csv" or "json", empty to disable profiling.
+     * @param profileInterval The number of frames per export, see StageProfiler::setExport.
+     */
+    void setProfiling(const string &profileFormat, unsigned long profileInterval);
+
+    /**
+     * Run the model of every video on reduced frames, see AGMM::setPyramidScale.
+     */
+    void setPyramidScale(int scale);
+
+    /**
+     * Start every video from a checkpoint instead of its first frames, see AGMM::loadCheckpoint.
+     * @param checkpointPath The checkpoint, empty to initialize from each video.
+     */
+    void setCheckpoint(const string &checkpointPath);
+
+    /**
+     * Skip the update of static blocks in every video, see AGMM::setChangeGating.
+     */
+    void setChangeGating(int blockSize, double sensitivity, GateReference reference);
+
+    /**
+     * Run all videos at the same time as the streams of one StreamHost instead of a fixed
+     * number of jobs with their own threads. The number of jobs and the pipeline are ignored.
+     * @param hosted True to share one work-stealing pool between all videos.
+     */
+    void setHosted(bool hosted);
+
+    /**
+     * @param videoPath A video as it was given.
+     * @param priority The priority of its frames when hosted, normal if not set.
+     */
+    void setPriority(const string &videoPath, TaskPriority priority);
+
+    /**
+     * Write only the masks of every video, into a mask archive <name>.masks instead of a video.
+     * @param contents ARCHIVE_RUNS, ARCHIVE_BLOBS or both, see MaskArchiveWriter. 0 for a video.
+     */
+    void setArchive(int contents);
+
+    /**
+     * Initialize every model with the same seed, see AGMM::setRandomSeed.
+     */
+    void setRandomSeed(uint64 seed);
+
+    /**
+     * Read every video as raw BGR frames, see FrameSource.
+     * @param frameSize The size of the frames, empty if the videos are not raw.
+     * @param frameRate The frame rate of the videos.
+     */
+    void setRawFrameSize(Size frameSize, double frameRate);
+
+    /**
+     * Filter the frames of every model with the same prefilter, see AGMM::setPrefilter.
+     */
+    void setPrefilter(PrefilterType type);
+
+    /**
+     * Run the per-pixel stages of every model band by band, see AGMM::setTiling.
+     */
+    void setTiling(bool enabled, int tileRows = 0);
+
+    /**
+     * Process every video and wait for all of them.
+     * @return One result per video, in the order the videos were given.
+     */
+    vector<BatchResult> run();
+};
+
+#endif
@@ -0,0 +1,138 @@
+#ifndef BoundedQueue_H
+#define BoundedQueue_H
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+using namespace std;
+
+/**
+ * Occupancy and waiting times of a BoundedQueue.
+ */
+struct BoundedQueueStats
+{
+    size_t capacity;
+    size_t depth;
+    size_t maximumDepth;
+    size_t pushed;
+    // Seconds producers spent blocked on a full queue
+    double pushStallTime;
+    // Seconds consumers spent blocked on an empty queue
+    double popStallTime;
+};
+
+/**
+ * FIFO queue of fixed capacity shared between threads. push blocks while the queue is full,
+ * which gives backpressure to the producer, and pop blocks while it is empty.
+ * After close, push fails and pop drains the remaining items before failing.
+ */
+template <typename T>
+class BoundedQueue
+{
+private:
+    size_t capacity;
+    deque<T> items;
+    bool closed = false;
+
+    size_t maximumDepth = 0;
+    size_t pushed = 0;
+    double pushStallTime = 0;
+    double popStallTime = 0;
+
+    mutable mutex lock;
+    condition_variable notFull;
+    condition_variable notEmpty;
+
+    static double secondsSince(chrono::steady_clock::time_point start)
+    {
+        return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    }
+
+public:
+    /**
+     * @param capacity The maximum number of queued items, at least 1.
+     */
+    explicit BoundedQueue(size_t capacity) : capacity(capacity > 0 ? capacity : 1)
+    {
+    }
+
+    /**
+     * Append an item, waiting for space.
+     * @param item The item to append.
+     * @return False if the queue was closed, the item is then dropped.
+     */
+    bool push(T item)
+    {
+        unique_lock<mutex> guard(this->lock);
+        if (this->items.size() >= this->capacity && !this->closed)
+        {
+            auto start = chrono::steady_clock::now();
+            this->notFull.wait(guard, [this]
+                               { return this->items.size() < this->capacity || this->closed; });
+            this->pushStallTime += secondsSince(start);
+        }
+
+        if (this->closed)
+        {
+            return false;
+        }
+
+        this->items.push_back(move(item));
+        this->pushed++;
+        this->maximumDepth = max(this->maximumDepth, this->items.size());
+        guard.unlock();
+        this->notEmpty.notify_one();
+        return true;
+    }
+
+    /**
+     * Remove the oldest item, waiting for one to arrive.
+     * @param item Receives the item.
+     * @return False once the queue is closed and empty.
+     */
+    bool pop(T &item)
+    {
+        unique_lock<mutex> guard(this->lock);
+        if (this->items.empty() && !this->closed)
+        {
+            auto start = chrono::steady_clock::now();
+            this->notEmpty.wait(guard, [this]
+                                { return !this->items.empty() || this->closed; });
+            this->popStallTime += secondsSince(start);
+        }
+
+        if (this->items.empty())
+        {
+            return false;
+        }
+
+        item = move(this->items.front());
+        this->items.pop_front();
+        guard.unlock();
+        this->notFull.notify_one();
+        return true;
+    }
+
+    /**
+     * Stop accepting items and wake every waiting thread.
+     */
+    void close()
+    {
+        {
+            lock_guard<mutex> guard(this->lock);
+            this->closed = true;
+        }
+        this->notFull.notify_all();
+        this->notEmpty.notify_all();
+    }
+
+    BoundedQueueStats getStats() const
+    {
+        lock_guard<mutex> guard(this->lock);
+        return BoundedQueueStats{this->capacity, this->items.size(), this->maximumDepth, this->pushed, this->pushStallTime, this->popStallTime};
+    }
+};
+
+#endif
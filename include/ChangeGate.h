@@ -0,0 +1,111 @@
+#ifndef ChangeGate_H
+#define ChangeGate_H
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+using namespace cv;
+using namespace std;
+
+/**
+ * What the blocks of a frame are compared with to decide whether they changed.
+ */
+enum GateReference
+{
+    // The current background, so slow drifts add up until the block is updated again
+    GATE_BACKGROUND,
+    // The previous frame, which only catches changes between consecutive frames
+    GATE_PREVIOUS_FRAME
+};
+
+/**
+ * Splits the frame into square blocks and marks the blocks whose pixels all stay within
+ * sensitivity of a reference image as static. AGMM skips the mixture update of static
+ * blocks and repeats their previous foreground mask. For every block the number of frames
+ * skipped in a row is kept, so the decay they missed can be applied when it becomes active,
+ * and a block skipped for the longest allowed gap is made active.
+ */
+class ChangeGate
+{
+private:
+    int rows = 0;
+    int cols = 0;
+    int blockSize = 0;
+    int blockRows = 0;
+    int blockCols = 0;
+    double sensitivity = 0;
+    GateReference reference = GATE_BACKGROUND;
+    unsigned int maximumSkippedFrames = 0;
+
+    vector<uchar> active;
+    vector<unsigned int> skippedFrames;
+    Mat previousFrame;
+    Mat previousForeground;
+
+    unsigned long long numberOfBlocks = 0;
+    unsigned long long numberOfSkippedBlocks = 0;
+
+public:
+    ChangeGate();
+
+    /**
+     * @param rows The height of the frames.
+     * @param cols The width of the frames.
+     * @param blockSize The side of the blocks in pixels, 0 disables the gate.
+     * @param sensitivity The largest difference of any channel a static block may have.
+     * @param reference The image the frames are compared with.
+     * @param maximumSkippedFrames The most frames a block is skipped in a row before it is
+     * updated anyway, 0 for no limit.
+     */
+    ChangeGate(int rows, int cols, int blockSize, double sensitivity, GateReference reference, unsigned int maximumSkippedFrames = 0);
+
+    bool isEnabled() const;
+
+    /**
+     * Decide which blocks of some block rows changed. Disjoint ranges may run concurrently.
+     * Every block is active on the first frame.
+     * @param frame The blurred frame.
+     * @param background The background before the update with the frame.
+     * @param blockRange The block rows to classify.
+     */
+    void classify(const Mat &frame, const Mat &background, const Range &blockRange);
+
+    /**
+     * @param background The background before the update with the frame.
+     * @return The image static blocks matched, the value their skipped updates are decayed with.
+     */
+    const Mat &getReference(const Mat &background) const;
+
+    /**
+     * @return The foreground mask of the previous frame, repeated in static blocks.
+     */
+    const Mat &getPreviousForeground() const;
+
+    bool isActive(int blockRow, int blockCol) const;
+
+    /**
+     * @return The number of frames the block was static before the current one.
+     */
+    unsigned int getSkippedFrames(int blockRow, int blockCol) const;
+
+    /**
+     * Count the static blocks and remember the frame and its mask for the next one.
+     * @param frame The blurred frame.
+     * @param foregroundMask The foreground mask of the frame.
+     * @return The number of blocks skipped on this frame.
+     */
+    unsigned int finishFrame(const Mat &frame, const Mat &foregroundMask);
+
+    int getBlockSize() const;
+
+    int getBlockRows() const;
+
+    int getBlockCols() const;
+
+    /**
+     * @return The fraction of blocks skipped since the gate was created.
+     */
+    double getSkippedFraction() const;
+};
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef ComponentFilter_H
+#define ComponentFilter_H
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+using namespace cv;
+using namespace std;
+
+/**
+ * A foreground blob of a cleaned mask: an 8-connected component with its holes filled.
+ */
+struct Blob
+{
+    Rect boundingBox;
+    // Pixels of the blob, holes included
+    int area;
+    Point2d centroid;
+};
+
+/**
+ * Removes small components from a binary mask and fills the holes of the others. A single
+ * raster scan traces every 8-connected component once and gathers its bounding box, area
+ * and centroid on the way, so small specks cost a few pixel visits and nothing is redrawn.
+ * The buffers are allocated once for a frame size and reused.
+ */
+class ComponentFilter
+{
+private:
+    // Pixels of the component being traced and of the outside of its bounding box, as row * cols + col
+    vector<int> componentPixels;
+    vector<int> outsidePixels;
+    // Marks pixels reached from the border of a bounding box, cleared again after every component
+    vector<uchar> outside;
+
+    void fillComponent(Mat &mask, const Rect &box, int minimumArea, vector<Blob> *blobs);
+
+public:
+    /**
+     * Size the buffers for a mask.
+     * @param rows The height of the masks.
+     * @param cols The width of the masks.
+     */
+    void allocate(int rows, int cols);
+
+    /**
+     * Keep the components whose bounding box is wider and taller than minimumSize and whose
+     * area, holes included, is at least minimumArea, with their holes filled.
+     * @param mask The mask, 0 or 255, cleaned in place.
+     * @param minimumSize The largest width or height of a removed component.
+     * @param minimumArea The smallest area of a kept component.
+     * @param blobs If not null, receives the kept blobs in raster order of their first pixel. Its
+     * capacity is raised to the most blobs a mask of this size can hold, so reusing it does not allocate.
+     */
+    void apply(Mat &mask, int minimumSize, int minimumArea, vector<Blob> *blobs);
+};
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef FramePipeline_H
+#define FramePipeline_H
+
+#include "AGMM.h"
+#include "BoundedQueue.h"
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+using namespace cv;
+using namespace std;
+
+/**
+ * A frame travelling through the pipeline.
+ */
+struct PipelineFrame
+{
+    unsigned long index;
+    Mat frame;
+    Mat foregroundMask;
+    Mat background;
+    Mat mask;
+    Mat result;
+    vector<Blob> blobs;
+};
+
+/**
+ * Activity of one pipeline stage.
+ */
+struct PipelineStageStats
+{
+    string name;
+    size_t frames;
+    // Seconds spent working on frames
+    double busyTime;
+    // Seconds spent waiting for the previous stage
+    double inputWaitTime;
+    // Seconds spent blocked because the next stage was behind
+    double outputStallTime;
+    size_t queueCapacity;
+    size_t queueDepth;
+    size_t maximumQueueDepth;
+};
+
+/**
+ * Runs the stages of AGMM on consecutive frames concurrently: decoding, the model update,
+ * post-processing (shadow removal and mask cleaning) and a caller-supplied output stage,
+ * for example encoding. Each stage has one thread and hands frames to the next through a
+ * BoundedQueue, so a slow stage holds back the ones before it and frames leave the
+ * pipeline in video order.
+ */
+class FramePipeline
+{
+private:
+    AGMM &agmm;
+
+    BoundedQueue<PipelineFrame> decoded;
+    BoundedQueue<PipelineFrame> updated;
+    BoundedQueue<PipelineFrame> processed;
+
+    // Items the output stage is done with, decode fills them again so their buffers are reused
+    vector<PipelineFrame> spare;
+    mutex spareLock;
+
+    // Written by the stage threads while getStats may read them, busy time in ticks of getTickCount
+    atomic<size_t> frames[4] = {};
+    atomic<int64> busyTicks[4] = {};
+
+    void decodeStage();
+    void modelStage();
+    void postStage();
+
+    void stop();
+
+public:
+    /**
+     * @param agmm The initialized algorithm, only used by the pipeline while run is active.
+     * @param queueDepth The number of frames each queue holds.
+     */
+    FramePipeline(AGMM &agmm, size_t queueDepth = 4);
+
+    /**
+     * Process the video until it ends or output returns false.
+     * @param output Called on the calling thread for each frame, in video order. The item is
+     * reused for a later frame once output returns, so copy what must outlive the call.
+     */
+    void run(const function<bool(PipelineFrame &)> &output);
+
+    /**
+     * Safe to call while run is active, frame counts and times are complete once it returns.
+     * @return The stats of the decode, model, post and output stages.
+     */
+    vector<PipelineStageStats> getStats() const;
+};
+
+#endif
@@ -0,0 +1,113 @@
+#ifndef FrameSource_H
+#define FrameSource_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+using namespace cv;
+using namespace std;
+
+/**
+ * Encoding of the frames of a FrameSource.
+ */
+enum FrameFormat
+{
+    // Decoded by OpenCV's VideoCapture
+    FRAME_FORMAT_VIDEO,
+    // Headerless BGR frames of a given size, back to back
+    FRAME_FORMAT_RAW,
+    // YUV4MPEG2 with 4:2:0 or monochrome frames
+    FRAME_FORMAT_Y4M
+};
+
+/**
+ * Reads the frames of a video file, of a raw BGR or Y4M file, or of standard input.
+ * Raw and Y4M files are mapped: a raw frame is returned as a read-only header on the
+ * mapping without copying, and a Y4M frame is converted to BGR straight from it.
+ * Standard input is read frame by frame into the caller's buffer, so footage decoded once
+ * can be piped or replayed without paying for the decoding again.
+ */
+class FrameSource
+{
+private:
+    FrameFormat format = FRAME_FORMAT_VIDEO;
+    VideoCapture cap;
+
+    int rows = 0;
+    int cols = 0;
+    double frameRate = 0;
+
+    // Mapped file, or the stream when it cannot be mapped
+    void *mapping = nullptr;
+    size_t mappingSize = 0;
+    FILE *stream = nullptr;
+    bool ownsStream = false;
+
+    // Offset of every frame of a mapped file, past its Y4M frame header
+    vector<size_t> offsets;
+    size_t nextFrame = 0;
+    size_t frameSize = 0;
+    bool monochrome = false;
+    Mat planes;
+    bool opened = false;
+    string error;
+
+    bool openStream(const string &path, Size rawFrameSize, double rawFrameRate);
+
+    bool parseY4MHeader(const string &line);
+
+    void indexFrames(size_t headerSize);
+
+    bool readStream(Mat &frame);
+
+    void convert(const uchar *data, Mat &frame);
+
+public:
+    FrameSource() = default;
+
+    FrameSource(const FrameSource &) = delete;
+
+    FrameSource &operator=(const FrameSource &) = delete;
+
+    ~FrameSource();
+
+    /**
+     * Open a source. A .y4m file or a stream starting with a Y4M header is read as Y4M,
+     * a given raw frame size selects raw BGR, anything else is opened with VideoCapture.
+     * @param path The file, "-" for standard input.
+     * @param rawFrameSize The size of raw frames, empty if the input is not raw.
+     * @param rawFrameRate The frame rate of raw frames, which do not store one.
+     * @return False if the input cannot be opened or is not a supported format, see getError.
+     */
+    bool open(const string &path, Size rawFrameSize = Size(), double rawFrameRate = 25);
+
+    void release();
+
+    bool isOpened() const;
+
+    /**
+     * Read the next frame.
+     * @param frame Receives the frame, BGR. A raw frame of a file is a header on the mapping,
+     * which must not be written and is valid until the source is released.
+     * @return False at the end of the input.
+     */
+    bool read(Mat &frame);
+
+    FrameFormat getFormat() const;
+
+    int getRows() const;
+
+    int getCols() const;
+
+    /**
+     * @return The frame rate, 0 if the input does not store one.
+     */
+    double getFrameRate() const;
+
+    const string &getError() const;
+};
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef FrameWorkspace_H
+#define FrameWorkspace_H
+
+#include "ComponentFilter.h"
+#include "Prefilter.h"
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+using namespace cv;
+using namespace std;
+
+/**
+ * Row buffers of the shadow test for one stripe of rows, see ShadowDifferences in AGMM.cpp.
+ */
+struct ShadowRows
+{
+    // Ring of three rows of differences, an entry is valid when its stamp is the row index plus one
+    vector<uchar> hueDifferences;
+    vector<uchar> saturationDifferences;
+    vector<int> rowStamps;
+
+    // Column sums over the window rows of the current row
+    vector<int> hueSums;
+    vector<int> saturationSums;
+    vector<int> columnStamps;
+
+    vector<int> candidates;
+};
+
+/**
+ * Buffers written by updateModel on every frame. They are sized when the model is initialized
+ * and only reused afterwards, so the update does not allocate.
+ */
+struct UpdateWorkspace
+{
+    // The blurred, and with a pyramid reduced, frame the mixtures see
+    Mat workingFrame;
+    Mat resizedFrame;
+    // One per stripe of rows of the fixed-point prefilter
+    vector<PrefilterRows> prefilterRows;
+    // Two per stripe of the bands of processFrame, the rows at its borders that wait for the neighbouring stripes
+    vector<int> deferredRows;
+
+    // Mask refinement of the pyramid
+    Mat coarseMask;
+    Mat dilatedMask;
+    Mat erodedMask;
+    Mat refinementRows;
+
+    // Intermediate results of processFrame, which passes them from updateModel to postProcess
+    Mat foregroundMask;
+    Mat background;
+};
+
+/**
+ * Buffers written by postProcess on every frame. Kept apart from UpdateWorkspace, because the
+ * pipeline runs postProcess on one frame while updateModel runs on the next.
+ */
+struct PostProcessWorkspace
+{
+    // One per stripe of rows, each worker takes its own
+    vector<ShadowRows> shadowRows;
+
+    // The rows of the mask after the first pass of the opening and closing
+    Mat cleaningRows;
+    ComponentFilter componentFilter;
+};
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef HSVConversion_H
+#define HSVConversion_H
+
+#include <opencv2/opencv.hpp>
+
+using namespace cv;
+using namespace std;
+
+/**
+ * Per-pixel BGR to HSV conversion giving the same values as cvtColor with COLOR_BGR2HSV
+ * on 8-bit images: hue in 0..179, saturation and value in 0..255. Used where only a few
+ * pixels of an image are needed.
+ */
+class HSVConversion
+{
+private:
+    static const int shift = 12;
+
+    int saturationDivision[256];
+    int hueDivision[256];
+
+    HSVConversion()
+    {
+        // Same fixed-point reciprocals as OpenCV
+        saturationDivision[0] = 0;
+        hueDivision[0] = 0;
+        for (int i = 1; i < 256; i++)
+        {
+            saturationDivision[i] = saturate_cast<int>((255 << shift) / (1. * i));
+            hueDivision[i] = saturate_cast<int>((180 << shift) / (6. * i));
+        }
+    }
+
+public:
+    static const HSVConversion &getInstance()
+    {
+        static const HSVConversion instance;
+        return instance;
+    }
+
+    Vec3b convert(const Vec3b &bgr) const
+    {
+        int b = bgr[0], g = bgr[1], r = bgr[2];
+        int v = max(max(b, g), r);
+        int difference = v - min(min(b, g), r);
+
+        int vr = v == r ? -1 : 0;
+        int vg = v == g ? -1 : 0;
+
+        int s = (difference * this->saturationDivision[v] + (1 << (shift - 1))) >> shift;
+        int h = (vr & (g - b)) + (~vr & ((vg & (b - r + 2 * difference)) + ((~vg) & (r - g + 4 * difference))));
+        h = (h * this->hueDivision[difference] + (1 << (shift - 1))) >> shift;
+        h += h < 0 ? 180 : 0;
+
+        return Vec3b(static_cast<uchar>(h), static_cast<uchar>(s), static_cast<uchar>(v));
+    }
+};
+
+#endif
@@ -0,0 +1,170 @@
+#ifndef MaskArchive_H
+#define MaskArchive_H
+
+#include "ComponentFilter.h"
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+using namespace cv;
+using namespace std;
+
+/**
+ * What a mask archive stores for every frame, the values can be combined.
+ */
+enum MaskArchiveContent
+{
+    ARCHIVE_RUNS = 1,
+    ARCHIVE_BLOBS = 2
+};
+
+/**
+ * Fixed-size header at the start of a mask archive. The frames follow, each a 32-bit
+ * payload size and the payload: the foreground runs, then the blobs, as enabled by contents.
+ * Closing the archive appends the index, one 64-bit file offset per frame, at indexOffset.
+ */
+struct MaskArchiveHeader
+{
+    char magic[8];
+    uint32_t version;
+    // Written as 0x01020304, reads differently on a machine of the other byte order
+    uint32_t byteOrder;
+
+    uint32_t rows;
+    uint32_t cols;
+    uint32_t contents;
+    uint32_t reserved;
+    double frameRate;
+
+    // Both 0 until the archive is closed
+    uint64_t numberOfFrames;
+    uint64_t indexOffset;
+};
+
+/**
+ * Streams the masks of a video into a mask archive. A mask is stored as the lengths of its
+ * alternating background and foreground runs in raster order, as variable-length integers,
+ * so a frame without foreground takes a few bytes. Blobs are stored with their bounding box,
+ * area and centroid.
+ */
+class MaskArchiveWriter
+{
+private:
+    ofstream out;
+    MaskArchiveHeader header;
+    vector<uint64_t> offsets;
+    uint64_t position = 0;
+    // Start and length of every foreground run of the current mask
+    vector<uint32_t> runs;
+    vector<uchar> payload;
+    string error;
+
+public:
+    MaskArchiveWriter() = default;
+
+    MaskArchiveWriter(const MaskArchiveWriter &) = delete;
+
+    MaskArchiveWriter &operator=(const MaskArchiveWriter &) = delete;
+
+    /**
+     * Close the archive if it is open.
+     */
+    ~MaskArchiveWriter();
+
+    /**
+     * Create an archive, replacing the file.
+     * @param path The file.
+     * @param rows The height of the masks.
+     * @param cols The width of the masks.
+     * @param frameRate The frame rate of the video.
+     * @param contents ARCHIVE_RUNS, ARCHIVE_BLOBS or both.
+     * @return False if the file cannot be written, see getError.
+     */
+    bool open(const string &path, int rows, int cols, double frameRate, int contents);
+
+    bool isOpened() const;
+
+    /**
+     * Append the next frame.
+     * @param mask The mask, CV_8UC1 of the archive size, nonzero pixels are foreground.
+     * @param blobs The blobs of the mask, ignored without ARCHIVE_BLOBS.
+     * @return False if the mask does not fit the archive or the file cannot be written.
+     */
+    bool write(const Mat &mask, const vector<Blob> &blobs);
+
+    /**
+     * Append the index and complete the header. An archive that is never closed can still be
+     * read, its frames are then found by walking the file.
+     * @return False if the file cannot be written.
+     */
+    bool close();
+
+    const string &getError() const;
+};
+
+/**
+ * Reads a mask archive. The file is mapped, so opening reads the index only and any frame
+ * is decoded straight from the mapping, in any order.
+ */
+class MaskArchiveReader
+{
+private:
+    void *mapping = nullptr;
+    size_t mappingSize = 0;
+    MaskArchiveHeader header;
+    vector<uint64_t> offsets;
+    string error;
+
+    void unmap();
+
+    bool getPayload(size_t frame, const uchar *&begin, const uchar *&end);
+
+public:
+    MaskArchiveReader() = default;
+
+    MaskArchiveReader(const MaskArchiveReader &) = delete;
+
+    MaskArchiveReader &operator=(const MaskArchiveReader &) = delete;
+
+    ~MaskArchiveReader();
+
+    /**
+     * Map an archive. The index of an archive that was not closed is rebuilt from its
+     * frames, up to the last complete one.
+     * @param path The file.
+     * @return False if the file cannot be read or is not a mask archive, see getError.
+     */
+    bool open(const string &path);
+
+    size_t getNumberOfFrames() const;
+
+    int getRows() const;
+
+    int getCols() const;
+
+    double getFrameRate() const;
+
+    int getContents() const;
+
+    /**
+     * Decode the mask of a frame.
+     * @param frame The index of the frame, from 0.
+     * @param mask Receives the mask, CV_8UC1 with 0 and 255, written in place if it has the archive size.
+     * @return False if the frame does not exist, has no runs or is damaged, see getError.
+     */
+    bool readMask(size_t frame, Mat &mask);
+
+    /**
+     * Decode the blobs of a frame.
+     * @param frame The index of the frame, from 0.
+     * @param blobs Receives the blobs.
+     * @return False if the frame does not exist, has no blobs or is damaged, see getError.
+     */
+    bool readBlobs(size_t frame, vector<Blob> &blobs);
+
+    const string &getError() const;
+};
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef MaskMorphology_H
+#define MaskMorphology_H
+
+#include <opencv2/opencv.hpp>
+
+using namespace cv;
+
+/**
+ * Dilation and erosion of 8-bit masks by a square, as a pass along the rows followed by a
+ * pass along the columns. Pixels outside of the mask are left out of the windows, like the
+ * default border of OpenCV's morphology, so the result equals dilate and erode with a
+ * rectangular element. Both passes work on a range of rows, so they can run in stripes,
+ * and only write buffers the caller allocated.
+ */
+
+/**
+ * Take the maximum or minimum over a window of each row.
+ * @param mask The mask.
+ * @param rowFiltered Receives the filtered rows, the size of the mask and not the mask itself.
+ * @param range The rows to filter.
+ * @param radius The window spans 2 * radius + 1 columns.
+ * @param dilate True for the maximum, false for the minimum.
+ */
+void filterMaskRows(const Mat &mask, Mat &rowFiltered, const Range &range, int radius, bool dilate);
+
+/**
+ * Take the maximum or minimum over a window of each column, once the rows are filtered.
+ * @param rowFiltered The output of filterMaskRows, complete for every row in the windows of the range.
+ * @param filtered Receives the dilated or eroded mask, it may be the mask filterMaskRows read.
+ * @param range The rows to filter.
+ * @param radius The window spans 2 * radius + 1 rows.
+ * @param dilate True for the maximum, false for the minimum.
+ */
+void filterMaskColumns(const Mat &rowFiltered, Mat &filtered, const Range &range, int radius, bool dilate);
+
+#endif
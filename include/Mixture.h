@@ -17,7 +17,7 @@ private:
 
     vector<Gaussian> gaussians;
 
-    vector<Vec3b> randomSamplePixel(vector<Vec3b> pixels, int index);
+    vector<Vec3b> randomSamplePixel(vector<Vec3b> pixels, int N, RNG &rng);
 
 public:
     /**
@@ -33,10 +33,18 @@ public:
 
     /**
      * Initialize the mixture.
-     * @param pixels The pixels to initialize the mixture with.
+     * @param pixels The pixels to initialize the mixture with, at least one. With fewer pixels
+     * than components, every pixel is used and they are reused cyclically.
      */
     void initializeMixture(vector<Vec3b> pixels);
 
+    /**
+     * Initialize the mixture with the samples drawn from a given generator, for reproducible runs.
+     * @param pixels The pixels to initialize the mixture with, at least one.
+     * @param rng The generator, one per thread.
+     */
+    void initializeMixture(vector<Vec3b> pixels, RNG &rng);
+
     /**
      * Update the mixture.
      * @param pixel The pixel to update the mixture with.
@@ -0,0 +1,28 @@
+#ifndef MixtureKernel_H
+#define MixtureKernel_H
+
+#include "MixturePlanes.h"
+
+/**
+ * Instruction sets the mixture update can run with.
+ */
+enum MixtureKernelType
+{
+    KERNEL_AUTO,
+    KERNEL_SCALAR,
+    KERNEL_SSE41,
+    KERNEL_AVX2,
+    KERNEL_AVX512
+};
+
+/**
+ * Pick the row kernel for the requested instruction set.
+ * KERNEL_AUTO and instruction sets the CPU lacks fall back to the widest supported one.
+ * @param type The requested type, replaced by the type that was selected.
+ * @return The kernel, or nullptr when the scalar update should be used.
+ */
+MixtureRowKernel getMixtureRowKernel(MixtureKernelType &type);
+
+const char *getMixtureKernelName(MixtureKernelType type);
+
+#endif
@@ -0,0 +1,225 @@
+#ifndef MixtureModel_H
+#define MixtureModel_H
+
+#include "MixtureKernel.h"
+#include "MixtureStorage.h"
+#include <functional>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+using namespace cv;
+using namespace std;
+
+/**
+ * Contiguous structure-of-arrays store for the Gaussian mixtures of every pixel.
+ * Each component parameter lives in its own plane, and every plane holds
+ * numberOfGaussians rows of pixelStride values, so component k of pixel p is
+ * stored at index k * pixelStride + p. Rows are padded to 64 bytes.
+ * The planes hold doubles, floats or 16-bit fixed-point values, see ModelPrecision.
+ * The update is specialized at compile time for 3, 5 and 7 components.
+ */
+class MixtureModel
+{
+private:
+    int numberOfGaussians;
+    unsigned int numberOfPixels;
+    unsigned int pixelStride;
+
+    double alpha;
+    double upperboundVariance;
+    double lowerboundVariance;
+
+    ModelPrecision precision;
+
+    void *buffer;
+    // Set when the planes belong to someone else, called instead of freeing the buffer
+    function<void()> releasePlanes;
+    void *meanB;
+    void *meanG;
+    void *meanR;
+    void *variance;
+    void *weight;
+    void *weightDistrRatio;
+
+    MixtureKernelType kernelType;
+    MixtureRowKernel rowKernel;
+
+    bool (MixtureModel::*updatePixelFunction)(unsigned int pixel, const Vec3b &value, double threshold, bool *matched);
+    void (MixtureModel::*updateRowFunction)(unsigned int firstPixel, unsigned int count, const Vec3b *pixels, double threshold, uchar *foreground, unsigned int *unmatched);
+
+    void allocate();
+
+    void assignPlanes(uchar *block);
+
+    void release();
+
+    void selectSpecialization();
+
+    template <typename T>
+    void selectSpecialization();
+
+    template <int K, typename T>
+    void reorderPixel(unsigned int pixel);
+
+    template <typename T>
+    void initializePixelT(unsigned int pixel, const Vec3b *samples, int count);
+
+    template <typename T>
+    bool isBackgroundT(unsigned int pixel, const Vec3b &value, double threshold) const;
+
+    template <typename T>
+    void decayPixelT(unsigned int pixel, const Vec3b &value, unsigned int frames);
+
+    // Apply the weight updates of frames in which the same components match, the weights are not normalized
+    void decayWeights(double *weights, const bool *matches, unsigned int frames) const;
+
+    template <int K, typename T>
+    bool updatePixelK(unsigned int pixel, const Vec3b &value, double threshold, bool *matched);
+
+    template <int K, typename T>
+    void updateRowK(unsigned int firstPixel, unsigned int count, const Vec3b *pixels, double threshold, uchar *foreground, unsigned int *unmatched);
+
+    double getValue(const void *plane, double scale, unsigned int pixel, int component) const;
+
+public:
+    static const int maximumNumberOfGaussians = MixturePlanes::maximumNumberOfGaussians;
+
+    MixtureModel();
+
+    /**
+     * Create the model store.
+     * @param numberOfPixels The number of pixels in the frame.
+     * @param numberOfGaussians The number of Gaussian components per pixel.
+     * @param alpha The learning rate.
+     * @param upperboundVariance The upper bound of the variance.
+     * @param lowerboundVariance The lower bound of the variance.
+     * @param precision The element type of the planes.
+     */
+    MixtureModel(unsigned int numberOfPixels, int numberOfGaussians, double alpha, double upperboundVariance, double lowerboundVariance, ModelPrecision precision = PRECISION_DOUBLE);
+
+    /**
+     * Create the model store on planes filled elsewhere, such as a mapped checkpoint.
+     * @param planes The six planes in the layout of getPlanes, aligned to 64 bytes.
+     * @param releasePlanes Called once when the model no longer uses the planes.
+     * The other parameters are those of the allocating constructor.
+     */
+    MixtureModel(unsigned int numberOfPixels, int numberOfGaussians, double alpha, double upperboundVariance, double lowerboundVariance, ModelPrecision precision, void *planes, const function<void()> &releasePlanes);
+
+    MixtureModel(const MixtureModel &) = delete;
+
+    MixtureModel &operator=(const MixtureModel &) = delete;
+
+    MixtureModel(MixtureModel &&other) noexcept;
+
+    MixtureModel &operator=(MixtureModel &&other) noexcept;
+
+    ~MixtureModel();
+
+    /**
+     * Initialize the mixture of one pixel from samples the caller has drawn, same as
+     * Mixture::initializeMixture after its random sampling. Component i is centred on
+     * sample i; with fewer samples than components they are reused cyclically.
+     * @param pixel The index of the pixel.
+     * @param samples The samples to initialize the mixture with.
+     * @param count The number of samples, at least 1.
+     */
+    void initializePixel(unsigned int pixel, const Vec3b *samples, int count);
+
+    /**
+     * Update the mixture of one pixel, same as Mixture::updateMixture up to rounding. The
+     * weights are normalized by multiplying with the inverse of their sum, which differs from
+     * the original by a unit in the last place. Every ratio is recomputed from its normalized
+     * weight, so components of the same weight and variance tie and keep their order as in
+     * the original. The last component is replaced without being updated first.
+     * @param pixel The index of the pixel.
+     * @param value The pixel to update the mixture with.
+     * @param threshold The threshold to use for updating the mixture.
+     * @return True if the pixel is background, false if it is foreground.
+     */
+    bool updatePixel(unsigned int pixel, const Vec3b &value, double threshold);
+
+    /**
+     * Classify a value against the mixture of a pixel without updating it, with the same
+     * test as updatePixel.
+     * @param pixel The index of the pixel.
+     * @param value The value to classify.
+     * @param threshold The threshold to use for the background components.
+     * @return True if the value is background, false if it is foreground.
+     */
+    bool isBackground(unsigned int pixel, const Vec3b &value, double threshold) const;
+
+    /**
+     * Apply the weight changes of updates that were skipped while the pixel did not change,
+     * in closed form. On every one of them the components within 3 sigma of the value match,
+     * and after the first one so does the last component, which each update replaces with one
+     * centred on the value. The weights follow updatePixel exactly as long as the order of the
+     * components and which of them match hold over the gap. updatePixel also moves the means
+     * and variances of the matching components, which can take them out of 3 sigma within a
+     * few updates and sinks them one by one to the last place over longer gaps. These are
+     * left out, so the result is an approximation that grows with the gap; AGMM updates a
+     * static block at least every tenth of 1 / alpha frames. The last component is replaced.
+     * @param pixel The index of the pixel.
+     * @param value The value the pixel had while it was skipped.
+     * @param frames The number of skipped updates.
+     */
+    void decayPixel(unsigned int pixel, const Vec3b &value, unsigned int frames);
+
+    /**
+     * Update the mixtures of a run of consecutive pixels with the selected kernel.
+     * @param firstPixel The index of the first pixel of the run.
+     * @param count The number of pixels in the run.
+     * @param pixels The pixel values of the run.
+     * @param threshold The threshold to use for updating the mixtures.
+     * @param foreground Receives 255 for foreground and 0 for background pixels.
+     * @param unmatched If not null, incremented by the number of pixels no component matched,
+     * the pixels Mixture::updateMixture meant to model with a new component.
+     */
+    void updateRow(unsigned int firstPixel, unsigned int count, const Vec3b *pixels, double threshold, uchar *foreground, unsigned int *unmatched = nullptr);
+
+    /**
+     * Select the instruction set used by updateRow.
+     * @param kernelType The requested instruction set, unsupported ones fall back to narrower ones.
+     */
+    void setKernel(MixtureKernelType kernelType);
+
+    MixtureKernelType getKernel() const;
+
+    int getNumberOfGaussians() const;
+
+    unsigned int getNumberOfPixels() const;
+
+    unsigned int getPixelStride() const;
+
+    double getAlpha() const;
+
+    double getUpperboundVariance() const;
+
+    double getLowerboundVariance() const;
+
+    ModelPrecision getPrecision() const;
+
+    /**
+     * @return The number of bytes held by the planes.
+     */
+    size_t getMemorySize() const;
+
+    /**
+     * @return The six planes, means B, G and R, variances, weights and weight ratios, each
+     * getNumberOfGaussians() * getPixelStride() elements long, getMemorySize() bytes in all.
+     */
+    const void *getPlanes() const;
+
+    double getMeanB(unsigned int pixel, int component) const;
+
+    double getMeanG(unsigned int pixel, int component) const;
+
+    double getMeanR(unsigned int pixel, int component) const;
+
+    double getVariance(unsigned int pixel, int component) const;
+
+    double getWeight(unsigned int pixel, int component) const;
+
+    double getWeightDistrRatio(unsigned int pixel, int component) const;
+};
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef MixturePlanes_H
+#define MixturePlanes_H
+
+#include <cstdint>
+
+/**
+ * Declarations shared with the vectorized mixture kernels. Their translation units are
+ * built with the -m flags of one instruction set and include nothing but this header, so
+ * it must stay free of code: any inline function or template instantiated there would be
+ * compiled for that instruction set, and the linker may keep that copy for every caller.
+ */
+
+/**
+ * Element type of the model planes. The update always computes in double and
+ * rounds every value it writes back to the storage type.
+ *
+ * PRECISION_DOUBLE: 8 bytes per value, reference results.
+ *
+ * PRECISION_FLOAT: 4 bytes per value, half the footprint. Each stored value carries
+ * a relative rounding error of at most 6e-8, i.e. below 1.6e-5 for means and 1.1e-5
+ * for variances within their clamped range.
+ *
+ * PRECISION_FIXED16: 2 bytes per value, a quarter of the footprint. Values are rounded
+ * to the steps of FixedPointScale, so each stored value is off by at most half a step:
+ * 0.0039 for means, 0.0078 for variances, 7.6e-6 for weights and 3.8e-6 for
+ * weight / sigma. Means saturate at 511.99, variances at 1023.98 and weights at
+ * 0.99998. A weight update of alpha * (1 - weight) smaller than half a step is lost,
+ * so with alpha = 0.001 a dominant weight stops growing at about 0.992. Variance bounds
+ * the planes cannot hold are rejected, see fitsPrecision.
+ */
+enum ModelPrecision
+{
+    PRECISION_DOUBLE,
+    PRECISION_FLOAT,
+    PRECISION_FIXED16
+};
+
+/**
+ * Steps of the 16-bit fixed-point planes, all powers of two so decoding is exact.
+ */
+struct FixedPointScale
+{
+    // 9.7 unsigned, means stay close to the 8-bit pixel range
+    static constexpr double mean = 128;
+    // 10.6 unsigned, variances are clamped to lowerboundVariance .. 5 * upperboundVariance
+    static constexpr double variance = 64;
+    // 0.16 unsigned
+    static constexpr double weight = 65536;
+    // 0.17 unsigned, weight / sigma is at most 1 / sqrt(lowerboundVariance)
+    static constexpr double ratio = 131072;
+    // Largest stored value, every plane saturates at maximum / its step
+    static constexpr double maximum = 65535;
+};
+
+/**
+ * Raw view of the planes of a MixtureModel, handed to the vectorized row kernels.
+ * The element type of the planes is given by precision.
+ */
+struct MixturePlanes
+{
+    static const int maximumNumberOfGaussians = 16;
+
+    void *meanB;
+    void *meanG;
+    void *meanR;
+    void *variance;
+    void *weight;
+    void *weightDistrRatio;
+
+    ModelPrecision precision;
+    unsigned int stride;
+    int numberOfGaussians;
+
+    double alpha;
+    double lowerboundVariance;
+    double upperboundVariance;
+};
+
+/**
+ * Update the mixtures of a run of consecutive pixels, several pixels per instruction.
+ * Only whole vectors are processed, the remaining pixels are left to the scalar update.
+ * The exponential in the matching probability is a polynomial approximation, so the
+ * model differs from MixtureModel::updatePixel by a relative error of about 1e-13.
+ * @param planes The model planes.
+ * @param firstPixel The index of the first pixel of the run.
+ * @param count The number of pixels in the run.
+ * @param pixels The BGR values of the run, three bytes per pixel.
+ * @param threshold The background ratio.
+ * @param foreground Receives 255 for foreground and 0 for background pixels.
+ * @param unmatched If not null, incremented by the number of processed pixels no component matched.
+ * @return The number of pixels processed.
+ */
+typedef unsigned int (*MixtureRowKernel)(const MixturePlanes &planes, unsigned int firstPixel, unsigned int count, const uint8_t *pixels, double threshold, uint8_t *foreground, unsigned int *unmatched);
+
+unsigned int updateMixtureRowSSE41(const MixturePlanes &planes, unsigned int firstPixel, unsigned int count, const uint8_t *pixels, double threshold, uint8_t *foreground, unsigned int *unmatched);
+
+unsigned int updateMixtureRowAVX2(const MixturePlanes &planes, unsigned int firstPixel, unsigned int count, const uint8_t *pixels, double threshold, uint8_t *foreground, unsigned int *unmatched);
+
+unsigned int updateMixtureRowAVX512(const MixturePlanes &planes, unsigned int firstPixel, unsigned int count, const uint8_t *pixels, double threshold, uint8_t *foreground, unsigned int *unmatched);
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef MixtureReservoir_H
+#define MixtureReservoir_H
+
+#include "MixtureModel.h"
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+using namespace cv;
+using namespace std;
+
+/**
+ * Streaming sampler for the initialization frames. Every pixel keeps a reservoir of
+ * numberOfSamples values, so after any number of frames each pixel holds a uniform
+ * sample without replacement of the frames seen so far, like Mixture::randomSamplePixel
+ * over the full history. Memory is numberOfPixels * numberOfSamples * 3 bytes no matter
+ * how many frames are added.
+ */
+class MixtureReservoir
+{
+private:
+    unsigned int numberOfPixels;
+    int numberOfSamples;
+    int numberOfFrames;
+    uint64 seed;
+
+    // Pixel-major, the samples of pixel p start at p * numberOfSamples
+    vector<Vec3b> samples;
+
+public:
+    /**
+     * @param numberOfPixels The number of pixels in the frame.
+     * @param numberOfSamples The number of samples kept per pixel.
+     * @param seed Seed of the slot choice.
+     */
+    MixtureReservoir(unsigned int numberOfPixels, int numberOfSamples, uint64 seed);
+
+    /**
+     * Add a run of consecutive pixels of the current frame. Runs of the same frame may be
+     * added concurrently as long as they do not overlap. The choice of slots only depends
+     * on the seed, the frame and firstPixel, so the result does not depend on the order.
+     * @param firstPixel The index of the first pixel of the run.
+     * @param count The number of pixels in the run.
+     * @param pixels The pixel values of the run.
+     */
+    void addPixels(unsigned int firstPixel, unsigned int count, const Vec3b *pixels);
+
+    /**
+     * Finish the current frame, once every pixel of it has been added.
+     */
+    void finishFrame();
+
+    /**
+     * Initialize the mixtures of a run of consecutive pixels from their samples.
+     * @param model The model to initialize.
+     * @param firstPixel The index of the first pixel of the run.
+     * @param count The number of pixels in the run.
+     */
+    void initializeModel(MixtureModel &model, unsigned int firstPixel, unsigned int count) const;
+
+    int getNumberOfFrames() const;
+
+    /**
+     * @return The number of bytes held by the reservoirs.
+     */
+    size_t getMemorySize() const;
+};
+
+#endif
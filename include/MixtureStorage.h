@@ -0,0 +1,81 @@
+#ifndef MixtureStorage_H
+#define MixtureStorage_H
+
+#include "MixturePlanes.h"
+#include <algorithm>
+#include <cstddef>
+
+// Conversion between the values of the update and the planes, see ModelPrecision
+template <typename T>
+inline double decodeValue(T value, double)
+{
+    return value;
+}
+
+template <>
+inline double decodeValue<uint16_t>(uint16_t value, double scale)
+{
+    return value * (1 / scale);
+}
+
+template <typename T>
+inline T encodeValue(double value, double)
+{
+    return static_cast<T>(value);
+}
+
+template <>
+inline uint16_t encodeValue<uint16_t>(double value, double scale)
+{
+    // Round half up and saturate, the vectorized kernels do the same
+    return static_cast<uint16_t>(std::min(std::max(value * scale + 0.5, 0.0), FixedPointScale::maximum));
+}
+
+/**
+ * Whether the planes of a precision hold every variance and weight ratio of a model with
+ * these bounds. Only fixed16 saturates: variances reach 5 * upperboundVariance, which must
+ * stay within 1023.98, and weight / sigma reaches 1 / sqrt(lowerboundVariance), which must
+ * stay within 0.49999, so the bounds must be at least 4.00013 and at most 204.796.
+ * @param precision The precision of the planes.
+ * @param lowerboundVariance The lower bound of the variance.
+ * @param upperboundVariance The upper bound of the variance.
+ */
+inline bool fitsPrecision(ModelPrecision precision, double lowerboundVariance, double upperboundVariance)
+{
+    if (precision != PRECISION_FIXED16)
+    {
+        return true;
+    }
+
+    const double largestRatio = FixedPointScale::maximum / FixedPointScale::ratio;
+    return 5 * upperboundVariance <= FixedPointScale::maximum / FixedPointScale::variance &&
+           lowerboundVariance * largestRatio * largestRatio >= 1;
+}
+
+inline const char *getPrecisionName(ModelPrecision precision)
+{
+    switch (precision)
+    {
+    case PRECISION_FLOAT:
+        return "float";
+    case PRECISION_FIXED16:
+        return "fixed16";
+    default:
+        return "double";
+    }
+}
+
+inline size_t getPrecisionSize(ModelPrecision precision)
+{
+    switch (precision)
+    {
+    case PRECISION_FLOAT:
+        return sizeof(float);
+    case PRECISION_FIXED16:
+        return sizeof(uint16_t);
+    default:
+        return sizeof(double);
+    }
+}
+
+#endif
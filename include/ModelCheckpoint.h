@@ -0,0 +1,105 @@
+#ifndef ModelCheckpoint_H
+#define ModelCheckpoint_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <opencv2/opencv.hpp>
+
+using namespace cv;
+using namespace std;
+
+/**
+ * Fixed-size header at the start of a checkpoint file. The planes follow at planesOffset,
+ * a multiple of the page size, in the layout of MixtureModel::getPlanes, and the reduced
+ * background follows at backgroundOffset as modelRows rows of modelCols BGR pixels.
+ */
+struct ModelCheckpointHeader
+{
+    char magic[8];
+    uint32_t version;
+    // Written as 0x01020304, reads differently on a machine of the other byte order
+    uint32_t byteOrder;
+
+    uint32_t rows;
+    uint32_t cols;
+    uint32_t scale;
+    uint32_t modelRows;
+    uint32_t modelCols;
+    int32_t numberOfGaussians;
+    uint32_t precision;
+    uint32_t pixelStride;
+
+    double alpha;
+    double backgroundRatio;
+    double upperboundVariance;
+    double lowerboundVariance;
+
+    uint64_t planesOffset;
+    uint64_t planesSize;
+    uint64_t backgroundOffset;
+    uint64_t backgroundSize;
+};
+
+/**
+ * Reads and writes the binary model checkpoints of AGMM. Reading maps the file privately,
+ * so loading only touches the header and pages are read from disk as the model uses them.
+ * Writes of the model go to its own copy of a page and never reach the file.
+ */
+class ModelCheckpoint
+{
+private:
+    void *mapping = nullptr;
+    size_t mappingSize = 0;
+    string error;
+
+    void unmap();
+
+public:
+    static const uint32_t currentVersion = 1;
+
+    ModelCheckpoint() = default;
+
+    ModelCheckpoint(const ModelCheckpoint &) = delete;
+
+    ModelCheckpoint &operator=(const ModelCheckpoint &) = delete;
+
+    ~ModelCheckpoint();
+
+    /**
+     * Write a checkpoint. The file is written under a temporary name and renamed, so an
+     * interrupted write leaves the previous checkpoint intact.
+     * @param path The file.
+     * @param header The header, magic, version, byte order and offsets are filled in.
+     * @param planes The planes, header.planesSize bytes.
+     * @param background The reduced background.
+     * @return False if the file cannot be written, see getError.
+     */
+    bool write(const string &path, ModelCheckpointHeader header, const void *planes, const Mat &background);
+
+    /**
+     * Map a checkpoint and check that it is complete and was written by this version.
+     * @param path The file.
+     * @return False if the file cannot be read or is not a checkpoint, see getError.
+     */
+    bool map(const string &path);
+
+    const ModelCheckpointHeader &getHeader() const;
+
+    void *getPlanes() const;
+
+    /**
+     * @return The background, a header on the mapping.
+     */
+    Mat getBackground() const;
+
+    /**
+     * Hand the mapping over to its new owner, typically a MixtureModel.
+     * @return Unmaps the file when called.
+     */
+    function<void()> releaseMapping();
+
+    const string &getError() const;
+};
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef ParameterSweep_H
+#define ParameterSweep_H
+
+#include "AGMM.h"
+#include <functional>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+using namespace cv;
+using namespace std;
+
+/**
+ * Score of one configuration of a sweep.
+ */
+struct SweepResult
+{
+    AGMMParameters parameters;
+    // Frames processed after the initialization, and those of them that were scored
+    unsigned long frames;
+    unsigned long scoredFrames;
+    // Time spent in processFrame, while the other configurations ran on the other cores
+    double seconds;
+    double framesPerSecond;
+    double precision;
+    double recall;
+    double f1;
+};
+
+/**
+ * Runs many AGMM configurations on the same clip and scores their masks against ground
+ * truth. Frames are read once, a batch at a time, and every configuration processes the
+ * batch on its own core before the next one is read, so a sweep costs one decode of the
+ * clip and no more memory than a batch of frames.
+ *
+ * Ground truth pixels above 192 are foreground and those below 64 background, which reads
+ * binary masks as well as the labels of the CDnet data set: its shadows (50) count as
+ * background, its unknown (170) and out of region (85) pixels are not scored.
+ */
+class ParameterSweep
+{
+private:
+    vector<AGMMParameters> configurations;
+    // Configurations the last run left out, their variance bounds do not fit the model precision
+    vector<AGMMParameters> skipped;
+    int numberOfJobs;
+    ModelPrecision modelPrecision = PRECISION_DOUBLE;
+    uint64 seed = 0;
+    int initializationFrames = 10;
+    int warmupFrames = 0;
+    int batchSize = 16;
+    string error;
+
+public:
+    /**
+     * @param configurations The configurations to run.
+     * @param numberOfJobs The number of configurations that run at the same time, 0 for one per core.
+     */
+    ParameterSweep(const vector<AGMMParameters> &configurations, int numberOfJobs = 0);
+
+    void setModelPrecision(ModelPrecision modelPrecision);
+
+    /**
+     * Initialize every model with the same seed, so configurations differ only by their parameters.
+     */
+    void setRandomSeed(uint64 seed);
+
+    /**
+     * @param frames The frames processed after the initialization before scoring starts, for the models to settle.
+     */
+    void setWarmup(int frames);
+
+    /**
+     * @param frames The number of frames read before the configurations process them.
+     */
+    void setBatchSize(int frames);
+
+    /**
+     * Run every configuration on a clip. Configurations whose variance bounds the model
+     * precision cannot hold are skipped, see fitsPrecision and getSkipped.
+     * @param nextFrame Called for each frame in order with buffers to fill, the ground
+     * truth as CV_8UC1 of the frame size. Returns false at the end of the clip.
+     * @param maximumFrames The number of frames to read at most, initialization included, 0 for all.
+     * @return The results ranked by F1 score, then by frame rate. Empty if the clip is
+     * shorter than the initialization, a ground truth does not match its frame or every
+     * configuration was skipped, see getError.
+     */
+    vector<SweepResult> run(const function<bool(Mat &frame, Mat &groundTruth)> &nextFrame, unsigned long maximumFrames = 0);
+
+    const string &getError() const;
+
+    /**
+     * @return The configurations the last run skipped.
+     */
+    const vector<AGMMParameters> &getSkipped() const;
+};
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef Prefilter_H
+#define Prefilter_H
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+using namespace cv;
+using namespace std;
+
+/**
+ * Filter applied to every frame before the mixture model sees it.
+ */
+enum PrefilterType
+{
+    // OpenCV's GaussianBlur, the original filter
+    PREFILTER_GAUSSIAN,
+    // Separable Gaussian with 8-bit integer weights and 16-bit column sums
+    PREFILTER_FIXED_GAUSSIAN,
+    // Box filter of about the variance of the Gaussian
+    PREFILTER_BOX,
+    // Frames reach the model unfiltered
+    PREFILTER_NONE
+};
+
+const char *getPrefilterName(PrefilterType type);
+
+/**
+ * Row buffers of the fixed-point Gaussian for one stripe of rows.
+ */
+struct PrefilterRows
+{
+    // Column sums of the current row, padded by the kernel radius on both sides
+    vector<ushort> sums;
+    vector<unsigned int> accumulators;
+};
+
+/**
+ * Smooths frames for the mixture model. The Gaussian of standard deviation sigma is either
+ * computed by OpenCV, or in integers: each weight is a multiple of 1/256, the vertical pass
+ * sums 8-bit pixels into 16-bit columns and the horizontal pass into 32 bits, so both
+ * passes vectorize at 8 or 16 lanes. The box filter approximates the Gaussian with the
+ * running sums of OpenCV's blur.
+ */
+class Prefilter
+{
+private:
+    PrefilterType type;
+    double sigma;
+    int kernelSize;
+    // Weights of the fixed-point kernel, they sum to 256
+    vector<int> weights;
+    int boxSize;
+
+    void applyFixedGaussian(const Mat &frame, Mat &filtered, const Range &range, PrefilterRows &rows) const;
+
+public:
+    /**
+     * @param type The filter.
+     * @param sigma The standard deviation of the Gaussian.
+     * @param kernelSize The width of the Gaussian kernel, odd, 0 to derive it from sigma as OpenCV does.
+     */
+    Prefilter(PrefilterType type = PREFILTER_GAUSSIAN, double sigma = 2, int kernelSize = 9);
+
+    PrefilterType getType() const;
+
+    /**
+     * @return True if the filter is computed by apply on row stripes, false if by applyFrame.
+     */
+    bool isRowParallel() const;
+
+    /**
+     * Size the buffers of a stripe for a frame width.
+     */
+    void allocate(PrefilterRows &rows, int cols) const;
+
+    /**
+     * Filter a whole frame with OpenCV, which uses its own threads.
+     * @param frame The BGR frame.
+     * @param filtered Receives the filtered frame, written in place if it has the frame size.
+     */
+    void applyFrame(const Mat &frame, Mat &filtered) const;
+
+    /**
+     * Filter some rows of a frame, borders are reflected as by OpenCV. OpenCV's filters read
+     * the rows around the range from the frame, so every filter writes the rows applyFrame would.
+     * @param frame The BGR frame.
+     * @param filtered The filtered frame, allocated with the frame size.
+     * @param range The rows to write, stripes may run at the same time.
+     * @param rows The buffers of the stripe, see allocate.
+     */
+    void apply(const Mat &frame, Mat &filtered, const Range &range, PrefilterRows &rows) const;
+};
+
+#endif
@@ -0,0 +1,189 @@
+#ifndef StageProfiler_H
+#define StageProfiler_H
+
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <opencv2/opencv.hpp>
+
+using namespace cv;
+using namespace std;
+
+/**
+ * Timed steps of AGMM::processNextFrame.
+ */
+enum ProfileStage
+{
+    PROFILE_CAPTURE,
+    PROFILE_BLUR,
+    PROFILE_MIXTURE_UPDATE,
+    PROFILE_MASK_REFINEMENT,
+    PROFILE_SHADOW_TEST,
+    PROFILE_MORPHOLOGY,
+    PROFILE_CONTOUR_CLEANING,
+    // Prefilter, mixture update and shadow test of the bands of a tiled frame
+    PROFILE_FUSED_TILES,
+    NUMBER_OF_PROFILE_STAGES
+};
+
+/**
+ * Histogram of durations with logarithmic buckets, eight per octave from 1 microsecond
+ * to about 2 minutes. Percentiles are read at the geometric centre of their bucket, so
+ * they are within 4.4 % of the exact value.
+ */
+class LatencyHistogram
+{
+private:
+    static const int bucketsPerOctave = 8;
+    static const int numberOfBuckets = 27 * bucketsPerOctave;
+
+    unsigned long buckets[numberOfBuckets] = {};
+    unsigned long count = 0;
+    double total = 0;
+    double maximum = 0;
+
+public:
+    /**
+     * @param seconds The duration to add.
+     */
+    void record(double seconds);
+
+    /**
+     * @param percentile The percentile, between 0 and 100.
+     * @return The duration in seconds, 0 when the histogram is empty.
+     */
+    double getPercentile(double percentile) const;
+
+    unsigned long getCount() const;
+
+    double getMean() const;
+
+    double getMaximum() const;
+
+    void reset();
+};
+
+/**
+ * Collects per-stage latency histograms and per-frame counters of an AGMM instance.
+ * Stages may be recorded from several threads. Every exportInterval frames the statistics
+ * of the frames since the previous export are appended to the export file, as CSV rows or
+ * as one JSON object per line, and the histograms start over.
+ */
+class StageProfiler
+{
+private:
+    mutable mutex lock;
+    // Held while a window is written, so the statistics stay free for recording
+    mutex exportLock;
+
+    LatencyHistogram stages[NUMBER_OF_PROFILE_STAGES];
+    unsigned long frames = 0;
+    unsigned long long pixels = 0;
+    unsigned long long foregroundPixels = 0;
+    unsigned long long updatedPixels = 0;
+    unsigned long long unmatchedPixels = 0;
+    unsigned long long gatedBlocks = 0;
+    unsigned long long skippedBlocks = 0;
+
+    unsigned long totalFrames = 0;
+
+    string exportPath;
+    ofstream exportFile;
+    bool exportJSON = false;
+    unsigned long exportInterval = 0;
+    bool isHeaderWritten = false;
+
+    // Called with the lock held through guard, returns with it released
+    void exportWindow(unique_lock<mutex> &guard);
+
+    // Callers hold the lock
+    string format(bool json, bool header) const;
+
+public:
+    static const char *getStageName(ProfileStage stage);
+
+    /**
+     * Append the statistics to a file every exportInterval frames.
+     * @param exportPath The file, JSON lines if it ends in .json and CSV otherwise.
+     * @param exportInterval The number of frames per export, 0 to only export on flush.
+     */
+    void setExport(const string &exportPath, unsigned long exportInterval);
+
+    /**
+     * @param stage The stage.
+     * @param seconds The time the stage took on one frame.
+     */
+    void recordStage(ProfileStage stage, double seconds);
+
+    /**
+     * Count the outcome of the mixture update of one frame.
+     * @param pixels The number of pixels updated.
+     * @param unmatchedPixels The number of pixels no component matched.
+     */
+    void recordUpdate(unsigned long long pixels, unsigned long long unmatchedPixels);
+
+    /**
+     * Count the outcome of the change gate on one frame.
+     * @param blocks The number of blocks of the frame.
+     * @param skippedBlocks The number of blocks whose update was skipped.
+     */
+    void recordGate(unsigned long long blocks, unsigned long long skippedBlocks);
+
+    /**
+     * Finish one frame, exporting when the interval is reached.
+     * @param pixels The number of pixels of the frame.
+     * @param foregroundPixels The number of pixels of the final mask that are foreground.
+     */
+    void recordFrame(unsigned long long pixels, unsigned long long foregroundPixels);
+
+    /**
+     * Export the frames recorded since the last export, if any.
+     */
+    void flush();
+
+    /**
+     * @return The statistics of the frames since the last export as a JSON object.
+     */
+    string toJSON() const;
+
+    /**
+     * @return The statistics of the frames since the last export as CSV, one row per stage.
+     */
+    string toCSV() const;
+};
+
+/**
+ * Records the time from construction to destruction as one stage, does nothing without a profiler.
+ */
+class ScopedStageTimer
+{
+private:
+    StageProfiler *profiler;
+    ProfileStage stage;
+    int64 startTicks;
+
+public:
+    ScopedStageTimer(StageProfiler *profiler, ProfileStage stage)
+        : profiler(profiler), stage(stage), startTicks(profiler != nullptr ? getTickCount() : 0)
+    {
+    }
+
+    ~ScopedStageTimer()
+    {
+        this->stop();
+    }
+
+    /**
+     * Record the stage now instead of at destruction.
+     */
+    void stop()
+    {
+        if (this->profiler != nullptr)
+        {
+            this->profiler->recordStage(this->stage, (getTickCount() - this->startTicks) / getTickFrequency());
+            this->profiler = nullptr;
+        }
+    }
+};
+
+#endif
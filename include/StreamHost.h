@@ -0,0 +1,103 @@
+#ifndef StreamHost_H
+#define StreamHost_H
+
+#include "AGMM.h"
+#include "ThreadPool.h"
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+using namespace cv;
+using namespace std;
+
+/**
+ * Throughput of one stream of a StreamHost.
+ */
+struct StreamStats
+{
+    string name;
+    TaskPriority priority;
+    unsigned long frames;
+    // From the start of the run to the end of the stream
+    double seconds;
+    // Time from reading a frame to its mask, in milliseconds
+    double meanFrameTime;
+    double maximumFrameTime;
+};
+
+/**
+ * Runs many AGMM instances, one per camera stream, in one process on one shared ThreadPool.
+ * Every frame of a stream is a job of the pool and its stages are split into tiles, so a
+ * busy stream borrows the workers of idle ones. The frames of a stream are processed in
+ * order, one at a time; when streams compete, those of higher priority go first.
+ */
+class StreamHost
+{
+private:
+    struct Stream
+    {
+        string name;
+        AGMM *agmm;
+        TaskPriority priority;
+        function<bool()> start;
+        function<bool(const Mat &, const Mat &, const vector<Blob> &)> consume;
+
+        Mat frame;
+        Mat mask;
+        Mat result;
+        vector<Blob> blobs;
+
+        StreamStats stats;
+        double totalFrameTime;
+    };
+
+    ThreadPool pool;
+    vector<unique_ptr<Stream>> streams;
+
+    mutex runningLock;
+    condition_variable finished;
+    size_t runningStreams = 0;
+    int64 startTicks = 0;
+
+    void startStream(Stream &stream);
+
+    void processFrame(Stream &stream);
+
+    void finishStream(Stream &stream);
+
+public:
+    /**
+     * @param numberOfThreads The number of workers of the pool, 0 for one per core.
+     */
+    explicit StreamHost(int numberOfThreads = 0);
+
+    /**
+     * Add a stream before run. The model is moved onto the pool and its stages are split
+     * into one tile per worker.
+     * @param name The name of the stream in its stats.
+     * @param agmm The model, reading its own video, owned by the caller.
+     * @param priority The priority of the frames of the stream.
+     * @param start Called on the pool before the first frame, typically to initialize the model.
+     * The stream is dropped if it returns false.
+     * @param consume Called with every frame, its mask and blobs. The stream ends if it returns false.
+     */
+    void addStream(const string &name, AGMM &agmm, TaskPriority priority, const function<bool()> &start, const function<bool(const Mat &, const Mat &, const vector<Blob> &)> &consume);
+
+    /**
+     * Process every stream until its video ends.
+     */
+    void run();
+
+    /**
+     * @return One entry per stream, in the order they were added.
+     */
+    vector<StreamStats> getStats() const;
+
+    int getNumberOfThreads() const;
+};
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef SyntheticScene_H
+#define SyntheticScene_H
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+using namespace cv;
+using namespace std;
+
+/**
+ * Appearance of a SyntheticScene. Sizes and speeds are relative to the frame so a scene
+ * looks the same at every resolution.
+ */
+struct SyntheticSceneParameters
+{
+    int numberOfBlobs = 6;
+    // Radius of the blobs as a fraction of the frame height
+    double blobRadius = 0.06;
+    // Distance a blob moves per frame as a fraction of the frame width
+    double blobSpeed = 0.004;
+    // Factor applied to the brightness inside a shadow
+    double shadowStrength = 0.7;
+    // Standard deviation of the per-pixel sensor noise
+    double noiseSigma = 3;
+    // Amplitude of the global brightness drift, 0.1 is +-10 %
+    double lightingDrift = 0.1;
+    // Period of the brightness drift in frames
+    double lightingPeriod = 500;
+};
+
+/**
+ * Generator of synthetic test video: a static textured backdrop, coloured blobs moving
+ * across it and casting offset shadows, sensor noise and a slow global change of lighting.
+ * Frames come with the exact foreground mask, shadows excluded. The sequence only depends
+ * on the size, the seed and the parameters.
+ */
+class SyntheticScene
+{
+private:
+    struct Blob
+    {
+        Point2d position;
+        Point2d velocity;
+        Size axes;
+        double angle;
+        Scalar color;
+    };
+
+    int rows;
+    int cols;
+    SyntheticSceneParameters parameters;
+
+    RNG rng;
+    Mat backdrop;
+    vector<Blob> blobs;
+    unsigned long frameIndex = 0;
+
+    // Scratch buffers reused between frames
+    Mat shadowMask;
+    Mat shadedFrame;
+    Mat noise;
+    Mat noisyFrame;
+
+public:
+    /**
+     * @param rows The height of the frames.
+     * @param cols The width of the frames.
+     * @param seed The seed of the scene.
+     * @param parameters The appearance of the scene.
+     */
+    SyntheticScene(int rows, int cols, uint64 seed = 1, const SyntheticSceneParameters &parameters = SyntheticSceneParameters());
+
+    /**
+     * Render the next frame.
+     * @param frame Receives the 8-bit BGR frame.
+     * @param groundTruth If not null, receives the foreground mask, 255 on the blobs.
+     */
+    void nextFrame(Mat &frame, Mat *groundTruth = nullptr);
+
+    int getRows() const;
+
+    int getCols() const;
+
+    unsigned long getFrameIndex() const;
+};
+
+#endif
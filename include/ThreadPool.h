@@ -0,0 +1,136 @@
+#ifndef ThreadPool_H
+#define ThreadPool_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+using namespace cv;
+using namespace std;
+
+/**
+ * Order in which waiting tasks are started, higher first.
+ */
+enum TaskPriority
+{
+    PRIORITY_LOW,
+    PRIORITY_NORMAL,
+    PRIORITY_HIGH
+};
+
+/**
+ * Work-stealing pool shared by many AGMM instances. Every worker has its own queues, it
+ * takes its newest tile and its oldest job first; an idle worker steals the oldest task of
+ * another worker.
+ *
+ * There are two kinds of tasks. Jobs, such as one frame of a stream, may block on tiles.
+ * Tiles are the pieces of a parallelFor and never block. A thread waiting for its tiles
+ * runs tiles, of any caller, but never starts a job, so waits do not nest.
+ */
+class ThreadPool
+{
+public:
+    static const int numberOfPriorities = 3;
+
+    /**
+     * The tiles of one parallelFor, the body is called without being copied.
+     */
+    struct TileGroup
+    {
+        void (*invoke)(const void *body, const Range &tile);
+        const void *body;
+        atomic<int> remaining;
+    };
+
+private:
+    struct Task
+    {
+        // Set for a tile, a job has no group
+        TileGroup *group = nullptr;
+        Range range;
+        function<void()> job;
+    };
+
+    struct Worker
+    {
+        mutex lock;
+        deque<Task> tiles[numberOfPriorities];
+        deque<Task> jobs[numberOfPriorities];
+    };
+
+    vector<unique_ptr<Worker>> workers;
+    vector<thread> threads;
+
+    mutex sleepLock;
+    condition_variable wakeUp;
+    atomic<int> pendingTasks{0};
+    atomic<unsigned int> nextWorker{0};
+    bool stopping = false;
+
+    int getCurrentWorker() const;
+
+    void push(Task &&task, TaskPriority priority);
+
+    bool pop(bool tile, Task &task);
+
+    void runTask(Task &task);
+
+    void runWorker(int index);
+
+    void runTiles(TileGroup &group, const Range &range, int numberOfTiles, TaskPriority priority);
+
+public:
+    /**
+     * Start the workers.
+     * @param numberOfThreads The number of workers, 0 for one per core.
+     */
+    explicit ThreadPool(int numberOfThreads = 0);
+
+    ThreadPool(const ThreadPool &) = delete;
+
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    /**
+     * Wait for the queued tasks and stop the workers.
+     */
+    ~ThreadPool();
+
+    int getNumberOfThreads() const;
+
+    /**
+     * Queue a job. It runs on a worker, after every waiting task of a higher priority.
+     * @param job The job, it may call parallelFor and submit further jobs.
+     * @param priority The priority of the job.
+     */
+    void submit(const function<void()> &job, TaskPriority priority);
+
+    /**
+     * Split a range into tiles and run them on the pool. The calling thread runs the first
+     * tile and helps with waiting tiles until all of its own are done, so this may be called
+     * from any thread, including a job.
+     * @param range The range.
+     * @param numberOfTiles The number of tiles, at most the length of the range.
+     * @param priority The priority of the tiles.
+     * @param body Called once per tile, possibly on several threads at the same time.
+     */
+    template <typename Body>
+    void parallelFor(const Range &range, int numberOfTiles, TaskPriority priority, const Body &body);
+};
+
+template <typename Body>
+void ThreadPool::parallelFor(const Range &range, int numberOfTiles, TaskPriority priority, const Body &body)
+{
+    TileGroup group;
+    group.invoke = [](const void *body, const Range &tile)
+    { (*static_cast<const Body *>(body))(tile); };
+    group.body = &body;
+    this->runTiles(group, range, numberOfTiles, priority);
+}
+
+#endif
@@ -7,178 +7,710 @@
  * @author Tyler Flar
  */
 #include "../include/AGMM.h"
+#include "../include/HSVConversion.h"
+#include "../include/MaskMorphology.h"
+#include "../include/MixtureReservoir.h"
+#include "../include/ModelCheckpoint.h"
+#include <atomic>
+#include <random>
+#include <unistd.h>
 #include <opencv2/opencv.hpp>
 
 using namespace cv;
 using namespace std;
 
-AGMM::AGMM(string videoPath)
+namespace
 {
-    this->cap = VideoCapture(videoPath);
+    /**
+     * Hue and saturation differences between a frame and the background, converted to HSV only
+     * where a shadow window needs them. The differences of the last three rows are kept, so
+     * the windows of neighbouring rows and columns share their conversions. Column sums over
+     * the window rows of a row are computed once and reused by every window that covers them.
+     */
+    class ShadowDifferences
+    {
+    private:
+        const Mat &frame;
+        const Mat &background;
+        const HSVConversion &conversion = HSVConversion::getInstance();
+        ShadowRows &rows;
+
+        size_t getIndex(int row, int col)
+        {
+            size_t index = static_cast<size_t>(row % 3) * this->frame.cols + col;
+            if (this->rows.rowStamps[index] != row + 1)
+            {
+                Vec3b frameHSV = this->conversion.convert(this->frame.at<Vec3b>(row, col));
+                Vec3b backgroundHSV = this->conversion.convert(this->background.at<Vec3b>(row, col));
+
+                int hueDifference = abs(frameHSV[0] - backgroundHSV[0]);
+                if (hueDifference > 90)
+                {
+                    hueDifference = 180 - hueDifference;
+                }
+                this->rows.hueDifferences[index] = static_cast<uchar>(hueDifference);
+                this->rows.saturationDifferences[index] = static_cast<uchar>(abs(frameHSV[1] - backgroundHSV[1]));
+                this->rows.rowStamps[index] = row + 1;
+            }
+            return index;
+        }
+
+    public:
+        /**
+         * @param rows Buffers of the stripe, sized for the frame width by AGMM::allocateWorkspaces.
+         * @param resume True to keep the differences computed on the buffers for the same frame
+         * and background, when the rows continue those of the previous object.
+         */
+        ShadowDifferences(const Mat &frame, const Mat &background, ShadowRows &rows, bool resume)
+            : frame(frame), background(background), rows(rows)
+        {
+            // Stamps left by the previous frame would pass for valid entries
+            if (!resume)
+            {
+                fill(rows.rowStamps.begin(), rows.rowStamps.end(), 0);
+                fill(rows.columnStamps.begin(), rows.columnStamps.end(), 0);
+            }
+        }
+
+        /**
+         * Sum the differences of rows minY to maxY in the columns the windows of the candidates cover.
+         * @param row The row of the candidates, rows must be given in increasing order.
+         * @param minY The first row of the windows.
+         * @param maxY The last row of the windows.
+         * @param candidates The columns of the window centres, in increasing order.
+         */
+        void sumColumns(int row, int minY, int maxY, const vector<int> &candidates)
+        {
+            for (int j : candidates)
+            {
+                for (int l = max(j - 1, 0); l <= min(j + 1, this->frame.cols - 1); l++)
+                {
+                    if (this->rows.columnStamps[l] == row + 1)
+                    {
+                        continue;
+                    }
+
+                    int hueSum = 0;
+                    int saturationSum = 0;
+                    for (int k = minY; k <= maxY; k++)
+                    {
+                        size_t index = this->getIndex(k, l);
+                        hueSum += this->rows.hueDifferences[index];
+                        saturationSum += this->rows.saturationDifferences[index];
+                    }
+                    this->rows.hueSums[l] = hueSum;
+                    this->rows.saturationSums[l] = saturationSum;
+                    this->rows.columnStamps[l] = row + 1;
+                }
+            }
+        }
+
+        int getHueSum(int col) const
+        {
+            return this->rows.hueSums[col];
+        }
 
-    // If video cannot be opened, error and deconstruct AGMM
-    if (!this->cap.isOpened())
+        int getSaturationSum(int col) const
+        {
+            return this->rows.saturationSums[col];
+        }
+    };
+
+    // Size of the L2 cache of a core, 1 MiB where the C library does not report it
+    size_t getLevel2CacheSize()
     {
-        cout << "Error: Video cannot be opened." << endl;
-        this->~AGMM();
+#ifdef _SC_LEVEL2_CACHE_SIZE
+        long size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+        if (size > 0)
+        {
+            return static_cast<size_t>(size);
+        }
+#endif
+        return 1 << 20;
+    }
+}
+
+AGMM::AGMM(const string &videoPath, Size rawFrameSize, double rawFrameRate)
+{
+    // If video cannot be opened, error and stay closed, see isOpened
+    if (!this->source.open(videoPath, rawFrameSize, rawFrameRate))
+    {
+        cout << "Error: " << this->source.getError() << endl;
         return;
     }
 
-    this->rows = cap.get(CAP_PROP_FRAME_HEIGHT);
-    this->cols = cap.get(CAP_PROP_FRAME_WIDTH);
+    this->rows = this->source.getRows();
+    this->cols = this->source.getCols();
+    this->numberOfPixels = this->rows * this->cols;
+}
+
+AGMM::AGMM(unsigned int rows, unsigned int cols)
+{
+    this->rows = rows;
+    this->cols = cols;
     this->numberOfPixels = this->rows * this->cols;
 }
 
 AGMM::~AGMM()
 {
-    this->cap.release();
+    this->source.release();
 }
 
 void AGMM::initializeModel(int numberOfFrames)
 {
-    // Vector with initialization data for GMM.
-    // Each pixel has a vector of Vec3b values.
-    // The size of the individual vectors is equal to the number of frames.
-    vector<vector<Vec3b>> initializationData(this->numberOfPixels);
-    Mat frame;
-    for (int i = 0; i < numberOfFrames; i++)
+    // If no more frames, error and close the video, see isOpened
+    if (!this->initializeModel([this](int, Mat &frame)
+                               {
+        if (!this->readFrame(frame))
+        {
+            cout << "Error: No more frames in video." << endl;
+            return false;
+        }
+        return true; },
+                               numberOfFrames))
     {
-        this->cap >> frame;
-        this->background = frame;
-        GaussianBlur(frame, frame, Size(9, 9), 2, 2);
+        this->source.release();
+    }
+}
 
-        // test
-        //  If no more frames, error and deconstruct AGMM
+bool AGMM::initializeModel(const vector<Mat> &frames)
+{
+    return this->initializeModel([&](int index, Mat &frame)
+                                 {
+        frame = frames[index];
         if (frame.empty())
         {
-            cout << "Error: No more frames in video." << endl;
-            this->~AGMM();
-            return;
+            cout << "Error: Initialization frame " << index << " is empty." << endl;
+            return false;
         }
+        return true; },
+                                 frames.size());
+}
+
+bool AGMM::initializeModel(const function<bool(int, Mat &)> &nextFrame, int numberOfFrames)
+{
+    if (numberOfFrames < 1)
+    {
+        cout << "Error: At least one frame is needed to initialize the model." << endl;
+        this->mixtures = MixtureModel();
+        return false;
+    }
+
+    this->modelRows = (this->rows + this->PM_scale - 1) / this->PM_scale;
+    this->modelCols = (this->cols + this->PM_scale - 1) / this->PM_scale;
+    this->numberOfModelPixels = this->modelRows * this->modelCols;
+    this->allocateWorkspaces();
 
-        for (unsigned int j = 0; j < this->rows; j++)
+    // Frames are streamed into a reservoir of K samples per pixel, so memory does not
+    // grow with the number of initialization frames.
+    uint64 seed = this->BM_seed;
+    if (!this->BM_seeded)
+    {
+        random_device rd;
+        seed = (static_cast<uint64>(rd()) << 32) | rd();
+    }
+    MixtureReservoir reservoir(this->numberOfModelPixels, this->BM_numberOfGaussians, seed);
+
+    Mat frame;
+    for (int i = 0; i < numberOfFrames; i++)
+    {
+        // A model left from an earlier initialization no longer fits the workspaces
+        if (!nextFrame(i, frame))
         {
-            for (unsigned int k = 0; k < this->cols; k++)
+            this->mixtures = MixtureModel();
+            return false;
+        }
+
+        // The background starts out as the last blurred initialization frame
+        this->reduceFrame(frame, this->background);
+
+        this->forEachRange(Range(0, this->modelRows), [&](const Range &range)
+                           {
+            for (unsigned int j = range.start; j < static_cast<unsigned int>(range.end); j++)
             {
+                reservoir.addPixels(j * this->modelCols, this->modelCols, this->background.ptr<Vec3b>(j));
+            } });
+        reservoir.finishFrame();
+    }
 
-                initializationData[j * this->cols + k].push_back(frame.at<Vec3b>(j, k));
-            }
+    this->mixtures = MixtureModel(this->numberOfModelPixels, this->BM_numberOfGaussians, this->BM_alpha, this->BM_upperboundVariance, this->BM_lowerboundVariance, this->modelPrecision);
+    this->mixtures.setKernel(this->kernelType);
+    this->changeGate = ChangeGate(this->modelRows, this->modelCols, this->CG_blockSize, this->CG_sensitivity, this->CG_reference, this->getMaximumSkippedFrames());
+
+    this->forEachRange(Range(0, this->modelRows), [&](const Range &range)
+                       {
+        for (unsigned int j = range.start; j < static_cast<unsigned int>(range.end); j++)
+        {
+            reservoir.initializeModel(this->mixtures, j * this->modelCols, this->modelCols);
+        } });
+
+    return true;
+}
+
+void AGMM::allocateWorkspaces()
+{
+    UpdateWorkspace &update = this->updateWorkspace;
+    update.workingFrame.create(this->modelRows, this->modelCols, CV_8UC3);
+
+    // Area averaging already removes most of the noise, the filter is scaled down with the frame
+    this->prefilter = this->PM_scale > 1 ? Prefilter(this->PF_type, 2.0 / this->PM_scale, 0) : Prefilter(this->PF_type, 2, 9);
+    update.prefilterRows.resize(this->numberOfThreads);
+    for (PrefilterRows &prefilterRows : update.prefilterRows)
+    {
+        this->prefilter.allocate(prefilterRows, this->modelCols);
+    }
+    update.deferredRows.resize(2 * this->numberOfThreads);
+
+    update.coarseMask.create(this->modelRows, this->modelCols, CV_8U);
+    update.foregroundMask.create(this->rows, this->cols, CV_8U);
+    if (this->PM_scale > 1)
+    {
+        update.resizedFrame.create(this->modelRows, this->modelCols, CV_8UC3);
+        update.dilatedMask.create(this->rows, this->cols, CV_8U);
+        update.erodedMask.create(this->rows, this->cols, CV_8U);
+        update.refinementRows.create(this->rows, this->cols, CV_8U);
+        update.background.create(this->rows, this->cols, CV_8UC3);
+    }
+
+    PostProcessWorkspace &post = this->postProcessWorkspace;
+    post.shadowRows.resize(this->numberOfThreads);
+    for (ShadowRows &shadowRows : post.shadowRows)
+    {
+        shadowRows.hueDifferences.resize(3 * this->cols);
+        shadowRows.saturationDifferences.resize(3 * this->cols);
+        shadowRows.rowStamps.resize(3 * this->cols);
+        shadowRows.hueSums.resize(this->cols);
+        shadowRows.saturationSums.resize(this->cols);
+        shadowRows.columnStamps.resize(this->cols);
+        shadowRows.candidates.reserve(this->cols);
+    }
+
+    post.cleaningRows.create(this->rows, this->cols, CV_8U);
+    post.componentFilter.allocate(this->rows, this->cols);
+}
+
+bool AGMM::saveCheckpoint(const string &path) const
+{
+    if (this->mixtures.getNumberOfPixels() == 0)
+    {
+        cout << "Error: Model is not initialized." << endl;
+        return false;
+    }
+
+    ModelCheckpointHeader header = {};
+    header.rows = this->rows;
+    header.cols = this->cols;
+    header.scale = this->PM_scale;
+    header.modelRows = this->modelRows;
+    header.modelCols = this->modelCols;
+    header.numberOfGaussians = this->mixtures.getNumberOfGaussians();
+    header.precision = this->mixtures.getPrecision();
+    header.pixelStride = this->mixtures.getPixelStride();
+    header.alpha = this->mixtures.getAlpha();
+    header.backgroundRatio = this->BM_backgroundRatio;
+    header.upperboundVariance = this->mixtures.getUpperboundVariance();
+    header.lowerboundVariance = this->mixtures.getLowerboundVariance();
+    header.planesSize = this->mixtures.getMemorySize();
+
+    ModelCheckpoint checkpoint;
+    if (!checkpoint.write(path, header, this->mixtures.getPlanes(), this->background))
+    {
+        cout << "Error: " << checkpoint.getError() << endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool AGMM::loadCheckpoint(const string &path)
+{
+    ModelCheckpoint checkpoint;
+    if (!checkpoint.map(path))
+    {
+        cout << "Error: " << checkpoint.getError() << endl;
+        return false;
+    }
+
+    const ModelCheckpointHeader &header = checkpoint.getHeader();
+    string mismatch;
+    if (header.rows != this->rows || header.cols != this->cols)
+    {
+        mismatch = "was saved for " + to_string(header.cols) + "x" + to_string(header.rows) + " frames, not " + to_string(this->cols) + "x" + to_string(this->rows);
+    }
+    else if (header.numberOfGaussians != this->BM_numberOfGaussians)
+    {
+        mismatch = "has " + to_string(header.numberOfGaussians) + " Gaussians per pixel, not " + to_string(this->BM_numberOfGaussians);
+    }
+    else if (header.alpha != this->BM_alpha || header.backgroundRatio != this->BM_backgroundRatio ||
+             header.upperboundVariance != this->BM_upperboundVariance || header.lowerboundVariance != this->BM_lowerboundVariance)
+    {
+        mismatch = "was saved with other background maintenance parameters";
+    }
+    else if (header.scale < 1 || header.modelRows != (header.rows + header.scale - 1) / header.scale ||
+             header.modelCols != (header.cols + header.scale - 1) / header.scale || header.precision > PRECISION_FIXED16)
+    {
+        mismatch = "has an invalid model size or precision";
+    }
+    else
+    {
+        ModelPrecision precision = static_cast<ModelPrecision>(header.precision);
+        size_t planesSize = 6 * static_cast<size_t>(header.numberOfGaussians) * header.pixelStride * getPrecisionSize(precision);
+        if (header.pixelStride != alignSize(header.modelRows * header.modelCols, static_cast<int>(64 / getPrecisionSize(precision))) ||
+            header.planesSize != planesSize)
+        {
+            mismatch = "has planes of an unexpected size";
         }
     }
 
-    for (unsigned int i = 0; i < this->numberOfPixels; i++)
+    if (!mismatch.empty())
     {
-        Mixture mixture(this->BM_numberOfGaussians, this->BM_alpha, this->BM_upperboundVariance, this->BM_lowerboundVariance);
-        mixture.initializeMixture(initializationData[i]);
-        this->mixtures.push_back(mixture);
+        cout << "Error: Checkpoint " << path << " " << mismatch << "." << endl;
+        return false;
     }
+
+    this->PM_scale = header.scale;
+    this->modelPrecision = static_cast<ModelPrecision>(header.precision);
+    this->modelRows = header.modelRows;
+    this->modelCols = header.modelCols;
+    this->numberOfModelPixels = this->modelRows * this->modelCols;
+
+    checkpoint.getBackground().copyTo(this->background);
+    void *planes = checkpoint.getPlanes();
+    this->mixtures = MixtureModel(this->numberOfModelPixels, this->BM_numberOfGaussians, this->BM_alpha, this->BM_upperboundVariance, this->BM_lowerboundVariance, this->modelPrecision, planes, checkpoint.releaseMapping());
+    this->mixtures.setKernel(this->kernelType);
+    this->changeGate = ChangeGate(this->modelRows, this->modelCols, this->CG_blockSize, this->CG_sensitivity, this->CG_reference, this->getMaximumSkippedFrames());
+    this->allocateWorkspaces();
+
+    return true;
 }
 
 tuple<Mat, Mat, Mat> AGMM::processNextFrame()
 {
-    this->cap >> this->frame;
-    this->mask = Mat::zeros(this->rows, this->cols, CV_8U);
-    this->result = Mat::zeros(this->rows, this->cols, CV_8UC3);
+    Mat frame;
 
-    // If no more frames, error and deconstruct AGMM
-    if (this->frame.empty())
+    // If no more frames, error and close the video, see isOpened
+    if (!this->readFrame(frame))
     {
         cout << "Error: No more frames in video." << endl;
-        this->~AGMM();
+        this->source.release();
+        return make_tuple(Mat(), Mat(), frame);
+    }
+
+    return this->processFrame(frame);
+}
+
+bool AGMM::isOpened()
+{
+    return this->source.isOpened();
+}
+
+double AGMM::getFrameRate()
+{
+    double frameRate = this->source.getFrameRate();
+    return frameRate > 0 ? frameRate : 25;
+}
+
+bool AGMM::readFrame(Mat &frame)
+{
+    ScopedStageTimer timer(this->profiler, PROFILE_CAPTURE);
+    if (!this->source.read(frame))
+    {
+        frame.release();
+        return false;
+    }
+    return true;
+}
+
+tuple<Mat, Mat, Mat> AGMM::processFrame(const Mat &frame)
+{
+    Mat mask, result;
+    this->processFrame(frame, mask, result);
+
+    return make_tuple(mask, result, frame);
+}
+
+bool AGMM::processFrame(const Mat &frame, Mat &mask, Mat &result, vector<Blob> *blobs)
+{
+    if (frame.rows != static_cast<int>(this->rows) || frame.cols != static_cast<int>(this->cols) || frame.type() != CV_8UC3)
+    {
+        cout << "Error: Frame is " << frame.cols << "x" << frame.rows << " of type " << frame.type() << ", expected "
+             << this->cols << "x" << this->rows << " BGR." << endl;
+        return false;
     }
 
-    this->backgroundMaintenance();
-    this->shadowDetection();
-    bitwise_and(this->frame, this->frame, this->result, this->mask);
+    UpdateWorkspace &workspace = this->updateWorkspace;
+    if (this->getTileRows() > 0)
+    {
+        this->processTiles(frame, workspace.foregroundMask, mask);
+        this->maskCleaner(mask, blobs);
+        this->composeResult(frame, mask, result);
+        return true;
+    }
+
+    // A reduced background is upsampled for shadow detection, a full one is used in place
+    this->updateModel(frame, workspace.foregroundMask, this->PM_scale > 1 ? &workspace.background : nullptr);
+    this->postProcess(frame, workspace.foregroundMask, this->PM_scale > 1 ? workspace.background : this->background, mask, result, blobs);
+
+    return true;
+}
+
+bool AGMM::processFrame(const uchar *frame, size_t frameStep, uchar *mask, size_t maskStep, uchar *result, size_t resultStep)
+{
+    // Headers on the caller's memory, the frame is only read and the outputs already have their final size
+    Mat frameView(this->rows, this->cols, CV_8UC3, const_cast<uchar *>(frame), frameStep);
+    Mat maskView(this->rows, this->cols, CV_8U, mask, maskStep);
+    Mat resultView(this->rows, this->cols, CV_8UC3, result, resultStep);
+
+    return this->processFrame(frameView, maskView, resultView);
+}
 
-    return make_tuple(this->mask, this->result, this->frame);
+void AGMM::updateModel(const Mat &frame, Mat &foregroundMask, Mat *background)
+{
+    this->backgroundMaintenance(frame, foregroundMask);
+    if (background != nullptr)
+    {
+        this->copyBackground(*background);
+    }
 }
 
-void AGMM::backgroundMaintenance()
+void AGMM::copyBackground(Mat &background) const
 {
-    Mat workingFrame;
-    GaussianBlur(this->frame, workingFrame, Size(9, 9), 2, 2);
-    Mat foregroundMask = Mat::zeros(this->rows, this->cols, CV_8U);
+    if (this->PM_scale > 1)
+    {
+        resize(this->background, background, Size(this->cols, this->rows), 0, 0, INTER_LINEAR);
+    }
+    else
+    {
+        this->background.copyTo(background);
+    }
+}
+
+void AGMM::postProcess(const Mat &frame, const Mat &foregroundMask, const Mat &background, Mat &mask, Mat &result, vector<Blob> *blobs) const
+{
+    this->shadowDetection(frame, background, foregroundMask, mask, blobs);
+    this->composeResult(frame, mask, result);
+}
+
+void AGMM::composeResult(const Mat &frame, const Mat &mask, Mat &result) const
+{
+    result.create(this->rows, this->cols, CV_8UC3);
+    result.setTo(Scalar::all(0));
+    frame.copyTo(result, mask);
+
+    if (this->profiler != nullptr)
+    {
+        this->profiler->recordFrame(this->numberOfPixels, countNonZero(mask));
+    }
+}
+
+void AGMM::reduceFrame(const Mat &frame, Mat &reducedFrame)
+{
+    ScopedStageTimer timer(this->profiler, PROFILE_BLUR);
+    const Mat *source = &frame;
+    if (this->PM_scale > 1)
+    {
+        Mat &resizedFrame = this->updateWorkspace.resizedFrame;
+        resize(frame, resizedFrame, Size(this->modelCols, this->modelRows), 0, 0, INTER_AREA);
+        source = &resizedFrame;
+    }
+
+    if (!this->prefilter.isRowParallel())
+    {
+        this->prefilter.applyFrame(*source, reducedFrame);
+        return;
+    }
+
+    // Stripes only write their own rows, each takes the next row buffers
+    reducedFrame.create(source->rows, source->cols, CV_8UC3);
+    atomic<int> nextStripe(0);
+    this->forEachRange(Range(0, source->rows), [&](const Range &range)
+                       { this->prefilter.apply(*source, reducedFrame, range, this->updateWorkspace.prefilterRows[nextStripe++]); });
+}
+
+void AGMM::backgroundMaintenance(const Mat &frame, Mat &foregroundMask)
+{
+    Mat &workingFrame = this->updateWorkspace.workingFrame;
+    this->reduceFrame(frame, workingFrame);
+
+    ScopedStageTimer timer(this->profiler, PROFILE_MIXTURE_UPDATE);
+    // Every element is written below. With a pyramid the mask of the model is refined into the output.
+    Mat &modelMask = this->PM_scale > 1 ? this->updateWorkspace.coarseMask : foregroundMask;
+    modelMask.create(this->modelRows, this->modelCols, CV_8U);
+
+    const bool gating = this->changeGate.isEnabled();
+    if (gating)
+    {
+        this->forEachRange(Range(0, this->changeGate.getBlockRows()), [&](const Range &range)
+                           { this->changeGate.classify(workingFrame, this->background, range); });
+    }
+
+    // Pixels no component matched are only counted while profiling
+    atomic<unsigned long long> updatedPixels(0);
+    atomic<unsigned long long> unmatchedPixels(0);
+
+    // Every pixel only touches its own mixture and its own output elements, so row ranges can run in any order
+    this->forEachRange(Range(0, this->modelRows), [&](const Range &range)
+                       {
+        unsigned int updated = 0;
+        unsigned int unmatched = 0;
+        this->updateRows(workingFrame, modelMask, range, updated, unmatched);
+        updatedPixels += updated;
+        unmatchedPixels += unmatched; });
+
+    unsigned int skippedBlocks = gating ? this->changeGate.finishFrame(workingFrame, modelMask) : 0;
 
-    // Update each mixture and create foreground mask
-    for (unsigned int i = 0; i < this->rows; i++)
+    if (this->profiler != nullptr)
     {
-        for (unsigned int j = 0; j < this->cols; j++)
+        this->profiler->recordUpdate(updatedPixels, unmatchedPixels);
+        if (gating)
         {
-            Vec3b pixel = workingFrame.at<Vec3b>(i, j);
-            bool isBackround = this->mixtures[i * this->cols + j].updateMixture(pixel, this->BM_backgroundRatio);
-            if (!isBackround)
-            {
-                foregroundMask.at<uchar>(i, j) = 255;
-            }
-            else
-            {
-                this->background.at<Vec3b>(i, j) = pixel;
-            }
+            this->profiler->recordGate(this->changeGate.getBlockRows() * this->changeGate.getBlockCols(), skippedBlocks);
         }
     }
+    timer.stop();
 
-    // foregroundMask = this->maskCleaner(foregroundMask);
+    if (this->PM_scale > 1)
+    {
+        this->refineMask(frame, modelMask, foregroundMask);
+    }
 
-    this->mask = foregroundMask;
+    // foregroundMask = this->maskCleaner(foregroundMask);
 }
 
-void AGMM::shadowDetection()
+void AGMM::updateRows(const Mat &workingFrame, Mat &modelMask, const Range &range, unsigned int &updated, unsigned int &unmatched)
 {
-    Mat hsvFrame, hsvBackground, shadowMask;
-    cvtColor(this->frame, hsvFrame, COLOR_BGR2HSV);
-    cvtColor(this->background, hsvBackground, COLOR_BGR2HSV);
-    shadowMask = Mat::zeros(this->rows, this->cols, CV_8U);
+    // Update each mixture and create foreground mask, blocks the gate classified as static repeat their mask
+    const bool gating = this->changeGate.isEnabled();
+    const int blockSize = gating ? this->changeGate.getBlockSize() : this->modelCols;
+    const int blockCols = gating ? this->changeGate.getBlockCols() : 1;
+    const Mat &reference = this->changeGate.getReference(this->background);
 
-    for (unsigned int i = 0; i < this->rows; i++)
+    for (unsigned int i = range.start; i < static_cast<unsigned int>(range.end); i++)
     {
-        for (unsigned int j = 0; j < this->cols; j++)
+        const Vec3b *pixels = workingFrame.ptr<Vec3b>(i);
+        uchar *foreground = modelMask.ptr<uchar>(i);
+        Vec3b *background = this->background.ptr<Vec3b>(i);
+        int blockRow = i / blockSize;
+
+        // Runs of active blocks go through the row kernel together, without a gate the row is one run
+        int blockCol = 0;
+        while (blockCol < blockCols)
         {
-            double valueRatio = (double)hsvFrame.at<Vec3b>(i, j)[2] / (double)hsvBackground.at<Vec3b>(i, j)[2];
-            if (valueRatio > this->SD_valueLowerbound && valueRatio < this->SD_valueUpperbound)
+            unsigned int first = blockCol * blockSize;
+            if (gating && !this->changeGate.isActive(blockRow, blockCol))
             {
-                int hueDifferenceSum = 0;
-                int saturationDifferenceSum = 0;
-                int windowArea = 0;
-                int minY = max(i - 1, static_cast<unsigned int>(0));
-                int maxY = min(i + 1, this->rows - 1);
-                int minX = max(j - 1, static_cast<unsigned int>(0));
-                int maxX = min(j + 1, this->cols - 1);
+                unsigned int last = min((blockCol + 1) * blockSize, static_cast<int>(this->modelCols));
+                const uchar *previous = this->changeGate.getPreviousForeground().ptr<uchar>(i);
+                copy(previous + first, previous + last, foreground + first);
+                blockCol++;
+                continue;
+            }
 
-                for (int k = minY; k <= maxY; k++)
+            for (; blockCol < blockCols && (!gating || this->changeGate.isActive(blockRow, blockCol)); blockCol++)
+            {
+                unsigned int skippedFrames = gating ? this->changeGate.getSkippedFrames(blockRow, blockCol) : 0;
+                if (skippedFrames > 0)
                 {
-                    for (int l = minX; l <= maxX; l++)
+                    const Vec3b *referencePixels = reference.ptr<Vec3b>(i);
+                    unsigned int last = min((blockCol + 1) * blockSize, static_cast<int>(this->modelCols));
+                    for (unsigned int j = blockCol * blockSize; j < last; j++)
                     {
-                        int hueDifference = abs(hsvFrame.at<Vec3b>(k, l)[0] - hsvBackground.at<Vec3b>(k, l)[0]);
-                        if (hueDifference > 90)
-                        {
-                            hueDifference = 180 - hueDifference;
-                        }
-                        hueDifferenceSum += hueDifference;
-
-                        int saturationDifference = abs(hsvFrame.at<Vec3b>(k, l)[1] - hsvBackground.at<Vec3b>(k, l)[1]);
-                        saturationDifferenceSum += saturationDifference;
-                        windowArea++;
+                        this->mixtures.decayPixel(i * this->modelCols + j, referencePixels[j], skippedFrames);
                     }
                 }
+            }
+            unsigned int last = min(blockCol * blockSize, static_cast<int>(this->modelCols));
+
+            this->mixtures.updateRow(i * this->modelCols + first, last - first, pixels + first, this->BM_backgroundRatio, foreground + first, this->profiler != nullptr ? &unmatched : nullptr);
+            updated += last - first;
 
-                if (hueDifferenceSum / windowArea < this->SD_hueThreshold && saturationDifferenceSum / windowArea < this->SD_saturationThreshold)
+            for (unsigned int j = first; j < last; j++)
+            {
+                if (foreground[j] == 0)
                 {
-                    shadowMask.at<uchar>(i, j) = 255;
+                    background[j] = pixels[j];
                 }
             }
         }
     }
+}
+
+void AGMM::refineMask(const Mat &frame, const Mat &coarseMask, Mat &mask)
+{
+    ScopedStageTimer timer(this->profiler, PROFILE_MASK_REFINEMENT);
+
+    resize(coarseMask, mask, Size(this->cols, this->rows), 0, 0, INTER_NEAREST);
+
+    // The band where dilation and erosion by one model pixel disagree holds every pixel
+    // within one model pixel of a foreground boundary
+    UpdateWorkspace &workspace = this->updateWorkspace;
+    Mat &dilatedMask = workspace.dilatedMask;
+    Mat &erodedMask = workspace.erodedMask;
+    this->filterMask(mask, dilatedMask, workspace.refinementRows, this->PM_scale, true);
+    this->filterMask(mask, erodedMask, workspace.refinementRows, this->PM_scale, false);
+
+    // Band pixels are tested against the model pixel they fall in, with a 3x3 mean
+    // standing in for the blur of the reduced frames
+    this->forEachRowRange([&](const Range &range)
+                          {
+        for (int i = range.start; i < range.end; i++)
+        {
+            const uchar *dilated = dilatedMask.ptr<uchar>(i);
+            const uchar *eroded = erodedMask.ptr<uchar>(i);
+            uchar *refined = mask.ptr<uchar>(i);
+            unsigned int modelRow = min(i / this->PM_scale, static_cast<int>(this->modelRows) - 1);
+            int minY = max(i - 1, 0);
+            int maxY = min(i + 1, static_cast<int>(this->rows) - 1);
+
+            for (int j = 0; j < static_cast<int>(this->cols); j++)
+            {
+                if (dilated[j] == eroded[j])
+                {
+                    continue;
+                }
+
+                int minX = max(j - 1, 0);
+                int maxX = min(j + 1, static_cast<int>(this->cols) - 1);
+                int sum[3] = {0, 0, 0};
+                for (int k = minY; k <= maxY; k++)
+                {
+                    const Vec3b *pixels = frame.ptr<Vec3b>(k);
+                    for (int l = minX; l <= maxX; l++)
+                    {
+                        sum[0] += pixels[l][0];
+                        sum[1] += pixels[l][1];
+                        sum[2] += pixels[l][2];
+                    }
+                }
+                int area = (maxY - minY + 1) * (maxX - minX + 1);
+                Vec3b value((sum[0] + area / 2) / area, (sum[1] + area / 2) / area, (sum[2] + area / 2) / area);
+
+                unsigned int modelCol = min(j / this->PM_scale, static_cast<int>(this->modelCols) - 1);
+                refined[j] = this->mixtures.isBackground(modelRow * this->modelCols + modelCol, value, this->BM_backgroundRatio) ? 0 : 255;
+            }
+        } });
+}
+
+void AGMM::shadowDetection(const Mat &frame, const Mat &background, const Mat &foregroundMask, Mat &mask, vector<Blob> *blobs) const
+{
+    ScopedStageTimer timer(this->profiler, PROFILE_SHADOW_TEST);
+    mask.create(this->rows, this->cols, CV_8U);
+
+    // Rows only read the images and write their own mask elements. There are at most
+    // as many stripes as threads, each takes the next row buffers.
+    atomic<int> nextStripe(0);
+    this->forEachRowRange([&](const Range &range)
+                          { this->testShadows(frame, background, foregroundMask, mask, range, this->postProcessWorkspace.shadowRows[nextStripe++], false); });
 
     // Mat element = getStructuringElement(MORPH_RECT, Size(2 * 2 + 1, 2 * 2 + 1), Point(2, 2));
     // Mat cannyFrame, grayFrame, roiMask;
 
-    // cvtColor(this->frame, grayFrame, COLOR_BGR2GRAY);
+    // cvtColor(frame, grayFrame, COLOR_BGR2GRAY);
 
     // Canny(grayFrame, cannyFrame, 50, 150);
     // threshold(cannyFrame, cannyFrame, 100, 255, THRESH_BINARY);
 
-    // morphologyEx(this->mask, roiMask, MORPH_DILATE, element);
+    // morphologyEx(foregroundMask, roiMask, MORPH_DILATE, element);
     // morphologyEx(roiMask, roiMask, MORPH_DILATE, element);
 
     // bitwise_and(roiMask, cannyFrame, roiMask);
@@ -187,38 +719,365 @@ void AGMM::shadowDetection()
 
     // shadowMask = shadowMask - roiMask;
 
-    this->mask = this->mask - shadowMask;
+    timer.stop();
+
+    this->maskCleaner(mask, blobs);
+}
+
+void AGMM::testShadows(const Mat &frame, const Mat &background, const Mat &foregroundMask, Mat &mask, const Range &range, ShadowRows &rows, bool resume) const
+{
+    // The window of a row reads the background of the rows above and below it, which must be updated
+    ShadowDifferences differences(frame, background, rows, resume);
+    vector<int> &candidates = rows.candidates;
+
+    for (int i = range.start; i < range.end; i++)
+    {
+        const uchar *foreground = foregroundMask.ptr<uchar>(i);
+        const Vec3b *framePixels = frame.ptr<Vec3b>(i);
+        const Vec3b *backgroundPixels = background.ptr<Vec3b>(i);
+
+        // The shadow mask is subtracted from the foreground mask, so only foreground
+        // pixels need the test. The value channel is the largest of B, G and R.
+        candidates.clear();
+        for (int j = 0; j < static_cast<int>(this->cols); j++)
+        {
+            if (foreground[j] != 0)
+            {
+                double valueRatio = (double)max(max(framePixels[j][0], framePixels[j][1]), framePixels[j][2]) /
+                                    (double)max(max(backgroundPixels[j][0], backgroundPixels[j][1]), backgroundPixels[j][2]);
+                if (valueRatio > this->SD_valueLowerbound && valueRatio < this->SD_valueUpperbound)
+                {
+                    candidates.push_back(j);
+                }
+            }
+        }
+
+        // Shadow pixels are cleared from a copy of the foreground row, the subtraction of the shadow mask
+        uchar *output = mask.ptr<uchar>(i);
+        if (output != foreground)
+        {
+            copy(foreground, foreground + this->cols, output);
+        }
 
-    this->mask = this->maskCleaner(this->mask);
+        if (candidates.empty())
+        {
+            continue;
+        }
+
+        int minY = max(i - 1, 0);
+        int maxY = min(i + 1, static_cast<int>(this->rows) - 1);
+        differences.sumColumns(i, minY, maxY, candidates);
+
+        for (int j : candidates)
+        {
+            int minX = max(j - 1, 0);
+            int maxX = min(j + 1, static_cast<int>(this->cols) - 1);
+            int windowArea = (maxY - minY + 1) * (maxX - minX + 1);
+
+            int hueDifferenceSum = 0;
+            int saturationDifferenceSum = 0;
+            for (int l = minX; l <= maxX; l++)
+            {
+                hueDifferenceSum += differences.getHueSum(l);
+                saturationDifferenceSum += differences.getSaturationSum(l);
+            }
+
+            if (hueDifferenceSum / windowArea < this->SD_hueThreshold && saturationDifferenceSum / windowArea < this->SD_saturationThreshold)
+            {
+                output[j] = 0;
+            }
+        }
+    }
 }
 
-Mat AGMM::maskCleaner(Mat mask)
+void AGMM::processTiles(const Mat &frame, Mat &foregroundMask, Mat &mask)
 {
-    Mat element = getStructuringElement(MORPH_RECT, Size(2 * 2 + 1, 2 * 2 + 1), Point(2, 2));
-    morphologyEx(mask, mask, MORPH_CLOSE, element);
-    morphologyEx(mask, mask, MORPH_OPEN, element);
+    ScopedStageTimer timer(this->profiler, PROFILE_FUSED_TILES);
+    UpdateWorkspace &workspace = this->updateWorkspace;
+    Mat &workingFrame = workspace.workingFrame;
+    foregroundMask.create(this->rows, this->cols, CV_8U);
+    mask.create(this->rows, this->cols, CV_8U);
+
+    const int rows = this->rows;
+    const int tileRows = this->getTileRows();
+    const int numberOfTiles = (rows + tileRows - 1) / tileRows;
+    const bool gating = this->changeGate.isEnabled();
+    const int blockSize = gating ? this->changeGate.getBlockSize() : tileRows;
+    fill(workspace.deferredRows.begin(), workspace.deferredRows.end(), -1);
+
+    atomic<unsigned long long> updatedPixels(0);
+    atomic<unsigned long long> unmatchedPixels(0);
+
+    // Each stripe takes consecutive bands and runs every stage on a band before the next one.
+    // The shadow test of a row reads the background of the rows around it, so it runs one row
+    // behind the update. The first and last rows of a stripe wait for the neighbouring stripes.
+    atomic<int> nextStripe(0);
+    this->forEachRange(Range(0, numberOfTiles), [&](const Range &range)
+                       {
+        const int stripe = nextStripe++;
+        PrefilterRows &prefilterRows = workspace.prefilterRows[stripe];
+        ShadowRows &shadowRows = this->postProcessWorkspace.shadowRows[stripe];
+        const int first = range.start * tileRows;
+        const int end = min(range.end * tileRows, rows);
+
+        int nextShadowRow = first > 0 ? first + 1 : first;
+        workspace.deferredRows[2 * stripe] = first > 0 ? first : -1;
+        workspace.deferredRows[2 * stripe + 1] = end < rows && end - 1 >= nextShadowRow ? end - 1 : -1;
+
+        unsigned int updated = 0;
+        unsigned int unmatched = 0;
+        bool resume = false;
+        for (int tile = range.start; tile < range.end; tile++)
+        {
+            Range tileRange(tile * tileRows, min((tile + 1) * tileRows, rows));
+            this->prefilter.apply(frame, workingFrame, tileRange, prefilterRows);
+            if (gating)
+            {
+                this->changeGate.classify(workingFrame, this->background, Range(tileRange.start / blockSize, (tileRange.end + blockSize - 1) / blockSize));
+            }
+            this->updateRows(workingFrame, foregroundMask, tileRange, updated, unmatched);
+
+            int shadowEnd = tileRange.end == rows ? rows : tileRange.end - 1;
+            if (shadowEnd > nextShadowRow)
+            {
+                this->testShadows(frame, this->background, foregroundMask, mask, Range(nextShadowRow, shadowEnd), shadowRows, resume);
+                nextShadowRow = shadowEnd;
+                resume = true;
+            }
+        }
+        updatedPixels += updated;
+        unmatchedPixels += unmatched; });
 
-    Rect boundingBox;
-    vector<vector<Point>> contours;
-    vector<int> contourIndices;
-    vector<Vec4i> hierarchy;
+    for (int row : workspace.deferredRows)
+    {
+        if (row >= 0)
+        {
+            this->testShadows(frame, this->background, foregroundMask, mask, Range(row, row + 1), this->postProcessWorkspace.shadowRows[0], false);
+        }
+    }
 
-    findContours(mask, contours, hierarchy, RETR_TREE, CHAIN_APPROX_SIMPLE);
-    Mat cleanedMask = Mat::zeros(this->rows, this->cols, CV_8U);
+    unsigned int skippedBlocks = gating ? this->changeGate.finishFrame(workingFrame, foregroundMask) : 0;
 
-    for (unsigned int i = 0; i < contours.size(); i++)
+    if (this->profiler != nullptr)
     {
-        boundingBox = boundingRect(contours[i]);
-        if (boundingBox.width > 4 && boundingBox.height > 4)
+        this->profiler->recordUpdate(updatedPixels, unmatchedPixels);
+        if (gating)
         {
-            contourIndices.push_back(i);
+            this->profiler->recordGate(this->changeGate.getBlockRows() * this->changeGate.getBlockCols(), skippedBlocks);
         }
     }
+}
+
+void AGMM::filterMask(const Mat &mask, Mat &filtered, Mat &rowFiltered, int radius, bool dilate) const
+{
+    // Every row pass is done before the column passes read the rows around theirs
+    this->forEachRowRange([&](const Range &range)
+                          { filterMaskRows(mask, rowFiltered, range, radius, dilate); });
+    this->forEachRowRange([&](const Range &range)
+                          { filterMaskColumns(rowFiltered, filtered, range, radius, dilate); });
+}
+
+void AGMM::maskCleaner(Mat &mask, vector<Blob> *blobs) const
+{
+    PostProcessWorkspace &workspace = this->postProcessWorkspace;
+    {
+        // Closing then opening by a 5x5 square; the two erosions in the middle are one by a 9x9 square
+        ScopedStageTimer timer(this->profiler, PROFILE_MORPHOLOGY);
+        this->filterMask(mask, mask, workspace.cleaningRows, 2, true);
+        this->filterMask(mask, mask, workspace.cleaningRows, 4, false);
+        this->filterMask(mask, mask, workspace.cleaningRows, 2, true);
+    }
+
+    ScopedStageTimer timer(this->profiler, PROFILE_CONTOUR_CLEANING);
+    workspace.componentFilter.apply(mask, this->MC_minimumSize, this->MC_minimumArea, blobs);
+}
+
+void AGMM::setNumberOfThreads(int numberOfThreads)
+{
+    this->numberOfThreads = max(numberOfThreads, 1);
+
+    // Every stripe needs its own shadow and prefilter row buffers
+    if (this->numberOfPixels > 0 && this->mixtures.getNumberOfPixels() > 0)
+    {
+        this->allocateWorkspaces();
+    }
+}
+
+int AGMM::getNumberOfThreads()
+{
+    return this->numberOfThreads;
+}
+
+void AGMM::setThreadPool(ThreadPool *threadPool, TaskPriority priority)
+{
+    this->threadPool = threadPool;
+    this->poolPriority = priority;
+}
+
+ThreadPool *AGMM::getThreadPool()
+{
+    return this->threadPool;
+}
+
+void AGMM::setMixtureKernel(MixtureKernelType kernelType)
+{
+    this->kernelType = kernelType;
+    this->mixtures.setKernel(kernelType);
+}
+
+void AGMM::setProfiler(StageProfiler *profiler)
+{
+    this->profiler = profiler;
+}
+
+StageProfiler *AGMM::getProfiler()
+{
+    return this->profiler;
+}
+
+MixtureKernelType AGMM::getMixtureKernel()
+{
+    return this->mixtures.getKernel();
+}
+
+bool AGMM::setModelPrecision(ModelPrecision modelPrecision)
+{
+    if (!fitsPrecision(modelPrecision, this->BM_lowerboundVariance, this->BM_upperboundVariance))
+    {
+        cout << "Error: " << getPrecisionName(modelPrecision) << " models cannot hold the variance bounds " << this->BM_lowerboundVariance
+             << " .. " << this->BM_upperboundVariance << "." << endl;
+        return false;
+    }
+
+    this->modelPrecision = modelPrecision;
+    return true;
+}
+
+ModelPrecision AGMM::getModelPrecision()
+{
+    return this->modelPrecision;
+}
+
+void AGMM::setPyramidScale(int scale)
+{
+    this->PM_scale = max(scale, 1);
+}
+
+int AGMM::getPyramidScale()
+{
+    return this->PM_scale;
+}
+
+void AGMM::setPrefilter(PrefilterType type)
+{
+    this->PF_type = type;
+
+    if (this->numberOfPixels > 0 && this->mixtures.getNumberOfPixels() > 0)
+    {
+        this->allocateWorkspaces();
+    }
+}
+
+PrefilterType AGMM::getPrefilter()
+{
+    return this->PF_type;
+}
 
-    for (unsigned int i = 0; i < contourIndices.size(); i++)
+void AGMM::setTiling(bool enabled, int tileRows)
+{
+    this->FT_enabled = enabled;
+    this->FT_tileRows = max(tileRows, 0);
+}
+
+int AGMM::getTileRows()
+{
+    if (!this->FT_enabled || this->PM_scale > 1 || this->rows == 0)
+    {
+        return 0;
+    }
+
+    int tileRows = this->FT_tileRows;
+    if (tileRows == 0)
     {
-        drawContours(cleanedMask, contours, contourIndices[i], Scalar(255), FILLED, 8, hierarchy, 0);
+        // A row holds the frame, the filtered frame and the background, the foreground mask and
+        // the mask, and the mixtures, which pass through the cache on their way to memory.
+        // Bands shorter than the prefilter would filter its halo more often than their own rows.
+        static const size_t cacheSize = getLevel2CacheSize();
+        size_t rowSize = this->cols * (3 * 3 + 2 + 6 * this->BM_numberOfGaussians * getPrecisionSize(this->modelPrecision));
+        tileRows = max(static_cast<int>(cacheSize / 2 / rowSize), 8);
     }
 
-    return cleanedMask;
+    // Bands of whole blocks, so the gate classifies the blocks of a band once it is filtered
+    if (this->CG_blockSize > 0)
+    {
+        tileRows = (tileRows + this->CG_blockSize - 1) / this->CG_blockSize * this->CG_blockSize;
+    }
+
+    return min(tileRows, static_cast<int>(this->rows));
+}
+
+void AGMM::setChangeGating(int blockSize, double sensitivity, GateReference reference)
+{
+    this->CG_blockSize = max(blockSize, 0);
+    this->CG_sensitivity = sensitivity;
+    this->CG_reference = reference;
+    this->changeGate = ChangeGate(this->modelRows, this->modelCols, this->CG_blockSize, this->CG_sensitivity, this->CG_reference, this->getMaximumSkippedFrames());
+}
+
+unsigned int AGMM::getMaximumSkippedFrames() const
+{
+    // MixtureModel::decayPixel leaves out what the means and variances would have learned, and a
+    // static block repeats its mask, so a block is updated at least once per tenth of 1 / alpha
+    return static_cast<unsigned int>(ceil(0.1 / this->BM_alpha));
+}
+
+double AGMM::getSkippedBlockFraction()
+{
+    return this->changeGate.getSkippedFraction();
+}
+
+void AGMM::setBlobFilter(int minimumSize, int minimumArea)
+{
+    this->MC_minimumSize = max(minimumSize, 0);
+    this->MC_minimumArea = max(minimumArea, 0);
+}
+
+void AGMM::setRandomSeed(uint64 seed)
+{
+    this->BM_seeded = true;
+    this->BM_seed = seed;
+}
+
+bool AGMM::setParameters(const AGMMParameters &parameters)
+{
+    if (!fitsPrecision(this->modelPrecision, parameters.lowerboundVariance, parameters.upperboundVariance))
+    {
+        cout << "Error: " << getPrecisionName(this->modelPrecision) << " models cannot hold the variance bounds " << parameters.lowerboundVariance
+             << " .. " << parameters.upperboundVariance << "." << endl;
+        return false;
+    }
+
+    this->BM_alpha = parameters.alpha;
+    this->BM_backgroundRatio = parameters.backgroundRatio;
+    this->BM_upperboundVariance = parameters.upperboundVariance;
+    this->BM_lowerboundVariance = parameters.lowerboundVariance;
+    this->SD_hueThreshold = parameters.hueThreshold;
+    this->SD_saturationThreshold = parameters.saturationThreshold;
+    this->SD_valueUpperbound = parameters.valueUpperbound;
+    this->SD_valueLowerbound = parameters.valueLowerbound;
+    return true;
+}
+
+AGMMParameters AGMM::getParameters()
+{
+    AGMMParameters parameters;
+    parameters.alpha = this->BM_alpha;
+    parameters.backgroundRatio = this->BM_backgroundRatio;
+    parameters.upperboundVariance = this->BM_upperboundVariance;
+    parameters.lowerboundVariance = this->BM_lowerboundVariance;
+    parameters.hueThreshold = this->SD_hueThreshold;
+    parameters.saturationThreshold = this->SD_saturationThreshold;
+    parameters.valueUpperbound = this->SD_valueUpperbound;
+    parameters.valueLowerbound = this->SD_valueLowerbound;
+    return parameters;
 }
@@ -0,0 +1,499 @@
+#include "../include/BatchProcessor.h"
+#include "../include/FramePipeline.h"
+#include "../include/MaskArchive.h"
+#include "../include/StreamHost.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <dirent.h>
+#include <fstream>
+#include <memory>
+#include <set>
+#include <sys/stat.h>
+#include <thread>
+#include <opencv2/opencv.hpp>
+
+using namespace cv;
+using namespace std;
+
+namespace
+{
+    bool isDirectory(const string &path)
+    {
+        struct stat info;
+        return stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+    }
+
+    off_t getFileSize(const string &path)
+    {
+        struct stat info;
+        return stat(path.c_str(), &info) == 0 ? info.st_size : 0;
+    }
+
+    string getExtension(const string &path)
+    {
+        size_t slash = path.find_last_of('/');
+        size_t dot = path.find_last_of('.');
+        if (dot == string::npos || (slash != string::npos && dot < slash))
+        {
+            return "";
+        }
+
+        string extension = path.substr(dot + 1);
+        transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c)
+                  { return tolower(c); });
+        return extension;
+    }
+
+    string getStem(const string &path)
+    {
+        size_t slash = path.find_last_of('/');
+        string name = slash == string::npos ? path : path.substr(slash + 1);
+        size_t dot = name.find_last_of('.');
+        return dot == string::npos || dot == 0 ? name : name.substr(0, dot);
+    }
+
+    bool isVideoFile(const string &path)
+    {
+        static const set<string> extensions = {"avi", "mp4", "mov", "mkv", "m4v", "mpg", "mpeg", "wmv", "webm", "mts", "y4m"};
+        return extensions.count(getExtension(path)) > 0;
+    }
+
+    /**
+     * Writes the frame and its mask side by side at half size, the same output as the interactive
+     * mode, or only the masks into a mask archive.
+     */
+    class ResultWriter
+    {
+    private:
+        string outputPath;
+        double frameRate;
+        int archiveContents;
+        bool failed = false;
+        VideoWriter videoWriter;
+        MaskArchiveWriter archiveWriter;
+        Mat foregroundMaskBGR, combinedFrame, resizedFrame;
+
+    public:
+        ResultWriter(const string &outputPath, double frameRate, int archiveContents)
+            : outputPath(outputPath), frameRate(frameRate), archiveContents(archiveContents)
+        {
+        }
+
+        bool write(const Mat &frame, const Mat &foregroundMask, const vector<Blob> &blobs)
+        {
+            if (this->archiveContents != 0)
+            {
+                if (!this->archiveWriter.isOpened() &&
+                    !this->archiveWriter.open(this->outputPath, foregroundMask.rows, foregroundMask.cols, this->frameRate, this->archiveContents))
+                {
+                    cout << "Error: " << this->archiveWriter.getError() << endl;
+                    this->failed = true;
+                    return false;
+                }
+
+                if (!this->archiveWriter.write(foregroundMask, blobs))
+                {
+                    cout << "Error: " << this->outputPath << ": " << this->archiveWriter.getError() << endl;
+                    this->failed = true;
+                    return false;
+                }
+                return true;
+            }
+
+            cvtColor(foregroundMask, this->foregroundMaskBGR, COLOR_GRAY2BGR);
+            hconcat(frame, this->foregroundMaskBGR, this->combinedFrame);
+            resize(this->combinedFrame, this->resizedFrame, Size(), 0.5, 0.5, INTER_LINEAR);
+
+            if (!this->videoWriter.isOpened())
+            {
+                this->videoWriter.open(this->outputPath, VideoWriter::fourcc('x', '2', '6', '4'), this->frameRate, this->resizedFrame.size());
+            }
+
+            this->videoWriter.write(this->resizedFrame);
+            return true;
+        }
+
+        /**
+         * @return False if a frame could not be written.
+         */
+        bool release()
+        {
+            this->videoWriter.release();
+            if (this->archiveWriter.isOpened() && !this->archiveWriter.close())
+            {
+                cout << "Error: " << this->outputPath << ": " << this->archiveWriter.getError() << endl;
+                this->failed = true;
+            }
+            return !this->failed;
+        }
+    };
+}
+
+BatchProcessor::BatchProcessor(const vector<string> &videoPaths, const string &outputDirectory, int numberOfJobs)
+{
+    this->videoPaths = videoPaths;
+    this->outputDirectory = outputDirectory.empty() ? "." : outputDirectory;
+
+    int cores = max(1u, thread::hardware_concurrency());
+    this->numberOfJobs = numberOfJobs > 0 ? numberOfJobs : cores;
+    this->threadsPerJob = 0;
+}
+
+vector<string> BatchProcessor::expandVideoPaths(const string &path)
+{
+    vector<string> paths;
+
+    if (isDirectory(path))
+    {
+        DIR *directory = opendir(path.c_str());
+        if (directory == nullptr)
+        {
+            cout << "Error: Directory " << path << " cannot be read." << endl;
+            return paths;
+        }
+
+        for (struct dirent *entry = readdir(directory); entry != nullptr; entry = readdir(directory))
+        {
+            string entryPath = path + "/" + entry->d_name;
+            if (isVideoFile(entryPath) && !isDirectory(entryPath))
+            {
+                paths.push_back(entryPath);
+            }
+        }
+        closedir(directory);
+
+        sort(paths.begin(), paths.end());
+    }
+    else if (getExtension(path) == "txt" || getExtension(path) == "list")
+    {
+        ifstream list(path);
+        if (!list.is_open())
+        {
+            cout << "Error: List " << path << " cannot be read." << endl;
+            return paths;
+        }
+
+        string line;
+        while (getline(list, line))
+        {
+            if (!line.empty() && line.back() == '\r')
+            {
+                line.pop_back();
+            }
+
+            // Skip blank lines and comments
+            if (!line.empty() && line[0] != '#')
+            {
+                paths.push_back(line);
+            }
+        }
+    }
+    else
+    {
+        paths.push_back(path);
+    }
+
+    return paths;
+}
+
+void BatchProcessor::setThreadsPerJob(int threadsPerJob)
+{
+    this->threadsPerJob = max(threadsPerJob, 0);
+}
+
+void BatchProcessor::setModelPrecision(ModelPrecision modelPrecision)
+{
+    this->modelPrecision = modelPrecision;
+}
+
+void BatchProcessor::setPipelined(bool pipelined)
+{
+    this->pipelined = pipelined;
+}
+
+void BatchProcessor::setProfiling(const string &profileFormat, unsigned long profileInterval)
+{
+    this->profileFormat = profileFormat;
+    this->profileInterval = profileInterval;
+}
+
+void BatchProcessor::setPyramidScale(int scale)
+{
+    this->pyramidScale = scale;
+}
+
+void BatchProcessor::setCheckpoint(const string &checkpointPath)
+{
+    this->checkpointPath = checkpointPath;
+}
+
+void BatchProcessor::setChangeGating(int blockSize, double sensitivity, GateReference reference)
+{
+    this->gateBlockSize = blockSize;
+    this->gateSensitivity = sensitivity;
+    this->gateReference = reference;
+}
+
+void BatchProcessor::setHosted(bool hosted)
+{
+    this->hosted = hosted;
+}
+
+void BatchProcessor::setPriority(const string &videoPath, TaskPriority priority)
+{
+    this->priorities[videoPath] = priority;
+}
+
+void BatchProcessor::setArchive(int contents)
+{
+    this->archiveContents = contents;
+}
+
+void BatchProcessor::setRandomSeed(uint64 seed)
+{
+    this->seeded = true;
+    this->seed = seed;
+}
+
+void BatchProcessor::setRawFrameSize(Size frameSize, double frameRate)
+{
+    this->rawFrameSize = frameSize;
+    this->rawFrameRate = frameRate;
+}
+
+void BatchProcessor::setPrefilter(PrefilterType type)
+{
+    this->prefilterType = type;
+}
+
+void BatchProcessor::setTiling(bool enabled, int tileRows)
+{
+    this->tiled = enabled;
+    this->tileRows = tileRows;
+}
+
+void BatchProcessor::configure(AGMM &agmm, int numberOfThreads) const
+{
+    agmm.setNumberOfThreads(numberOfThreads);
+    agmm.setModelPrecision(this->modelPrecision);
+    agmm.setPyramidScale(this->pyramidScale);
+    agmm.setChangeGating(this->gateBlockSize, this->gateSensitivity, this->gateReference);
+    agmm.setPrefilter(this->prefilterType);
+    agmm.setTiling(this->tiled, this->tileRows);
+    if (this->seeded)
+    {
+        agmm.setRandomSeed(this->seed);
+    }
+}
+
+bool BatchProcessor::initialize(AGMM &agmm) const
+{
+    if (!this->checkpointPath.empty())
+    {
+        return agmm.loadCheckpoint(this->checkpointPath);
+    }
+
+    agmm.initializeModel(10);
+    return agmm.isOpened();
+}
+
+void BatchProcessor::startProfiling(AGMM &agmm, StageProfiler &profiler, const string &outputPath) const
+{
+    if (!this->profileFormat.empty())
+    {
+        size_t extension = outputPath.find_last_of('.');
+        profiler.setExport(outputPath.substr(0, extension) + ".profile." + this->profileFormat, this->profileInterval);
+        agmm.setProfiler(&profiler);
+    }
+}
+
+BatchResult BatchProcessor::processVideo(const string &videoPath, const string &outputPath) const
+{
+    BatchResult result = {videoPath, outputPath, false, 0, 0, 0, 0, 0};
+    int64 startTicks = getTickCount();
+
+    AGMM agmm(videoPath, this->rawFrameSize, this->rawFrameRate);
+    if (!agmm.isOpened())
+    {
+        return result;
+    }
+
+    int cores = max(1u, thread::hardware_concurrency());
+    this->configure(agmm, this->threadsPerJob > 0 ? this->threadsPerJob : max(1, cores / this->numberOfJobs));
+    if (!this->initialize(agmm))
+    {
+        return result;
+    }
+
+    StageProfiler profiler;
+    this->startProfiling(agmm, profiler, outputPath);
+
+    ResultWriter writer(outputPath, agmm.getFrameRate(), this->archiveContents);
+    if (this->pipelined)
+    {
+        FramePipeline pipeline(agmm);
+        pipeline.run([&](PipelineFrame &item)
+                     {
+            result.frames++;
+            return writer.write(item.frame, item.mask, item.blobs); });
+    }
+    else
+    {
+        // The outputs are allocated on the first frame and written in place afterwards
+        Mat frame, foregroundMask, foregroundImage;
+        vector<Blob> blobs;
+        double totalFrameTime = 0;
+        int64 frameTicks = getTickCount();
+        while (agmm.readFrame(frame))
+        {
+            agmm.processFrame(frame, foregroundMask, foregroundImage, &blobs);
+            double frameTime = (getTickCount() - frameTicks) * 1000 / getTickFrequency();
+            totalFrameTime += frameTime;
+            result.maximumFrameTime = max(result.maximumFrameTime, frameTime);
+
+            result.frames++;
+            if (!writer.write(frame, foregroundMask, blobs))
+            {
+                break;
+            }
+            frameTicks = getTickCount();
+        }
+        result.meanFrameTime = result.frames > 0 ? totalFrameTime / result.frames : 0;
+    }
+
+    profiler.flush();
+
+    result.succeeded = writer.release();
+    result.seconds = (getTickCount() - startTicks) / getTickFrequency();
+    result.skippedBlockFraction = agmm.getSkippedBlockFraction();
+    return result;
+}
+
+void BatchProcessor::runHosted(const vector<string> &outputPaths, vector<BatchResult> &results) const
+{
+    size_t count = this->videoPaths.size();
+    StreamHost host(this->threadsPerJob);
+
+    vector<unique_ptr<AGMM>> models(count);
+    vector<unique_ptr<StageProfiler>> profilers(count);
+    vector<unique_ptr<ResultWriter>> writers(count);
+    vector<char> started(count, 0);
+    vector<size_t> streamIndices;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        results[i] = {this->videoPaths[i], outputPaths[i], false, 0, 0, 0, 0, 0};
+
+        models[i].reset(new AGMM(this->videoPaths[i], this->rawFrameSize, this->rawFrameRate));
+        if (!models[i]->isOpened())
+        {
+            continue;
+        }
+
+        // The number of tiles is set by the host
+        this->configure(*models[i], 1);
+        profilers[i].reset(new StageProfiler());
+        this->startProfiling(*models[i], *profilers[i], outputPaths[i]);
+        writers[i].reset(new ResultWriter(outputPaths[i], models[i]->getFrameRate(), this->archiveContents));
+
+        auto priority = this->priorities.find(this->videoPaths[i]);
+        host.addStream(
+            this->videoPaths[i], *models[i], priority != this->priorities.end() ? priority->second : PRIORITY_NORMAL,
+            [this, i, &models, &started]()
+            {
+                started[i] = this->initialize(*models[i]);
+                return started[i] != 0;
+            },
+            [i, &writers](const Mat &frame, const Mat &mask, const vector<Blob> &blobs)
+            { return writers[i]->write(frame, mask, blobs); });
+        streamIndices.push_back(i);
+    }
+
+    host.run();
+
+    vector<StreamStats> stats = host.getStats();
+    for (size_t stream = 0; stream < stats.size(); stream++)
+    {
+        size_t i = streamIndices[stream];
+        profilers[i]->flush();
+        bool written = writers[i]->release();
+
+        BatchResult &result = results[i];
+        result.succeeded = started[i] != 0 && written;
+        result.frames = stats[stream].frames;
+        result.seconds = stats[stream].seconds;
+        result.meanFrameTime = stats[stream].meanFrameTime;
+        result.maximumFrameTime = stats[stream].maximumFrameTime;
+        result.skippedBlockFraction = models[i]->getSkippedBlockFraction();
+    }
+}
+
+vector<BatchResult> BatchProcessor::run()
+{
+    size_t count = this->videoPaths.size();
+    vector<BatchResult> results(count);
+
+    if (mkdir(this->outputDirectory.c_str(), 0755) != 0 && !isDirectory(this->outputDirectory))
+    {
+        cout << "Error: Output directory " << this->outputDirectory << " cannot be created." << endl;
+        return results;
+    }
+
+    // Outputs are named after the videos, with a suffix when two videos share a name
+    vector<string> outputPaths(count);
+    set<string> usedNames;
+    for (size_t i = 0; i < count; i++)
+    {
+        string stem = getStem(this->videoPaths[i]);
+        string name = stem;
+        for (int suffix = 1; usedNames.count(name) > 0; suffix++)
+        {
+            name = stem + "_" + to_string(suffix);
+        }
+        usedNames.insert(name);
+        outputPaths[i] = this->outputDirectory + "/" + name + (this->archiveContents != 0 ? ".masks" : ".avi");
+    }
+
+    // All videos at once, on one pool
+    if (this->hosted)
+    {
+        this->runHosted(outputPaths, results);
+        return results;
+    }
+
+    // Longest processing time first, with the file size standing in for the length
+    vector<size_t> order(count);
+    vector<off_t> sizes(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        order[i] = i;
+        sizes[i] = getFileSize(this->videoPaths[i]);
+    }
+    stable_sort(order.begin(), order.end(), [&](size_t a, size_t b)
+                { return sizes[a] > sizes[b]; });
+
+    // Each worker takes the next video as soon as it is done with its current one
+    atomic<size_t> next(0);
+    auto worker = [&]()
+    {
+        for (size_t i = next++; i < count; i = next++)
+        {
+            size_t index = order[i];
+            results[index] = this->processVideo(this->videoPaths[index], outputPaths[index]);
+        }
+    };
+
+    vector<thread> workers;
+    int numberOfWorkers = min(this->numberOfJobs, static_cast<int>(count));
+    for (int i = 0; i < numberOfWorkers; i++)
+    {
+        workers.emplace_back(worker);
+    }
+    for (thread &t : workers)
+    {
+        t.join();
+    }
+
+    return results;
+}
@@ -0,0 +1,150 @@
+#include "../include/ChangeGate.h"
+#include <opencv2/opencv.hpp>
+
+using namespace cv;
+using namespace std;
+
+ChangeGate::ChangeGate()
+{
+}
+
+ChangeGate::ChangeGate(int rows, int cols, int blockSize, double sensitivity, GateReference reference, unsigned int maximumSkippedFrames)
+{
+    this->rows = rows;
+    this->cols = cols;
+    this->blockSize = max(blockSize, 0);
+    this->sensitivity = sensitivity;
+    this->reference = reference;
+    this->maximumSkippedFrames = maximumSkippedFrames;
+
+    if (this->blockSize > 0)
+    {
+        this->blockRows = (rows + this->blockSize - 1) / this->blockSize;
+        this->blockCols = (cols + this->blockSize - 1) / this->blockSize;
+        this->active.assign(this->blockRows * this->blockCols, 1);
+        this->skippedFrames.assign(this->blockRows * this->blockCols, 0);
+    }
+}
+
+bool ChangeGate::isEnabled() const
+{
+    return this->blockSize > 0;
+}
+
+void ChangeGate::classify(const Mat &frame, const Mat &background, const Range &blockRange)
+{
+    // Nothing to repeat before the first mask
+    if (this->previousForeground.empty())
+    {
+        return;
+    }
+
+    const Mat &referenceFrame = this->getReference(background);
+    // Channel differences are integers, so a difference is too large once it passes floor(sensitivity)
+    const int limit = static_cast<int>(floor(this->sensitivity));
+
+    for (int blockRow = blockRange.start; blockRow < blockRange.end; blockRow++)
+    {
+        // A block that was skipped for the longest allowed gap is updated whether it changed or not
+        uchar *active = &this->active[blockRow * this->blockCols];
+        const unsigned int *skippedFrames = &this->skippedFrames[blockRow * this->blockCols];
+        for (int blockCol = 0; blockCol < this->blockCols; blockCol++)
+        {
+            active[blockCol] = this->maximumSkippedFrames > 0 && skippedFrames[blockCol] >= this->maximumSkippedFrames;
+        }
+
+        int lastRow = min((blockRow + 1) * this->blockSize, this->rows);
+        for (int i = blockRow * this->blockSize; i < lastRow; i++)
+        {
+            const Vec3b *pixels = frame.ptr<Vec3b>(i);
+            const Vec3b *referencePixels = referenceFrame.ptr<Vec3b>(i);
+            for (int blockCol = 0; blockCol < this->blockCols; blockCol++)
+            {
+                if (active[blockCol])
+                {
+                    continue;
+                }
+
+                int lastCol = min((blockCol + 1) * this->blockSize, this->cols);
+                for (int j = blockCol * this->blockSize; j < lastCol; j++)
+                {
+                    if (abs(pixels[j][0] - referencePixels[j][0]) > limit ||
+                        abs(pixels[j][1] - referencePixels[j][1]) > limit ||
+                        abs(pixels[j][2] - referencePixels[j][2]) > limit)
+                    {
+                        active[blockCol] = 1;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+}
+
+const Mat &ChangeGate::getReference(const Mat &background) const
+{
+    return this->reference == GATE_PREVIOUS_FRAME ? this->previousFrame : background;
+}
+
+const Mat &ChangeGate::getPreviousForeground() const
+{
+    return this->previousForeground;
+}
+
+bool ChangeGate::isActive(int blockRow, int blockCol) const
+{
+    return this->active[blockRow * this->blockCols + blockCol] != 0;
+}
+
+unsigned int ChangeGate::getSkippedFrames(int blockRow, int blockCol) const
+{
+    return this->skippedFrames[blockRow * this->blockCols + blockCol];
+}
+
+unsigned int ChangeGate::finishFrame(const Mat &frame, const Mat &foregroundMask)
+{
+    unsigned int skipped = 0;
+    for (size_t b = 0; b < this->active.size(); b++)
+    {
+        if (this->active[b])
+        {
+            this->skippedFrames[b] = 0;
+        }
+        else
+        {
+            this->skippedFrames[b]++;
+            skipped++;
+        }
+    }
+
+    this->numberOfBlocks += this->active.size();
+    this->numberOfSkippedBlocks += skipped;
+
+    if (this->reference == GATE_PREVIOUS_FRAME)
+    {
+        frame.copyTo(this->previousFrame);
+    }
+    foregroundMask.copyTo(this->previousForeground);
+
+    return skipped;
+}
+
+int ChangeGate::getBlockSize() const
+{
+    return this->blockSize;
+}
+
+int ChangeGate::getBlockRows() const
+{
+    return this->blockRows;
+}
+
+int ChangeGate::getBlockCols() const
+{
+    return this->blockCols;
+}
+
+double ChangeGate::getSkippedFraction() const
+{
+    return this->numberOfBlocks > 0 ? static_cast<double>(this->numberOfSkippedBlocks) / this->numberOfBlocks : 0;
+}
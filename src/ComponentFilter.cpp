@@ -0,0 +1,204 @@
+#include "../include/ComponentFilter.h"
+#include <opencv2/opencv.hpp>
+
+using namespace cv;
+using namespace std;
+
+namespace
+{
+    // Values of the mask while its components are traced
+    const uchar untraced = 255;
+    const uchar traced = 1;
+    const uchar kept = 2;
+}
+
+void ComponentFilter::allocate(int rows, int cols)
+{
+    size_t numberOfPixels = static_cast<size_t>(rows) * cols;
+    this->componentPixels.resize(numberOfPixels);
+    this->outsidePixels.resize(numberOfPixels);
+    this->outside.assign(numberOfPixels, 0);
+}
+
+/**
+ * Mark a traced component and its holes as kept. Pixels of the bounding box reached from
+ * its border without crossing the component lie outside of it, all others are enclosed.
+ * The outside marks are all clear on entry and on return.
+ * @param mask The mask, the component is marked as traced.
+ * @param box The bounding box of the component.
+ * @param minimumArea The smallest area of a kept component, holes included.
+ * @param blobs If not null, receives the blob if it is kept.
+ */
+void ComponentFilter::fillComponent(Mat &mask, const Rect &box, int minimumArea, vector<Blob> *blobs)
+{
+    const int cols = mask.cols;
+    int *pixels = this->outsidePixels.data();
+    uchar *outside = this->outside.data();
+    size_t count = 0;
+
+    auto visit = [&](int row, int col)
+    {
+        int index = row * cols + col;
+        if (!outside[index] && mask.ptr<uchar>(row)[col] != traced)
+        {
+            outside[index] = 1;
+            pixels[count++] = index;
+        }
+    };
+
+    for (int col = box.x; col < box.x + box.width; col++)
+    {
+        visit(box.y, col);
+        visit(box.y + box.height - 1, col);
+    }
+    for (int row = box.y; row < box.y + box.height; row++)
+    {
+        visit(row, box.x);
+        visit(row, box.x + box.width - 1);
+    }
+
+    // Holes are separated from the outside by the 8-connected component, so the outside spreads 4-connected
+    for (size_t next = 0; next < count; next++)
+    {
+        int row = pixels[next] / cols;
+        int col = pixels[next] % cols;
+        if (row > box.y)
+        {
+            visit(row - 1, col);
+        }
+        if (row < box.y + box.height - 1)
+        {
+            visit(row + 1, col);
+        }
+        if (col > box.x)
+        {
+            visit(row, col - 1);
+        }
+        if (col < box.x + box.width - 1)
+        {
+            visit(row, col + 1);
+        }
+    }
+
+    int area = 0;
+    int64 sumX = 0;
+    int64 sumY = 0;
+    for (int row = box.y; row < box.y + box.height; row++)
+    {
+        uchar *values = mask.ptr<uchar>(row);
+        const uchar *outsideRow = outside + row * cols;
+        for (int col = box.x; col < box.x + box.width; col++)
+        {
+            if (!outsideRow[col])
+            {
+                values[col] = kept;
+                area++;
+                sumX += col;
+                sumY += row;
+            }
+        }
+    }
+
+    if (area < minimumArea)
+    {
+        for (int row = box.y; row < box.y + box.height; row++)
+        {
+            uchar *values = mask.ptr<uchar>(row);
+            const uchar *outsideRow = outside + row * cols;
+            for (int col = box.x; col < box.x + box.width; col++)
+            {
+                if (!outsideRow[col])
+                {
+                    values[col] = 0;
+                }
+            }
+        }
+    }
+    else if (blobs != nullptr)
+    {
+        blobs->push_back({box, area, Point2d(static_cast<double>(sumX) / area, static_cast<double>(sumY) / area)});
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        outside[pixels[i]] = 0;
+    }
+}
+
+void ComponentFilter::apply(Mat &mask, int minimumSize, int minimumArea, vector<Blob> *blobs)
+{
+    const int rows = mask.rows;
+    const int cols = mask.cols;
+    if (this->componentPixels.size() < static_cast<size_t>(rows) * cols)
+    {
+        this->allocate(rows, cols);
+    }
+    int *pixels = this->componentPixels.data();
+
+    if (blobs != nullptr)
+    {
+        // A list passed again keeps its capacity, so it stops growing once it held the most blobs of a frame
+        blobs->clear();
+    }
+
+    // A component enclosing another is always reached first in raster order, so the inner
+    // one is already marked as kept, as part of the hole, when the scan gets to it
+    for (int i = 0; i < rows; i++)
+    {
+        for (int j = 0; j < cols; j++)
+        {
+            if (mask.ptr<uchar>(i)[j] != untraced)
+            {
+                continue;
+            }
+
+            // Breadth first, so the queue ends up holding every pixel of the component
+            size_t count = 0;
+            int minX = j, maxX = j, maxY = i;
+            mask.ptr<uchar>(i)[j] = traced;
+            pixels[count++] = i * cols + j;
+            for (size_t next = 0; next < count; next++)
+            {
+                int row = pixels[next] / cols;
+                int col = pixels[next] % cols;
+                minX = min(minX, col);
+                maxX = max(maxX, col);
+                maxY = max(maxY, row);
+
+                for (int k = max(row - 1, 0); k <= min(row + 1, rows - 1); k++)
+                {
+                    uchar *values = mask.ptr<uchar>(k);
+                    for (int l = max(col - 1, 0); l <= min(col + 1, cols - 1); l++)
+                    {
+                        if (values[l] == untraced)
+                        {
+                            values[l] = traced;
+                            pixels[count++] = k * cols + l;
+                        }
+                    }
+                }
+            }
+
+            if (maxX - minX + 1 > minimumSize && maxY - i + 1 > minimumSize)
+            {
+                this->fillComponent(mask, Rect(minX, i, maxX - minX + 1, maxY - i + 1), minimumArea, blobs);
+            }
+            else
+            {
+                for (size_t p = 0; p < count; p++)
+                {
+                    mask.ptr<uchar>(pixels[p] / cols)[pixels[p] % cols] = 0;
+                }
+            }
+        }
+    }
+
+    for (int i = 0; i < rows; i++)
+    {
+        uchar *values = mask.ptr<uchar>(i);
+        for (int j = 0; j < cols; j++)
+        {
+            values[j] = values[j] == kept ? 255 : 0;
+        }
+    }
+}
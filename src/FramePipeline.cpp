@@ -0,0 +1,148 @@
+#include "../include/FramePipeline.h"
+#include <thread>
+#include <opencv2/opencv.hpp>
+
+using namespace cv;
+using namespace std;
+
+namespace
+{
+    enum PipelineStage
+    {
+        STAGE_DECODE,
+        STAGE_MODEL,
+        STAGE_POST,
+        STAGE_OUTPUT
+    };
+}
+
+FramePipeline::FramePipeline(AGMM &agmm, size_t queueDepth)
+    : agmm(agmm), decoded(queueDepth), updated(queueDepth), processed(queueDepth)
+{
+}
+
+void FramePipeline::decodeStage()
+{
+    for (unsigned long index = 0;; index++)
+    {
+        PipelineFrame item;
+        {
+            lock_guard<mutex> guard(this->spareLock);
+            if (!this->spare.empty())
+            {
+                item = move(this->spare.back());
+                this->spare.pop_back();
+            }
+        }
+        item.index = index;
+
+        int64 startTicks = getTickCount();
+        bool hasFrame = this->agmm.readFrame(item.frame);
+        this->busyTicks[STAGE_DECODE] += getTickCount() - startTicks;
+
+        if (!hasFrame)
+        {
+            break;
+        }
+
+        this->frames[STAGE_DECODE]++;
+        if (!this->decoded.push(move(item)))
+        {
+            break;
+        }
+    }
+
+    this->decoded.close();
+}
+
+void FramePipeline::modelStage()
+{
+    PipelineFrame item;
+    while (this->decoded.pop(item))
+    {
+        int64 startTicks = getTickCount();
+        this->agmm.updateModel(item.frame, item.foregroundMask, &item.background);
+        this->busyTicks[STAGE_MODEL] += getTickCount() - startTicks;
+
+        this->frames[STAGE_MODEL]++;
+        if (!this->updated.push(move(item)))
+        {
+            break;
+        }
+    }
+
+    this->updated.close();
+}
+
+void FramePipeline::postStage()
+{
+    PipelineFrame item;
+    while (this->updated.pop(item))
+    {
+        int64 startTicks = getTickCount();
+        this->agmm.postProcess(item.frame, item.foregroundMask, item.background, item.mask, item.result, &item.blobs);
+        this->busyTicks[STAGE_POST] += getTickCount() - startTicks;
+
+        this->frames[STAGE_POST]++;
+        if (!this->processed.push(move(item)))
+        {
+            break;
+        }
+    }
+
+    this->processed.close();
+}
+
+void FramePipeline::stop()
+{
+    // Closing every queue makes each stage fail its next push or pop and return
+    this->decoded.close();
+    this->updated.close();
+    this->processed.close();
+}
+
+void FramePipeline::run(const function<bool(PipelineFrame &)> &output)
+{
+    thread decodeThread(&FramePipeline::decodeStage, this);
+    thread modelThread(&FramePipeline::modelStage, this);
+    thread postThread(&FramePipeline::postStage, this);
+
+    // A single thread per stage and FIFO queues keep the frames in order
+    PipelineFrame item;
+    while (this->processed.pop(item))
+    {
+        int64 startTicks = getTickCount();
+        bool keepGoing = output(item);
+        this->busyTicks[STAGE_OUTPUT] += getTickCount() - startTicks;
+
+        this->frames[STAGE_OUTPUT]++;
+        if (!keepGoing)
+        {
+            this->stop();
+            break;
+        }
+
+        lock_guard<mutex> guard(this->spareLock);
+        this->spare.push_back(move(item));
+    }
+
+    decodeThread.join();
+    modelThread.join();
+    postThread.join();
+}
+
+vector<PipelineStageStats> FramePipeline::getStats() const
+{
+    BoundedQueueStats decodedStats = this->decoded.getStats();
+    BoundedQueueStats updatedStats = this->updated.getStats();
+    BoundedQueueStats processedStats = this->processed.getStats();
+
+    // Queue fields describe the input queue of each stage, decode has none
+    vector<PipelineStageStats> stats;
+    stats.push_back({"decode", this->frames[STAGE_DECODE], this->busyTicks[STAGE_DECODE] / getTickFrequency(), 0, decodedStats.pushStallTime, 0, 0, 0});
+    stats.push_back({"model", this->frames[STAGE_MODEL], this->busyTicks[STAGE_MODEL] / getTickFrequency(), decodedStats.popStallTime, updatedStats.pushStallTime, decodedStats.capacity, decodedStats.depth, decodedStats.maximumDepth});
+    stats.push_back({"post", this->frames[STAGE_POST], this->busyTicks[STAGE_POST] / getTickFrequency(), updatedStats.popStallTime, processedStats.pushStallTime, updatedStats.capacity, updatedStats.depth, updatedStats.maximumDepth});
+    stats.push_back({"output", this->frames[STAGE_OUTPUT], this->busyTicks[STAGE_OUTPUT] / getTickFrequency(), processedStats.popStallTime, 0, processedStats.capacity, processedStats.depth, processedStats.maximumDepth});
+
+    return stats;
+}
@@ -0,0 +1,415 @@
+#include "../include/FrameSource.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fcntl.h>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <opencv2/opencv.hpp>
+
+using namespace cv;
+using namespace std;
+
+namespace
+{
+    const char y4mMagic[] = "YUV4MPEG2";
+    const size_t y4mMagicLength = sizeof(y4mMagic) - 1;
+
+    // Header lines are short, a longer one is not Y4M
+    const size_t maximumLineLength = 4096;
+
+    bool hasY4MExtension(const string &path)
+    {
+        if (path.size() < 4)
+        {
+            return false;
+        }
+
+        string extension = path.substr(path.size() - 4);
+        transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c)
+                  { return tolower(c); });
+        return extension == ".y4m";
+    }
+
+    // Only regular files are sniffed, reading a device or a pipe would consume its input
+    bool startsWithY4MMagic(const string &path)
+    {
+        struct stat info;
+        if (stat(path.c_str(), &info) != 0 || !S_ISREG(info.st_mode))
+        {
+            return false;
+        }
+
+        char magic[y4mMagicLength];
+        FILE *file = fopen(path.c_str(), "rb");
+        if (file == nullptr)
+        {
+            return false;
+        }
+
+        bool found = fread(magic, 1, y4mMagicLength, file) == y4mMagicLength && memcmp(magic, y4mMagic, y4mMagicLength) == 0;
+        fclose(file);
+        return found;
+    }
+
+    /**
+     * Read a line without its newline.
+     * @return False at the end of the stream or if the line is too long.
+     */
+    bool readLine(FILE *stream, string &line)
+    {
+        line.clear();
+        for (int c = fgetc(stream); c != '\n'; c = fgetc(stream))
+        {
+            if (c == EOF || line.size() >= maximumLineLength)
+            {
+                return false;
+            }
+            line.push_back(static_cast<char>(c));
+        }
+        return true;
+    }
+}
+
+FrameSource::~FrameSource()
+{
+    this->release();
+}
+
+void FrameSource::release()
+{
+    this->cap.release();
+
+    if (this->mapping != nullptr)
+    {
+        munmap(this->mapping, this->mappingSize);
+    }
+    if (this->stream != nullptr && this->ownsStream)
+    {
+        fclose(this->stream);
+    }
+
+    this->mapping = nullptr;
+    this->mappingSize = 0;
+    this->stream = nullptr;
+    this->ownsStream = false;
+    vector<size_t>().swap(this->offsets);
+    this->nextFrame = 0;
+    this->opened = false;
+}
+
+bool FrameSource::open(const string &path, Size rawFrameSize, double rawFrameRate)
+{
+    this->release();
+
+    bool isStandardInput = path == "-";
+    if (!isStandardInput && rawFrameSize.empty() && !hasY4MExtension(path) && !startsWithY4MMagic(path))
+    {
+        this->format = FRAME_FORMAT_VIDEO;
+        if (!this->cap.open(path))
+        {
+            this->error = path + " cannot be opened.";
+            return false;
+        }
+
+        this->rows = static_cast<int>(this->cap.get(CAP_PROP_FRAME_HEIGHT));
+        this->cols = static_cast<int>(this->cap.get(CAP_PROP_FRAME_WIDTH));
+        this->frameRate = this->cap.get(CAP_PROP_FPS);
+        return true;
+    }
+
+    int file = isStandardInput ? -1 : ::open(path.c_str(), O_RDONLY);
+    if (!isStandardInput && file < 0)
+    {
+        this->error = path + " cannot be opened.";
+        return false;
+    }
+
+    // Pipes and other files that cannot be mapped are read as a stream
+    struct stat info;
+    if (file >= 0 && fstat(file, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0)
+    {
+        void *mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+        if (mapping != MAP_FAILED)
+        {
+            this->mapping = mapping;
+            this->mappingSize = info.st_size;
+            madvise(mapping, info.st_size, MADV_SEQUENTIAL);
+        }
+    }
+    if (file >= 0)
+    {
+        ::close(file);
+    }
+
+    if (this->mapping == nullptr)
+    {
+        return this->openStream(path, rawFrameSize, rawFrameRate);
+    }
+
+    if (!rawFrameSize.empty())
+    {
+        this->format = FRAME_FORMAT_RAW;
+        this->rows = rawFrameSize.height;
+        this->cols = rawFrameSize.width;
+        this->frameRate = rawFrameRate;
+        this->frameSize = static_cast<size_t>(this->rows) * this->cols * 3;
+
+        for (size_t offset = 0; offset + this->frameSize <= this->mappingSize; offset += this->frameSize)
+        {
+            this->offsets.push_back(offset);
+        }
+        this->opened = true;
+        return true;
+    }
+
+    const char *data = static_cast<const char *>(this->mapping);
+    const char *end = static_cast<const char *>(memchr(data, '\n', min(this->mappingSize, maximumLineLength)));
+    if (end == nullptr || !this->parseY4MHeader(string(data, end)))
+    {
+        this->release();
+        this->error = path + ": " + this->error;
+        return false;
+    }
+
+    this->indexFrames(end - data + 1);
+    this->opened = true;
+    return true;
+}
+
+bool FrameSource::openStream(const string &path, Size rawFrameSize, double rawFrameRate)
+{
+    if (path == "-")
+    {
+        this->stream = stdin;
+    }
+    else
+    {
+        this->stream = fopen(path.c_str(), "rb");
+        this->ownsStream = true;
+    }
+    if (this->stream == nullptr)
+    {
+        this->error = path + " cannot be opened.";
+        return false;
+    }
+
+    if (!rawFrameSize.empty())
+    {
+        this->format = FRAME_FORMAT_RAW;
+        this->rows = rawFrameSize.height;
+        this->cols = rawFrameSize.width;
+        this->frameRate = rawFrameRate;
+        this->frameSize = static_cast<size_t>(this->rows) * this->cols * 3;
+        this->opened = true;
+        return true;
+    }
+
+    // Without a raw frame size a stream has to be Y4M, its header says how to read it
+    string line;
+    if (!readLine(this->stream, line) || !this->parseY4MHeader(line))
+    {
+        string reason = line.compare(0, y4mMagicLength, y4mMagic) == 0 ? this->error : "Give the frame size of raw input.";
+        this->release();
+        this->error = path + ": " + reason;
+        return false;
+    }
+
+    this->planes.create(this->monochrome ? this->rows : this->rows * 3 / 2, this->cols, CV_8UC1);
+    this->opened = true;
+    return true;
+}
+
+bool FrameSource::parseY4MHeader(const string &line)
+{
+    if (line.compare(0, y4mMagicLength, y4mMagic) != 0)
+    {
+        this->error = "Not a Y4M file.";
+        return false;
+    }
+
+    this->format = FRAME_FORMAT_Y4M;
+    this->rows = 0;
+    this->cols = 0;
+    this->frameRate = 0;
+    string colourSpace = "420";
+
+    istringstream tokens(line.substr(y4mMagicLength));
+    string token;
+    while (tokens >> token)
+    {
+        switch (token[0])
+        {
+        case 'W':
+            this->cols = atoi(token.c_str() + 1);
+            break;
+        case 'H':
+            this->rows = atoi(token.c_str() + 1);
+            break;
+        case 'F':
+        {
+            double numerator = 0, denominator = 0;
+            if (sscanf(token.c_str() + 1, "%lf:%lf", &numerator, &denominator) == 2 && denominator > 0)
+            {
+                this->frameRate = numerator / denominator;
+            }
+            break;
+        }
+        case 'C':
+            colourSpace = token.substr(1);
+            break;
+        default:
+            break;
+        }
+    }
+
+    // Chroma siting does not matter for the model, every 4:2:0 variant is read the same way
+    this->monochrome = colourSpace == "mono";
+    if (!this->monochrome && colourSpace.compare(0, 3, "420") != 0)
+    {
+        this->error = "Y4M colour space " + colourSpace + " is not supported, only 4:2:0 and mono.";
+        return false;
+    }
+    if (this->rows <= 0 || this->cols <= 0 || (!this->monochrome && (this->rows % 2 != 0 || this->cols % 2 != 0)))
+    {
+        this->error = "Y4M frame size " + to_string(this->cols) + "x" + to_string(this->rows) + " is not supported.";
+        return false;
+    }
+
+    this->frameSize = static_cast<size_t>(this->rows) * this->cols;
+    if (!this->monochrome)
+    {
+        this->frameSize += this->frameSize / 2;
+    }
+    return true;
+}
+
+void FrameSource::indexFrames(size_t headerSize)
+{
+    const char *data = static_cast<const char *>(this->mapping);
+    size_t offset = headerSize;
+
+    // Frame headers may carry parameters, so every frame is found by its newline
+    while (offset + 5 <= this->mappingSize && memcmp(data + offset, "FRAME", 5) == 0)
+    {
+        const char *newline = static_cast<const char *>(memchr(data + offset, '\n', min(this->mappingSize - offset, maximumLineLength)));
+        if (newline == nullptr)
+        {
+            break;
+        }
+
+        size_t frameOffset = newline - data + 1;
+        if (frameOffset + this->frameSize > this->mappingSize)
+        {
+            break;
+        }
+        this->offsets.push_back(frameOffset);
+        offset = frameOffset + this->frameSize;
+    }
+}
+
+void FrameSource::convert(const uchar *data, Mat &frame)
+{
+    if (this->monochrome)
+    {
+        cvtColor(Mat(this->rows, this->cols, CV_8UC1, const_cast<uchar *>(data)), frame, COLOR_GRAY2BGR);
+    }
+    else
+    {
+        cvtColor(Mat(this->rows * 3 / 2, this->cols, CV_8UC1, const_cast<uchar *>(data)), frame, COLOR_YUV2BGR_I420);
+    }
+}
+
+bool FrameSource::readStream(Mat &frame)
+{
+    if (this->format == FRAME_FORMAT_RAW)
+    {
+        // Read into the caller's buffer, which is reused when it has the frame size
+        frame.create(this->rows, this->cols, CV_8UC3);
+        for (int i = 0; i < this->rows; i++)
+        {
+            if (fread(frame.ptr<uchar>(i), 1, static_cast<size_t>(this->cols) * 3, this->stream) != static_cast<size_t>(this->cols) * 3)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    string line;
+    if (!readLine(this->stream, line) || line.compare(0, 5, "FRAME") != 0 ||
+        fread(this->planes.data, 1, this->frameSize, this->stream) != this->frameSize)
+    {
+        return false;
+    }
+
+    this->convert(this->planes.data, frame);
+    return true;
+}
+
+bool FrameSource::read(Mat &frame)
+{
+    if (this->format == FRAME_FORMAT_VIDEO)
+    {
+        this->cap >> frame;
+        return !frame.empty();
+    }
+
+    if (!this->opened)
+    {
+        return false;
+    }
+
+    if (this->stream != nullptr)
+    {
+        return this->readStream(frame);
+    }
+
+    if (this->nextFrame >= this->offsets.size())
+    {
+        return false;
+    }
+
+    uchar *data = static_cast<uchar *>(this->mapping) + this->offsets[this->nextFrame++];
+    if (this->format == FRAME_FORMAT_RAW)
+    {
+        frame = Mat(this->rows, this->cols, CV_8UC3, data);
+    }
+    else
+    {
+        this->convert(data, frame);
+    }
+    return true;
+}
+
+FrameFormat FrameSource::getFormat() const
+{
+    return this->format;
+}
+
+int FrameSource::getRows() const
+{
+    return this->rows;
+}
+
+int FrameSource::getCols() const
+{
+    return this->cols;
+}
+
+double FrameSource::getFrameRate() const
+{
+    return this->frameRate;
+}
+
+bool FrameSource::isOpened() const
+{
+    return this->format == FRAME_FORMAT_VIDEO ? this->cap.isOpened() : this->opened;
+}
+
+const string &FrameSource::getError() const
+{
+    return this->error;
+}
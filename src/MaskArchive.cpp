@@ -0,0 +1,527 @@
+#include "../include/MaskArchive.h"
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <opencv2/opencv.hpp>
+
+using namespace cv;
+using namespace std;
+
+// The layout is part of the file format
+static_assert(sizeof(MaskArchiveHeader) == 56, "MaskArchiveHeader must not change size");
+
+namespace
+{
+    const char archiveMagic[8] = {'A', 'G', 'M', 'M', 'M', 'A', 'S', 'K'};
+    const uint32_t archiveVersion = 1;
+    const uint32_t archiveByteOrder = 0x01020304;
+
+    // Seven bits per byte, the high bit is set on all bytes but the last
+    void appendVarint(vector<uchar> &payload, uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            payload.push_back(static_cast<uchar>(value | 0x80));
+            value >>= 7;
+        }
+        payload.push_back(static_cast<uchar>(value));
+    }
+
+    bool readVarint(const uchar *&data, const uchar *end, uint64_t &value)
+    {
+        value = 0;
+        for (int shift = 0; data < end && shift < 64; shift += 7)
+        {
+            uchar byte = *data++;
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void appendFloat(vector<uchar> &payload, float value)
+    {
+        uchar bytes[sizeof(float)];
+        memcpy(bytes, &value, sizeof(float));
+        payload.insert(payload.end(), bytes, bytes + sizeof(float));
+    }
+
+    bool readFloat(const uchar *&data, const uchar *end, float &value)
+    {
+        if (end - data < static_cast<ptrdiff_t>(sizeof(float)))
+        {
+            return false;
+        }
+        memcpy(&value, data, sizeof(float));
+        data += sizeof(float);
+        return true;
+    }
+
+    uint64_t load64(const uchar *data)
+    {
+        uint64_t value;
+        memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    /**
+     * Append the foreground runs of a mask in raster order, a run may continue on the next row.
+     * @param mask The mask, nonzero pixels are foreground.
+     * @param runs Receives the start and length of every run.
+     */
+    void findRuns(const Mat &mask, vector<uint32_t> &runs)
+    {
+        const int cols = mask.cols;
+        bool inside = false;
+        uint32_t start = 0;
+        runs.clear();
+
+        for (int i = 0; i < mask.rows; i++)
+        {
+            const uchar *values = mask.ptr<uchar>(i);
+            uint32_t rowStart = static_cast<uint32_t>(i) * cols;
+            int j = 0;
+            while (j < cols)
+            {
+                if (!inside)
+                {
+                    // Masks are mostly background, which is skipped eight pixels at a time
+                    while (j + 8 <= cols && load64(values + j) == 0)
+                    {
+                        j += 8;
+                    }
+                    while (j < cols && values[j] == 0)
+                    {
+                        j++;
+                    }
+                    if (j < cols)
+                    {
+                        inside = true;
+                        start = rowStart + j;
+                    }
+                }
+                else
+                {
+                    while (j + 8 <= cols && load64(values + j) == ~0ull)
+                    {
+                        j += 8;
+                    }
+                    while (j < cols && values[j] != 0)
+                    {
+                        j++;
+                    }
+                    if (j < cols)
+                    {
+                        inside = false;
+                        runs.push_back(start);
+                        runs.push_back(rowStart + j - start);
+                    }
+                }
+            }
+        }
+
+        if (inside)
+        {
+            runs.push_back(start);
+            runs.push_back(static_cast<uint32_t>(mask.rows) * cols - start);
+        }
+    }
+
+    /**
+     * Skip the runs of a payload.
+     * @return False if the payload ends within them.
+     */
+    bool skipRuns(const uchar *&data, const uchar *end)
+    {
+        uint64_t count, value;
+        if (!readVarint(data, end, count))
+        {
+            return false;
+        }
+        for (uint64_t i = 0; i < 2 * count; i++)
+        {
+            if (!readVarint(data, end, value))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+MaskArchiveWriter::~MaskArchiveWriter()
+{
+    if (this->isOpened())
+    {
+        this->close();
+    }
+}
+
+bool MaskArchiveWriter::open(const string &path, int rows, int cols, double frameRate, int contents)
+{
+    if (this->isOpened())
+    {
+        this->close();
+    }
+
+    this->out.open(path, ios::binary | ios::trunc);
+    if (!this->out.is_open())
+    {
+        this->error = path + " cannot be written.";
+        return false;
+    }
+
+    memset(&this->header, 0, sizeof(this->header));
+    memcpy(this->header.magic, archiveMagic, sizeof(this->header.magic));
+    this->header.version = archiveVersion;
+    this->header.byteOrder = archiveByteOrder;
+    this->header.rows = rows;
+    this->header.cols = cols;
+    this->header.contents = contents;
+    this->header.frameRate = frameRate;
+
+    this->out.write(reinterpret_cast<const char *>(&this->header), sizeof(this->header));
+    this->position = sizeof(this->header);
+    this->offsets.clear();
+    return static_cast<bool>(this->out);
+}
+
+bool MaskArchiveWriter::isOpened() const
+{
+    return this->out.is_open();
+}
+
+bool MaskArchiveWriter::write(const Mat &mask, const vector<Blob> &blobs)
+{
+    if (!this->isOpened() || mask.type() != CV_8UC1 ||
+        mask.rows != static_cast<int>(this->header.rows) || mask.cols != static_cast<int>(this->header.cols))
+    {
+        this->error = "The mask does not fit the archive.";
+        return false;
+    }
+
+    // The buffers keep their capacity, so after the first busy frames nothing is allocated
+    this->payload.clear();
+    if (this->header.contents & ARCHIVE_RUNS)
+    {
+        findRuns(mask, this->runs);
+        appendVarint(this->payload, this->runs.size() / 2);
+
+        uint32_t previousEnd = 0;
+        for (size_t i = 0; i < this->runs.size(); i += 2)
+        {
+            appendVarint(this->payload, this->runs[i] - previousEnd);
+            appendVarint(this->payload, this->runs[i + 1]);
+            previousEnd = this->runs[i] + this->runs[i + 1];
+        }
+    }
+    if (this->header.contents & ARCHIVE_BLOBS)
+    {
+        appendVarint(this->payload, blobs.size());
+        for (const Blob &blob : blobs)
+        {
+            appendVarint(this->payload, blob.boundingBox.x);
+            appendVarint(this->payload, blob.boundingBox.y);
+            appendVarint(this->payload, blob.boundingBox.width);
+            appendVarint(this->payload, blob.boundingBox.height);
+            appendVarint(this->payload, blob.area);
+            appendFloat(this->payload, static_cast<float>(blob.centroid.x));
+            appendFloat(this->payload, static_cast<float>(blob.centroid.y));
+        }
+    }
+
+    uint32_t size = static_cast<uint32_t>(this->payload.size());
+    this->out.write(reinterpret_cast<const char *>(&size), sizeof(size));
+    this->out.write(reinterpret_cast<const char *>(this->payload.data()), size);
+    if (!this->out)
+    {
+        this->error = "The archive cannot be written.";
+        return false;
+    }
+
+    this->offsets.push_back(this->position);
+    this->position += sizeof(size) + size;
+    return true;
+}
+
+bool MaskArchiveWriter::close()
+{
+    if (!this->isOpened())
+    {
+        return false;
+    }
+
+    this->header.numberOfFrames = this->offsets.size();
+    this->header.indexOffset = this->position;
+    this->out.write(reinterpret_cast<const char *>(this->offsets.data()), this->offsets.size() * sizeof(uint64_t));
+    this->out.seekp(0);
+    this->out.write(reinterpret_cast<const char *>(&this->header), sizeof(this->header));
+    this->out.close();
+
+    if (!this->out)
+    {
+        this->error = "The archive cannot be written.";
+        return false;
+    }
+    return true;
+}
+
+const string &MaskArchiveWriter::getError() const
+{
+    return this->error;
+}
+
+MaskArchiveReader::~MaskArchiveReader()
+{
+    this->unmap();
+}
+
+void MaskArchiveReader::unmap()
+{
+    if (this->mapping != nullptr)
+    {
+        munmap(this->mapping, this->mappingSize);
+    }
+
+    this->mapping = nullptr;
+    this->mappingSize = 0;
+    this->offsets.clear();
+}
+
+bool MaskArchiveReader::open(const string &path)
+{
+    this->unmap();
+
+    int file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0)
+    {
+        this->error = path + " cannot be opened.";
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(file, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(MaskArchiveHeader))
+    {
+        ::close(file);
+        this->error = path + " is not a mask archive.";
+        return false;
+    }
+
+    void *mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    ::close(file);
+    if (mapping == MAP_FAILED)
+    {
+        this->error = path + " cannot be mapped.";
+        return false;
+    }
+    this->mapping = mapping;
+    this->mappingSize = info.st_size;
+    memcpy(&this->header, mapping, sizeof(this->header));
+
+    const uchar *data = static_cast<const uchar *>(mapping);
+    if (memcmp(this->header.magic, archiveMagic, sizeof(this->header.magic)) != 0)
+    {
+        this->error = path + " is not a mask archive.";
+    }
+    else if (this->header.byteOrder != archiveByteOrder)
+    {
+        this->error = path + " was written on a machine of another byte order.";
+    }
+    else if (this->header.version != archiveVersion)
+    {
+        this->error = path + " has version " + to_string(this->header.version) + ", expected " + to_string(archiveVersion) + ".";
+    }
+    else if (this->header.indexOffset != 0)
+    {
+        if (this->header.indexOffset > this->mappingSize ||
+            this->header.numberOfFrames > (this->mappingSize - this->header.indexOffset) / sizeof(uint64_t))
+        {
+            this->error = path + " is truncated or damaged.";
+        }
+        else
+        {
+            this->offsets.resize(this->header.numberOfFrames);
+            memcpy(this->offsets.data(), data + this->header.indexOffset, this->offsets.size() * sizeof(uint64_t));
+            return true;
+        }
+    }
+    else
+    {
+        // Not closed, the frames are walked up to the last complete one
+        uint64_t offset = sizeof(MaskArchiveHeader);
+        uint32_t size;
+        while (offset + sizeof(size) <= this->mappingSize)
+        {
+            memcpy(&size, data + offset, sizeof(size));
+            if (offset + sizeof(size) + size > this->mappingSize)
+            {
+                break;
+            }
+            this->offsets.push_back(offset);
+            offset += sizeof(size) + size;
+        }
+        return true;
+    }
+
+    this->unmap();
+    return false;
+}
+
+bool MaskArchiveReader::getPayload(size_t frame, const uchar *&begin, const uchar *&end)
+{
+    if (frame >= this->offsets.size())
+    {
+        this->error = "Frame " + to_string(frame) + " is not in the archive.";
+        return false;
+    }
+
+    const uchar *data = static_cast<const uchar *>(this->mapping);
+    uint64_t offset = this->offsets[frame];
+    uint32_t size;
+    if (offset + sizeof(size) > this->mappingSize)
+    {
+        this->error = "Frame " + to_string(frame) + " is damaged.";
+        return false;
+    }
+    memcpy(&size, data + offset, sizeof(size));
+    if (offset + sizeof(size) + size > this->mappingSize)
+    {
+        this->error = "Frame " + to_string(frame) + " is damaged.";
+        return false;
+    }
+
+    begin = data + offset + sizeof(size);
+    end = begin + size;
+    return true;
+}
+
+size_t MaskArchiveReader::getNumberOfFrames() const
+{
+    return this->offsets.size();
+}
+
+int MaskArchiveReader::getRows() const
+{
+    return this->header.rows;
+}
+
+int MaskArchiveReader::getCols() const
+{
+    return this->header.cols;
+}
+
+double MaskArchiveReader::getFrameRate() const
+{
+    return this->header.frameRate;
+}
+
+int MaskArchiveReader::getContents() const
+{
+    return this->header.contents;
+}
+
+bool MaskArchiveReader::readMask(size_t frame, Mat &mask)
+{
+    if (!(this->header.contents & ARCHIVE_RUNS))
+    {
+        this->error = "The archive has no masks.";
+        return false;
+    }
+
+    const uchar *data, *end;
+    if (!this->getPayload(frame, data, end))
+    {
+        return false;
+    }
+
+    const int cols = this->header.cols;
+    const uint64_t numberOfPixels = static_cast<uint64_t>(this->header.rows) * cols;
+    mask.create(this->header.rows, cols, CV_8UC1);
+    mask.setTo(Scalar(0));
+
+    uint64_t count;
+    if (!readVarint(data, end, count))
+    {
+        this->error = "Frame " + to_string(frame) + " is damaged.";
+        return false;
+    }
+
+    uint64_t previousEnd = 0;
+    for (uint64_t i = 0; i < count; i++)
+    {
+        uint64_t gap, length;
+        if (!readVarint(data, end, gap) || !readVarint(data, end, length) || previousEnd + gap + length > numberOfPixels)
+        {
+            this->error = "Frame " + to_string(frame) + " is damaged.";
+            return false;
+        }
+
+        // A run continues on the next row when it reaches the end of one
+        uint64_t start = previousEnd + gap;
+        previousEnd = start + length;
+        while (start < previousEnd)
+        {
+            int row = static_cast<int>(start / cols);
+            int col = static_cast<int>(start % cols);
+            uint64_t pixels = min<uint64_t>(previousEnd - start, cols - col);
+            memset(mask.ptr<uchar>(row) + col, 255, pixels);
+            start += pixels;
+        }
+    }
+
+    return true;
+}
+
+bool MaskArchiveReader::readBlobs(size_t frame, vector<Blob> &blobs)
+{
+    if (!(this->header.contents & ARCHIVE_BLOBS))
+    {
+        this->error = "The archive has no blobs.";
+        return false;
+    }
+
+    const uchar *data, *end;
+    if (!this->getPayload(frame, data, end))
+    {
+        return false;
+    }
+
+    blobs.clear();
+    uint64_t count;
+    if (((this->header.contents & ARCHIVE_RUNS) && !skipRuns(data, end)) || !readVarint(data, end, count))
+    {
+        this->error = "Frame " + to_string(frame) + " is damaged.";
+        return false;
+    }
+
+    for (uint64_t i = 0; i < count; i++)
+    {
+        uint64_t x, y, width, height, area;
+        float centroidX, centroidY;
+        if (!readVarint(data, end, x) || !readVarint(data, end, y) || !readVarint(data, end, width) ||
+            !readVarint(data, end, height) || !readVarint(data, end, area) ||
+            !readFloat(data, end, centroidX) || !readFloat(data, end, centroidY))
+        {
+            this->error = "Frame " + to_string(frame) + " is damaged.";
+            return false;
+        }
+
+        Blob blob;
+        blob.boundingBox = Rect(static_cast<int>(x), static_cast<int>(y), static_cast<int>(width), static_cast<int>(height));
+        blob.area = static_cast<int>(area);
+        blob.centroid = Point2d(centroidX, centroidY);
+        blobs.push_back(blob);
+    }
+
+    return true;
+}
+
+const string &MaskArchiveReader::getError() const
+{
+    return this->error;
+}
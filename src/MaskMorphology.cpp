@@ -0,0 +1,81 @@
+#include "../include/MaskMorphology.h"
+#include <algorithm>
+
+using namespace cv;
+using namespace std;
+
+namespace
+{
+    template <bool dilate>
+    inline uchar combine(uchar a, uchar b)
+    {
+        return dilate ? max(a, b) : min(a, b);
+    }
+
+    template <bool dilate>
+    void filterRows(const Mat &mask, Mat &rowFiltered, const Range &range, int radius)
+    {
+        const int cols = mask.cols;
+        for (int i = range.start; i < range.end; i++)
+        {
+            const uchar *values = mask.ptr<uchar>(i);
+            uchar *filtered = rowFiltered.ptr<uchar>(i);
+            for (int j = 0; j < cols; j++)
+            {
+                int last = min(j + radius, cols - 1);
+                uchar value = values[max(j - radius, 0)];
+                for (int k = max(j - radius, 0) + 1; k <= last; k++)
+                {
+                    value = combine<dilate>(value, values[k]);
+                }
+                filtered[j] = value;
+            }
+        }
+    }
+
+    template <bool dilate>
+    void filterColumns(const Mat &rowFiltered, Mat &filtered, const Range &range, int radius)
+    {
+        const int rows = rowFiltered.rows;
+        const int cols = rowFiltered.cols;
+        for (int i = range.start; i < range.end; i++)
+        {
+            uchar *values = filtered.ptr<uchar>(i);
+            int first = max(i - radius, 0);
+            int last = min(i + radius, rows - 1);
+            copy(rowFiltered.ptr<uchar>(first), rowFiltered.ptr<uchar>(first) + cols, values);
+            for (int k = first + 1; k <= last; k++)
+            {
+                const uchar *window = rowFiltered.ptr<uchar>(k);
+                for (int j = 0; j < cols; j++)
+                {
+                    values[j] = combine<dilate>(values[j], window[j]);
+                }
+            }
+        }
+    }
+}
+
+void filterMaskRows(const Mat &mask, Mat &rowFiltered, const Range &range, int radius, bool dilate)
+{
+    if (dilate)
+    {
+        filterRows<true>(mask, rowFiltered, range, radius);
+    }
+    else
+    {
+        filterRows<false>(mask, rowFiltered, range, radius);
+    }
+}
+
+void filterMaskColumns(const Mat &rowFiltered, Mat &filtered, const Range &range, int radius, bool dilate)
+{
+    if (dilate)
+    {
+        filterColumns<true>(rowFiltered, filtered, range, radius);
+    }
+    else
+    {
+        filterColumns<false>(rowFiltered, filtered, range, radius);
+    }
+}
@@ -19,44 +19,43 @@ Mixture::~Mixture()
     this->gaussians.clear();
 }
 
-vector<Vec3b> Mixture::randomSamplePixel(vector<Vec3b> pixels, int N)
+vector<Vec3b> Mixture::randomSamplePixel(vector<Vec3b> pixels, int N, RNG &rng)
 {
-    random_device rd;
-    mt19937 eng(rd());
-    uniform_int_distribution<> generator(0, pixels.size() - 1);
-
-    vector<Vec3b> randomPixel;
-    vector<int> usedIndices;
-
-    // Generated N random indices
-    for (int i = 0; i < N; i++)
+    // Partial Fisher-Yates shuffle: the first N pixels end up a sample without replacement,
+    // with fewer than N pixels all of them are kept in random order
+    int count = static_cast<int>(pixels.size());
+    int sampled = min(N, count);
+    for (int i = 0; i < sampled; i++)
     {
-        int index = generator(eng);
-
-        // Check if the index is already used
-        if (find(usedIndices.begin(), usedIndices.end(), index) != usedIndices.end())
-        {
-            i--;
-        }
-        else
-        {
-            usedIndices.push_back(index);
-            randomPixel.push_back(pixels[index]);
-        }
+        swap(pixels[i], pixels[rng.uniform(i, count)]);
     }
+    pixels.resize(sampled);
 
-    return randomPixel;
+    return pixels;
 }
 
 void Mixture::initializeMixture(vector<Vec3b> pixels)
 {
+    // Seeded once per thread, the device may be a system call
+    thread_local RNG rng((static_cast<uint64>(random_device()()) << 32) | random_device()());
+    this->initializeMixture(pixels, rng);
+}
+
+void Mixture::initializeMixture(vector<Vec3b> pixels, RNG &rng)
+{
+    if (pixels.empty())
+    {
+        cout << "Error: No pixels to initialize the mixture with." << endl;
+        return;
+    }
+
     // Randomly sample N pixels from the image
-    vector<Vec3b> randomPixels = randomSamplePixel(pixels, this->numberOfGaussians);
+    vector<Vec3b> randomPixels = randomSamplePixel(pixels, this->numberOfGaussians, rng);
 
-    // Initialize the Gaussian components
+    // Initialize the Gaussian components, with fewer samples than components they are reused cyclically
     for (int i = 0; i < this->numberOfGaussians; i++)
     {
-        Vec3b pixel = randomPixels[i];
+        Vec3b pixel = randomPixels[i % randomPixels.size()];
 
         double meanB = static_cast<double>(pixel[0]);
         double meanG = static_cast<double>(pixel[1]);
@@ -157,3 +156,53 @@ bool Mixture::updateMixture(Vec3b pixel, double threshold)
 
     return isBackgrond;
 }
+
+int Mixture::getNumberOfGaussians()
+{
+    return this->numberOfGaussians;
+}
+
+double Mixture::getAlpha()
+{
+    return this->alpha;
+}
+
+double Mixture::getUpperboundVariance()
+{
+    return this->upperboundVariance;
+}
+
+double Mixture::getLowerboundVariance()
+{
+    return this->lowerboundVariance;
+}
+
+vector<Gaussian> Mixture::getGaussians()
+{
+    return this->gaussians;
+}
+
+void Mixture::setNumberOfGaussians(int numberOfGaussians)
+{
+    this->numberOfGaussians = numberOfGaussians;
+}
+
+void Mixture::setAlpha(double alpha)
+{
+    this->alpha = alpha;
+}
+
+void Mixture::setUpperboundVariance(double upperboundVariance)
+{
+    this->upperboundVariance = upperboundVariance;
+}
+
+void Mixture::setLowerboundVariance(double lowerboundVariance)
+{
+    this->lowerboundVariance = lowerboundVariance;
+}
+
+void Mixture::setGaussians(vector<Gaussian> gaussians)
+{
+    this->gaussians = gaussians;
+}
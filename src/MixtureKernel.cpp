@@ -0,0 +1,53 @@
+/**
+ * @file MixtureKernel.cpp
+ * @brief Runtime selection of the vectorized mixture update.
+ */
+#include "../include/MixtureKernel.h"
+
+MixtureRowKernel getMixtureRowKernel(MixtureKernelType &type)
+{
+#ifdef AGMM_X86_KERNELS
+    __builtin_cpu_init();
+    bool hasAVX512 = __builtin_cpu_supports("avx512f");
+    bool hasAVX2 = __builtin_cpu_supports("avx2");
+    bool hasSSE41 = __builtin_cpu_supports("sse4.1");
+
+    if ((type == KERNEL_AUTO || type == KERNEL_AVX512) && hasAVX512)
+    {
+        type = KERNEL_AVX512;
+        return updateMixtureRowAVX512;
+    }
+    if ((type == KERNEL_AUTO || type == KERNEL_AVX512 || type == KERNEL_AVX2) && hasAVX2)
+    {
+        type = KERNEL_AVX2;
+        return updateMixtureRowAVX2;
+    }
+    if (type != KERNEL_SCALAR && hasSSE41)
+    {
+        type = KERNEL_SSE41;
+        return updateMixtureRowSSE41;
+    }
+#endif
+
+    type = KERNEL_SCALAR;
+    return nullptr;
+}
+
+const char *getMixtureKernelName(MixtureKernelType type)
+{
+    switch (type)
+    {
+    case KERNEL_AUTO:
+        return "auto";
+    case KERNEL_SCALAR:
+        return "scalar";
+    case KERNEL_SSE41:
+        return "sse4.1";
+    case KERNEL_AVX2:
+        return "avx2";
+    case KERNEL_AVX512:
+        return "avx512";
+    }
+
+    return "unknown";
+}
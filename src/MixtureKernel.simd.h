@@ -0,0 +1,338 @@
+/**
+ * @file MixtureKernel.simd.h
+ * @brief Vectorized mixture update, compiled once per instruction set.
+ * The including file defines MIXTURE_KERNEL_LANES, the number of doubles per vector,
+ * and is built with the matching -m flags. Each lane handles one pixel and follows
+ * MixtureModel::updatePixel operation by operation, except for the exponential,
+ * including the rounding of every stored value to the precision of the planes.
+ * Everything but the entry point is in an anonymous namespace, and only MixturePlanes.h
+ * is included, so no code built with these flags can be shared with other files.
+ */
+#include "../include/MixturePlanes.h"
+
+namespace
+{
+    typedef double vdouble __attribute__((vector_size(MIXTURE_KERNEL_LANES * sizeof(double))));
+    typedef long long vmask __attribute__((vector_size(MIXTURE_KERNEL_LANES * sizeof(long long))));
+
+    const int lanes = MIXTURE_KERNEL_LANES;
+    const double pi = 3.14159265358979323846;
+
+    inline vdouble broadcast(double value)
+    {
+        vdouble v = {};
+        return v + value;
+    }
+
+    typedef float vfloat __attribute__((vector_size(MIXTURE_KERNEL_LANES * sizeof(float))));
+    typedef uint16_t vfixed __attribute__((vector_size(MIXTURE_KERNEL_LANES * sizeof(uint16_t))));
+
+    // Plane loads decode to double and stores round like encodeValue in MixtureStorage.h
+    inline vdouble load(const double *p, double)
+    {
+        vdouble v;
+        __builtin_memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    inline vdouble load(const float *p, double)
+    {
+        vfloat v;
+        __builtin_memcpy(&v, p, sizeof(v));
+        return __builtin_convertvector(v, vdouble);
+    }
+
+    inline vdouble load(const uint16_t *p, double scale)
+    {
+        vfixed v;
+        __builtin_memcpy(&v, p, sizeof(v));
+        return __builtin_convertvector(v, vdouble) * (1 / scale);
+    }
+
+    inline void store(double *p, vdouble v, double)
+    {
+        __builtin_memcpy(p, &v, sizeof(v));
+    }
+
+    inline void store(float *p, vdouble v, double)
+    {
+        vfloat f = __builtin_convertvector(v, vfloat);
+        __builtin_memcpy(p, &f, sizeof(f));
+    }
+
+    inline void store(uint16_t *p, vdouble v, double scale)
+    {
+        v = v * scale + 0.5;
+        v = v < 0.0 ? broadcast(0) : v;
+        v = v > 65535.0 ? broadcast(65535) : v;
+        vfixed f = __builtin_convertvector(v, vfixed);
+        __builtin_memcpy(p, &f, sizeof(f));
+    }
+
+    // Value that reading back a stored value gives
+    template <typename T>
+    inline vdouble stored(vdouble v, double scale)
+    {
+        T values[MIXTURE_KERNEL_LANES];
+        store(values, v, scale);
+        return load(values, scale);
+    }
+
+    template <>
+    inline vdouble stored<double>(vdouble v, double)
+    {
+        return v;
+    }
+
+    inline bool any(vmask m)
+    {
+        for (int l = 0; l < lanes; l++)
+        {
+            if (m[l])
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    inline vdouble sqrtv(vdouble x)
+    {
+        // Becomes one vector square root with -fno-math-errno, correctly rounded like sqrt
+        vdouble r;
+        for (int l = 0; l < lanes; l++)
+        {
+            r[l] = __builtin_sqrt(x[l]);
+        }
+        return r;
+    }
+
+    /**
+     * exp(x) for x in [-1.5, 0], the range of -distance / (2 * variance) for a matching component.
+     * The argument is divided by 4, a degree 12 Taylor polynomial is evaluated and squared twice.
+     */
+    inline vdouble expMatch(vdouble x)
+    {
+        x = x < -1.5 ? broadcast(-1.5) : x;
+        vdouble r = x * 0.25;
+
+        static const double coefficients[13] = {
+            1.0, 1.0, 1.0 / 2, 1.0 / 6, 1.0 / 24, 1.0 / 120, 1.0 / 720, 1.0 / 5040, 1.0 / 40320,
+            1.0 / 362880, 1.0 / 3628800, 1.0 / 39916800, 1.0 / 479001600};
+
+        vdouble p = broadcast(coefficients[12]);
+        for (int k = 11; k >= 0; k--)
+        {
+            p = p * r + coefficients[k];
+        }
+
+        p = p * p;
+        return p * p;
+    }
+
+    template <typename T>
+    inline void swapIf(vmask m, T *a, T *b)
+    {
+        // Swapping decoded values is exact since decoding is invertible
+        vdouble x = load(a, 1);
+        vdouble y = load(b, 1);
+        store(a, m ? y : x, 1);
+        store(b, m ? x : y, 1);
+    }
+
+    // Swap components a and b, given as plane offsets, in the lanes of m
+    template <typename T>
+    inline void swapComponents(vmask m, T *meanB, T *meanG, T *meanR, T *variance, T *weight, T *weightDistrRatio, unsigned int a, unsigned int b)
+    {
+        swapIf(m, meanB + a, meanB + b);
+        swapIf(m, meanG + a, meanG + b);
+        swapIf(m, meanR + a, meanR + b);
+        swapIf(m, variance + a, variance + b);
+        swapIf(m, weight + a, weight + b);
+        swapIf(m, weightDistrRatio + a, weightDistrRatio + b);
+    }
+
+    template <int K, typename T>
+    unsigned int updateRowK(const MixturePlanes &planes, unsigned int firstPixel, unsigned int count, const uint8_t *pixels, double threshold, uint8_t *foreground, unsigned int *unmatched)
+    {
+        // K is 0 for mixtures without a specialization
+        const int n = K > 0 ? K : planes.numberOfGaussians;
+        const unsigned int stride = planes.stride;
+        const double alpha = planes.alpha;
+
+        unsigned int processed = count - count % lanes;
+
+        for (unsigned int j = 0; j < processed; j += lanes)
+        {
+            unsigned int pixel = firstPixel + j;
+
+            T *meanB = static_cast<T *>(planes.meanB) + pixel;
+            T *meanG = static_cast<T *>(planes.meanG) + pixel;
+            T *meanR = static_cast<T *>(planes.meanR) + pixel;
+            T *variance = static_cast<T *>(planes.variance) + pixel;
+            T *weight = static_cast<T *>(planes.weight) + pixel;
+            T *weightDistrRatio = static_cast<T *>(planes.weightDistrRatio) + pixel;
+
+            vdouble valueB, valueG, valueR;
+            for (int l = 0; l < lanes; l++)
+            {
+                valueB[l] = pixels[3 * (j + l)];
+                valueG[l] = pixels[3 * (j + l) + 1];
+                valueR[l] = pixels[3 * (j + l) + 2];
+            }
+
+            // Component i is inside the background index while the ratios before it sum below the threshold
+            vdouble ratioSum = {};
+            vmask isBackground = {};
+            vmask anyMatch = {};
+            vdouble weightSum = {};
+
+            for (int i = 0; i < n; i++)
+            {
+                unsigned int k = i * stride;
+                vdouble w = load(weight + k, FixedPointScale::weight);
+                vdouble mB = load(meanB + k, FixedPointScale::mean);
+                vdouble mG = load(meanG + k, FixedPointScale::mean);
+                vdouble mR = load(meanR + k, FixedPointScale::mean);
+                vdouble var = load(variance + k, FixedPointScale::variance);
+
+                vdouble dB = mB - valueB;
+                vdouble dG = mG - valueG;
+                vdouble dR = mR - valueR;
+                vdouble distance = dB * dB + dG * dG + dR * dR;
+
+                isBackground |= (distance < 7.5 * var) & (ratioSum < threshold);
+                ratioSum += load(weightDistrRatio + k, FixedPointScale::ratio);
+
+                vmask match = distance < 3 * var;
+                anyMatch |= match;
+                if (i == n - 1)
+                {
+                    // The last component is replaced below, so only its weight is kept
+                    w = match ? stored<T>((1 - alpha) * w + alpha, FixedPointScale::weight) : w;
+                    store(weight + k, w, FixedPointScale::weight);
+                }
+                else if (any(match))
+                {
+                    vdouble probability = (1 / sqrtv(2 * pi * var)) * expMatch(-distance / (2 * var));
+
+                    vdouble newVariance = (1 - alpha) * var + probability * (distance - var);
+                    newVariance = newVariance < planes.lowerboundVariance ? broadcast(planes.lowerboundVariance) : newVariance;
+                    newVariance = newVariance > 5 * planes.upperboundVariance ? broadcast(5 * planes.upperboundVariance) : newVariance;
+
+                    // Non-matching lanes store back the value they loaded, which is exact
+                    w = match ? stored<T>((1 - alpha) * w + alpha, FixedPointScale::weight) : w;
+                    store(weight + k, w, FixedPointScale::weight);
+                    store(meanB + k, match ? (1 - alpha) * mB + probability * valueB : mB, FixedPointScale::mean);
+                    store(meanG + k, match ? (1 - alpha) * mG + probability * valueG : mG, FixedPointScale::mean);
+                    store(meanR + k, match ? (1 - alpha) * mR + probability * valueR : mR, FixedPointScale::mean);
+                    store(variance + k, match ? newVariance : var, FixedPointScale::variance);
+                }
+
+                weightSum += w;
+            }
+
+            // Replace the last component with one centred on the pixel, keeping its weight
+            unsigned int last = (n - 1) * stride;
+            store(meanB + last, valueB, FixedPointScale::mean);
+            store(meanG + last, valueG, FixedPointScale::mean);
+            store(meanR + last, valueR, FixedPointScale::mean);
+            store(variance + last, broadcast(planes.upperboundVariance), FixedPointScale::variance);
+
+            // Every ratio is recomputed from its normalized weight, as in MixtureModel::updatePixel
+            const vdouble scale = 1 / weightSum;
+            for (int i = 0; i < n; i++)
+            {
+                unsigned int k = i * stride;
+                vdouble w = stored<T>(load(weight + k, FixedPointScale::weight) * scale, FixedPointScale::weight);
+                store(weight + k, w, FixedPointScale::weight);
+                store(weightDistrRatio + k, w / sqrtv(load(variance + k, FixedPointScale::variance)), FixedPointScale::ratio);
+            }
+
+            // Sort by weightRatio. When the components before the replaced last one are still in
+            // order in every lane, which is the common case on a steady pixel, the last one is
+            // inserted with one pass from the bottom. Otherwise an odd-even transposition sort, a
+            // fixed network once K is known. Both only swap neighbours that are strictly out of
+            // order, so ties keep their order exactly like the scalar insertion.
+            vmask unsorted = {};
+            for (int i = 0; i + 2 < n; i++)
+            {
+                unsigned int a = i * stride;
+                unsorted |= load(weightDistrRatio + a, FixedPointScale::ratio) < load(weightDistrRatio + a + stride, FixedPointScale::ratio);
+            }
+
+            if (!any(unsorted))
+            {
+                for (int i = n - 2; i >= 0; i--)
+                {
+                    unsigned int a = i * stride;
+                    vmask m = load(weightDistrRatio + a, FixedPointScale::ratio) < load(weightDistrRatio + a + stride, FixedPointScale::ratio);
+                    if (!any(m))
+                    {
+                        break;
+                    }
+                    swapComponents(m, meanB, meanG, meanR, variance, weight, weightDistrRatio, a, a + stride);
+                }
+            }
+            else
+            {
+                for (int round = 0; round < n; round++)
+                {
+                    for (int i = round & 1; i + 1 < n; i += 2)
+                    {
+                        unsigned int a = i * stride;
+                        vmask m = load(weightDistrRatio + a, FixedPointScale::ratio) < load(weightDistrRatio + a + stride, FixedPointScale::ratio);
+                        if (any(m))
+                        {
+                            swapComponents(m, meanB, meanG, meanR, variance, weight, weightDistrRatio, a, a + stride);
+                        }
+                    }
+                }
+            }
+
+            for (int l = 0; l < lanes; l++)
+            {
+                foreground[j + l] = isBackground[l] ? 0 : 255;
+            }
+
+            if (unmatched != nullptr)
+            {
+                for (int l = 0; l < lanes; l++)
+                {
+                    *unmatched += anyMatch[l] ? 0 : 1;
+                }
+            }
+        }
+
+        return processed;
+    }
+
+    template <typename T>
+    unsigned int updateRowT(const MixturePlanes &planes, unsigned int firstPixel, unsigned int count, const uint8_t *pixels, double threshold, uint8_t *foreground, unsigned int *unmatched)
+    {
+        switch (planes.numberOfGaussians)
+        {
+        case 3:
+            return updateRowK<3, T>(planes, firstPixel, count, pixels, threshold, foreground, unmatched);
+        case 5:
+            return updateRowK<5, T>(planes, firstPixel, count, pixels, threshold, foreground, unmatched);
+        case 7:
+            return updateRowK<7, T>(planes, firstPixel, count, pixels, threshold, foreground, unmatched);
+        default:
+            return updateRowK<0, T>(planes, firstPixel, count, pixels, threshold, foreground, unmatched);
+        }
+    }
+
+    unsigned int updateRow(const MixturePlanes &planes, unsigned int firstPixel, unsigned int count, const uint8_t *pixels, double threshold, uint8_t *foreground, unsigned int *unmatched)
+    {
+        switch (planes.precision)
+        {
+        case PRECISION_FLOAT:
+            return updateRowT<float>(planes, firstPixel, count, pixels, threshold, foreground, unmatched);
+        case PRECISION_FIXED16:
+            return updateRowT<uint16_t>(planes, firstPixel, count, pixels, threshold, foreground, unmatched);
+        default:
+            return updateRowT<double>(planes, firstPixel, count, pixels, threshold, foreground, unmatched);
+        }
+    }
+}
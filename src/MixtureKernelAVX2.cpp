@@ -0,0 +1,7 @@
+#define MIXTURE_KERNEL_LANES 4
+#include "MixtureKernel.simd.h"
+
+unsigned int updateMixtureRowAVX2(const MixturePlanes &planes, unsigned int firstPixel, unsigned int count, const uint8_t *pixels, double threshold, uint8_t *foreground, unsigned int *unmatched)
+{
+    return updateRow(planes, firstPixel, count, pixels, threshold, foreground, unmatched);
+}
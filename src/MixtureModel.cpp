@@ -0,0 +1,755 @@
+#include "../include/MixtureModel.h"
+#include <opencv2/opencv.hpp>
+
+using namespace cv;
+using namespace std;
+
+MixtureModel::MixtureModel()
+{
+    this->numberOfGaussians = 0;
+    this->numberOfPixels = 0;
+    this->pixelStride = 0;
+    this->alpha = 0;
+    this->upperboundVariance = 0;
+    this->lowerboundVariance = 0;
+    this->precision = PRECISION_DOUBLE;
+    this->buffer = nullptr;
+    this->meanB = nullptr;
+    this->meanG = nullptr;
+    this->meanR = nullptr;
+    this->variance = nullptr;
+    this->weight = nullptr;
+    this->weightDistrRatio = nullptr;
+    this->kernelType = KERNEL_SCALAR;
+    this->rowKernel = nullptr;
+    this->selectSpecialization();
+}
+
+MixtureModel::MixtureModel(unsigned int numberOfPixels, int numberOfGaussians, double alpha, double upperboundVariance, double lowerboundVariance, ModelPrecision precision)
+    : MixtureModel()
+{
+    CV_Assert(numberOfGaussians > 0 && numberOfGaussians <= maximumNumberOfGaussians);
+
+    this->numberOfGaussians = numberOfGaussians;
+    this->numberOfPixels = numberOfPixels;
+    this->precision = precision;
+    // Pad every component row to a whole number of 64 byte cache lines
+    this->pixelStride = static_cast<unsigned int>(alignSize(numberOfPixels, static_cast<int>(64 / getPrecisionSize(precision))));
+    this->alpha = alpha;
+    this->upperboundVariance = upperboundVariance;
+    this->lowerboundVariance = lowerboundVariance;
+
+    this->allocate();
+    this->selectSpecialization();
+    this->setKernel(KERNEL_AUTO);
+}
+
+MixtureModel::MixtureModel(unsigned int numberOfPixels, int numberOfGaussians, double alpha, double upperboundVariance, double lowerboundVariance, ModelPrecision precision, void *planes, const function<void()> &releasePlanes)
+    : MixtureModel()
+{
+    CV_Assert(numberOfGaussians > 0 && numberOfGaussians <= maximumNumberOfGaussians);
+    CV_Assert(reinterpret_cast<size_t>(planes) % 64 == 0);
+
+    this->numberOfGaussians = numberOfGaussians;
+    this->numberOfPixels = numberOfPixels;
+    this->precision = precision;
+    this->pixelStride = static_cast<unsigned int>(alignSize(numberOfPixels, static_cast<int>(64 / getPrecisionSize(precision))));
+    this->alpha = alpha;
+    this->upperboundVariance = upperboundVariance;
+    this->lowerboundVariance = lowerboundVariance;
+
+    this->releasePlanes = releasePlanes;
+    this->assignPlanes(static_cast<uchar *>(planes));
+    this->selectSpecialization();
+    this->setKernel(KERNEL_AUTO);
+}
+
+MixtureModel::MixtureModel(MixtureModel &&other) noexcept
+    : MixtureModel()
+{
+    *this = std::move(other);
+}
+
+MixtureModel &MixtureModel::operator=(MixtureModel &&other) noexcept
+{
+    if (this != &other)
+    {
+        this->release();
+
+        this->numberOfGaussians = other.numberOfGaussians;
+        this->numberOfPixels = other.numberOfPixels;
+        this->pixelStride = other.pixelStride;
+        this->alpha = other.alpha;
+        this->upperboundVariance = other.upperboundVariance;
+        this->lowerboundVariance = other.lowerboundVariance;
+        this->precision = other.precision;
+        this->buffer = other.buffer;
+        this->releasePlanes = std::move(other.releasePlanes);
+        this->meanB = other.meanB;
+        this->meanG = other.meanG;
+        this->meanR = other.meanR;
+        this->variance = other.variance;
+        this->weight = other.weight;
+        this->weightDistrRatio = other.weightDistrRatio;
+        this->kernelType = other.kernelType;
+        this->rowKernel = other.rowKernel;
+        this->updatePixelFunction = other.updatePixelFunction;
+        this->updateRowFunction = other.updateRowFunction;
+
+        other.buffer = nullptr;
+        other.releasePlanes = nullptr;
+        other.release();
+    }
+
+    return *this;
+}
+
+MixtureModel::~MixtureModel()
+{
+    this->release();
+}
+
+void MixtureModel::allocate()
+{
+    size_t planeSize = static_cast<size_t>(this->numberOfGaussians) * this->pixelStride * getPrecisionSize(this->precision);
+    if (planeSize == 0)
+    {
+        return;
+    }
+
+    // One block for all six planes, aligned by fastMalloc
+    uchar *block = static_cast<uchar *>(fastMalloc(6 * planeSize));
+    memset(block, 0, 6 * planeSize);
+
+    this->assignPlanes(block);
+}
+
+void MixtureModel::assignPlanes(uchar *block)
+{
+    size_t planeSize = static_cast<size_t>(this->numberOfGaussians) * this->pixelStride * getPrecisionSize(this->precision);
+
+    this->buffer = block;
+    this->meanB = block;
+    this->meanG = block + planeSize;
+    this->meanR = block + 2 * planeSize;
+    this->variance = block + 3 * planeSize;
+    this->weight = block + 4 * planeSize;
+    this->weightDistrRatio = block + 5 * planeSize;
+}
+
+void MixtureModel::release()
+{
+    if (this->releasePlanes)
+    {
+        this->releasePlanes();
+        this->releasePlanes = nullptr;
+    }
+    else if (this->buffer != nullptr)
+    {
+        fastFree(this->buffer);
+    }
+
+    this->buffer = nullptr;
+    this->meanB = nullptr;
+    this->meanG = nullptr;
+    this->meanR = nullptr;
+    this->variance = nullptr;
+    this->weight = nullptr;
+    this->weightDistrRatio = nullptr;
+}
+
+template <int K, typename T>
+void MixtureModel::reorderPixel(unsigned int pixel)
+{
+    // K is 0 for mixtures without a specialization
+    const int n = K > 0 ? K : this->numberOfGaussians;
+    const unsigned int stride = this->pixelStride;
+
+    T *meanB = static_cast<T *>(this->meanB) + pixel;
+    T *meanG = static_cast<T *>(this->meanG) + pixel;
+    T *meanR = static_cast<T *>(this->meanR) + pixel;
+    T *variance = static_cast<T *>(this->variance) + pixel;
+    T *weight = static_cast<T *>(this->weight) + pixel;
+    T *weightDistrRatio = static_cast<T *>(this->weightDistrRatio) + pixel;
+
+    // Stable insertion by descending weightRatio. An update only moves the matched and the
+    // replaced components, so this is close to one comparison per component. Encoding is
+    // monotonic, so the stored values compare like the decoded ones.
+    for (int i = 1; i < n; i++)
+    {
+        T ratio = weightDistrRatio[i * stride];
+        if (!(weightDistrRatio[(i - 1) * stride] < ratio))
+        {
+            continue;
+        }
+
+        unsigned int k = i * stride;
+        T mB = meanB[k];
+        T mG = meanG[k];
+        T mR = meanR[k];
+        T var = variance[k];
+        T w = weight[k];
+
+        int j = i;
+        while (j > 0 && weightDistrRatio[(j - 1) * stride] < ratio)
+        {
+            unsigned int to = j * stride;
+            unsigned int from = to - stride;
+            meanB[to] = meanB[from];
+            meanG[to] = meanG[from];
+            meanR[to] = meanR[from];
+            variance[to] = variance[from];
+            weight[to] = weight[from];
+            weightDistrRatio[to] = weightDistrRatio[from];
+            j--;
+        }
+
+        k = j * stride;
+        meanB[k] = mB;
+        meanG[k] = mG;
+        meanR[k] = mR;
+        variance[k] = var;
+        weight[k] = w;
+        weightDistrRatio[k] = ratio;
+    }
+}
+
+void MixtureModel::initializePixel(unsigned int pixel, const Vec3b *samples, int count)
+{
+    switch (this->precision)
+    {
+    case PRECISION_FLOAT:
+        this->initializePixelT<float>(pixel, samples, count);
+        break;
+    case PRECISION_FIXED16:
+        this->initializePixelT<uint16_t>(pixel, samples, count);
+        break;
+    default:
+        this->initializePixelT<double>(pixel, samples, count);
+        break;
+    }
+}
+
+template <typename T>
+void MixtureModel::initializePixelT(unsigned int pixel, const Vec3b *samples, int count)
+{
+    const int K = this->numberOfGaussians;
+    const unsigned int stride = this->pixelStride;
+
+    T *meanB = static_cast<T *>(this->meanB);
+    T *meanG = static_cast<T *>(this->meanG);
+    T *meanR = static_cast<T *>(this->meanR);
+    T *variance = static_cast<T *>(this->variance);
+    T *weight = static_cast<T *>(this->weight);
+    T *weightDistrRatio = static_cast<T *>(this->weightDistrRatio);
+
+    // Initialize the Gaussian components, same as the sample constructor of Gaussian
+    for (int i = 0; i < K; i++)
+    {
+        unsigned int index = i * stride + pixel;
+        Vec3b sample = samples[i % count];
+
+        double mB = static_cast<double>(sample[0]);
+        double mG = static_cast<double>(sample[1]);
+        double mR = static_cast<double>(sample[2]);
+        double mean = (mB + mG + mR) / 3;
+
+        double var = 0;
+        for (int j = 0; j < count; j++)
+        {
+            var += (samples[j][0] - mean) + (samples[j][1] - mean) + (samples[j][2] - mean);
+        }
+        var /= count;
+
+        if (var < this->lowerboundVariance)
+        {
+            var = this->lowerboundVariance;
+        }
+
+        meanB[index] = encodeValue<T>(mB, FixedPointScale::mean);
+        meanG[index] = encodeValue<T>(mG, FixedPointScale::mean);
+        meanR[index] = encodeValue<T>(mR, FixedPointScale::mean);
+        variance[index] = encodeValue<T>(var, FixedPointScale::variance);
+        weight[index] = encodeValue<T>(1.0 / K, FixedPointScale::weight);
+
+        double w = decodeValue<T>(weight[index], FixedPointScale::weight);
+        var = decodeValue<T>(variance[index], FixedPointScale::variance);
+        weightDistrRatio[index] = encodeValue<T>(w / sqrt(var), FixedPointScale::ratio);
+    }
+
+    // Sort the Gaussian components by their weightRatio
+    this->reorderPixel<0, T>(pixel);
+}
+
+bool MixtureModel::isBackground(unsigned int pixel, const Vec3b &value, double threshold) const
+{
+    switch (this->precision)
+    {
+    case PRECISION_FLOAT:
+        return this->isBackgroundT<float>(pixel, value, threshold);
+    case PRECISION_FIXED16:
+        return this->isBackgroundT<uint16_t>(pixel, value, threshold);
+    default:
+        return this->isBackgroundT<double>(pixel, value, threshold);
+    }
+}
+
+template <typename T>
+bool MixtureModel::isBackgroundT(unsigned int pixel, const Vec3b &value, double threshold) const
+{
+    const int n = this->numberOfGaussians;
+    const unsigned int stride = this->pixelStride;
+
+    const T *meanB = static_cast<const T *>(this->meanB) + pixel;
+    const T *meanG = static_cast<const T *>(this->meanG) + pixel;
+    const T *meanR = static_cast<const T *>(this->meanR) + pixel;
+    const T *variance = static_cast<const T *>(this->variance) + pixel;
+    const T *weightDistrRatio = static_cast<const T *>(this->weightDistrRatio) + pixel;
+
+    // Same background components as updatePixelK, components are in descending order
+    int index = 0;
+    double sum = 0;
+    while (index < n && sum < threshold)
+    {
+        sum += decodeValue<T>(weightDistrRatio[index * stride], FixedPointScale::ratio);
+        index++;
+    }
+
+    for (int i = 0; i < index; i++)
+    {
+        unsigned int k = i * stride;
+        double dB = decodeValue<T>(meanB[k], FixedPointScale::mean) - value[0];
+        double dG = decodeValue<T>(meanG[k], FixedPointScale::mean) - value[1];
+        double dR = decodeValue<T>(meanR[k], FixedPointScale::mean) - value[2];
+        if (dB * dB + dG * dG + dR * dR < 7.5 * decodeValue<T>(variance[k], FixedPointScale::variance))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void MixtureModel::decayWeights(double *weights, const bool *matches, unsigned int frames) const
+{
+    // Before the normalization a matching weight becomes (1 - alpha) * v + alpha * V, V the sum
+    // of all weights, and the others are left alone. So after f updates a matching weight is
+    // (1 - alpha)^f * v + h, with the same h for all of them, and h follows
+    //   h' = g * h + alpha * (unmatchedSum + (1 - alpha)^t * matchedSum),  g = 1 + alpha * (c - 1)
+    // for c matching components. All weights are divided by g^f, which the normalization undoes.
+    const int n = this->numberOfGaussians;
+    const double alpha = this->alpha;
+    double matchedSum = 0;
+    double unmatchedSum = 0;
+    int matchCount = 0;
+    for (int i = 0; i < n; i++)
+    {
+        if (matches[i])
+        {
+            matchedSum += weights[i];
+            matchCount++;
+        }
+        else
+        {
+            unmatchedSum += weights[i];
+        }
+    }
+
+    const double f = static_cast<double>(frames);
+    const double decay = pow(1 - alpha, f);
+    double scale = 1;
+    double level = f * alpha * unmatchedSum + (1 - decay) * matchedSum;
+    if (matchCount > 1)
+    {
+        const double c = matchCount;
+        scale = pow(1 + alpha * (c - 1), -f);
+        level = unmatchedSum / (c - 1) * (1 - scale) + matchedSum / c * (1 - decay * scale);
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        weights[i] = matches[i] ? decay * scale * weights[i] + level : scale * weights[i];
+    }
+}
+
+void MixtureModel::decayPixel(unsigned int pixel, const Vec3b &value, unsigned int frames)
+{
+    if (frames == 0)
+    {
+        return;
+    }
+
+    switch (this->precision)
+    {
+    case PRECISION_FLOAT:
+        this->decayPixelT<float>(pixel, value, frames);
+        break;
+    case PRECISION_FIXED16:
+        this->decayPixelT<uint16_t>(pixel, value, frames);
+        break;
+    default:
+        this->decayPixelT<double>(pixel, value, frames);
+        break;
+    }
+}
+
+template <typename T>
+void MixtureModel::decayPixelT(unsigned int pixel, const Vec3b &value, unsigned int frames)
+{
+    const int n = this->numberOfGaussians;
+    const unsigned int stride = this->pixelStride;
+
+    T *meanB = static_cast<T *>(this->meanB) + pixel;
+    T *meanG = static_cast<T *>(this->meanG) + pixel;
+    T *meanR = static_cast<T *>(this->meanR) + pixel;
+    T *variance = static_cast<T *>(this->variance) + pixel;
+    T *weight = static_cast<T *>(this->weight) + pixel;
+    T *weightDistrRatio = static_cast<T *>(this->weightDistrRatio) + pixel;
+
+    double weights[maximumNumberOfGaussians];
+    bool matches[maximumNumberOfGaussians] = {};
+    for (int i = 0; i < n; i++)
+    {
+        unsigned int k = i * stride;
+        weights[i] = decodeValue<T>(weight[k], FixedPointScale::weight);
+
+        double var = decodeValue<T>(variance[k], FixedPointScale::variance);
+        double dB = decodeValue<T>(meanB[k], FixedPointScale::mean) - value[0];
+        double dG = decodeValue<T>(meanG[k], FixedPointScale::mean) - value[1];
+        double dR = decodeValue<T>(meanR[k], FixedPointScale::mean) - value[2];
+        matches[i] = dB * dB + dG * dG + dR * dR < 3 * var;
+    }
+
+    // The first skipped update replaced the last component with one centred on the value,
+    // which then matched every later one along with the components within 3 sigma
+    this->decayWeights(weights, matches, 1);
+    matches[n - 1] = true;
+    this->decayWeights(weights, matches, frames - 1);
+
+    double weightSum = 0;
+    for (int i = 0; i < n; i++)
+    {
+        weightSum += weights[i];
+    }
+
+    // The means and variances the matching components would have learned are left out, which
+    // is why AGMM bounds the gap
+    unsigned int last = (n - 1) * stride;
+    meanB[last] = encodeValue<T>(static_cast<double>(value[0]), FixedPointScale::mean);
+    meanG[last] = encodeValue<T>(static_cast<double>(value[1]), FixedPointScale::mean);
+    meanR[last] = encodeValue<T>(static_cast<double>(value[2]), FixedPointScale::mean);
+    variance[last] = encodeValue<T>(this->upperboundVariance, FixedPointScale::variance);
+
+    for (int i = 0; i < n; i++)
+    {
+        unsigned int k = i * stride;
+        weight[k] = encodeValue<T>(weights[i] / weightSum, FixedPointScale::weight);
+        double w = decodeValue<T>(weight[k], FixedPointScale::weight);
+        weightDistrRatio[k] = encodeValue<T>(w / sqrt(decodeValue<T>(variance[k], FixedPointScale::variance)), FixedPointScale::ratio);
+    }
+
+    // Sort the Gaussian components by their weightRatio
+    this->reorderPixel<0, T>(pixel);
+}
+
+bool MixtureModel::updatePixel(unsigned int pixel, const Vec3b &value, double threshold)
+{
+    return (this->*updatePixelFunction)(pixel, value, threshold, nullptr);
+}
+
+template <int K, typename T>
+bool MixtureModel::updatePixelK(unsigned int pixel, const Vec3b &value, double threshold, bool *matched)
+{
+    // K is 0 for mixtures without a specialization
+    const int n = K > 0 ? K : this->numberOfGaussians;
+    const unsigned int stride = this->pixelStride;
+    const double alpha = this->alpha;
+
+    T *meanB = static_cast<T *>(this->meanB) + pixel;
+    T *meanG = static_cast<T *>(this->meanG) + pixel;
+    T *meanR = static_cast<T *>(this->meanR) + pixel;
+    T *variance = static_cast<T *>(this->variance) + pixel;
+    T *weight = static_cast<T *>(this->weight) + pixel;
+    T *weightDistrRatio = static_cast<T *>(this->weightDistrRatio) + pixel;
+
+    // Reads decode the stored value and writes round to the storage type, for doubles both are no-ops
+    auto getWeight = [weight](unsigned int k)
+    { return decodeValue<T>(weight[k], FixedPointScale::weight); };
+    auto getVariance = [variance](unsigned int k)
+    { return decodeValue<T>(variance[k], FixedPointScale::variance); };
+
+    bool isBackground = false;
+    bool found = false;
+    bool anyMatch = false;
+    double ratioSum = 0;
+    double weightSum = 0;
+    for (int i = 0; i < n; i++)
+    {
+        unsigned int k = i * stride;
+        double w = getWeight(k);
+        double mB = decodeValue<T>(meanB[k], FixedPointScale::mean);
+        double mG = decodeValue<T>(meanG[k], FixedPointScale::mean);
+        double mR = decodeValue<T>(meanR[k], FixedPointScale::mean);
+        double var = getVariance(k);
+
+        double dB = mB - value[0];
+        double dG = mG - value[1];
+        double dR = mR - value[2];
+        double distance = dB * dB + dG * dG + dR * dR;
+
+        // Component i is inside the background index while the ratios before it sum below the threshold
+        if (distance < 7.5 * var && ratioSum < threshold)
+        {
+            isBackground = true;
+        }
+        ratioSum += decodeValue<T>(weightDistrRatio[k], FixedPointScale::ratio);
+
+        if (found)
+        {
+            weight[k] = encodeValue<T>(max(w * (1 - alpha), 0.0001), FixedPointScale::weight);
+        }
+        else if (distance < 3 * var)
+        {
+            anyMatch = true;
+            weight[k] = encodeValue<T>((1 - alpha) * w + alpha, FixedPointScale::weight);
+
+            // The last component is replaced below, so only its weight is kept
+            if (i < n - 1)
+            {
+                double probability = (1 / sqrt(2 * M_PI * var)) * exp(-distance / (2 * var));
+
+                meanB[k] = encodeValue<T>((1 - alpha) * mB + probability * static_cast<double>(value[0]), FixedPointScale::mean);
+                meanG[k] = encodeValue<T>((1 - alpha) * mG + probability * static_cast<double>(value[1]), FixedPointScale::mean);
+                meanR[k] = encodeValue<T>((1 - alpha) * mR + probability * static_cast<double>(value[2]), FixedPointScale::mean);
+                double newVariance = (1 - alpha) * var + probability * (distance - var);
+
+                if (newVariance < this->lowerboundVariance)
+                {
+                    newVariance = this->lowerboundVariance;
+                }
+                else if (newVariance > 5 * this->upperboundVariance)
+                {
+                    newVariance = 5 * this->upperboundVariance;
+                }
+
+                variance[k] = encodeValue<T>(newVariance, FixedPointScale::variance);
+            }
+        }
+
+        weightSum += getWeight(k);
+    }
+
+    if (!found)
+    {
+        // Replace the last component with one centred on the pixel, keeping its weight
+        unsigned int k = (n - 1) * stride;
+        meanB[k] = encodeValue<T>(static_cast<double>(value[0]), FixedPointScale::mean);
+        meanG[k] = encodeValue<T>(static_cast<double>(value[1]), FixedPointScale::mean);
+        meanR[k] = encodeValue<T>(static_cast<double>(value[2]), FixedPointScale::mean);
+        variance[k] = encodeValue<T>(this->upperboundVariance, FixedPointScale::variance);
+    }
+
+    // Every ratio is recomputed from its normalized weight, like the original. Components of
+    // the same weight and variance then have the same ratio and keep their order, which a
+    // ratio scaled along with its weight would only do up to rounding.
+    const double scale = 1 / weightSum;
+    for (int i = 0; i < n; i++)
+    {
+        unsigned int k = i * stride;
+        weight[k] = encodeValue<T>(getWeight(k) * scale, FixedPointScale::weight);
+        weightDistrRatio[k] = encodeValue<T>(getWeight(k) / sqrt(getVariance(k)), FixedPointScale::ratio);
+    }
+
+    // Sort the Gaussian components by their weightRatio. The sort is stable, so the vectorized
+    // kernels move the same components.
+    this->reorderPixel<K, T>(pixel);
+
+    if (matched != nullptr)
+    {
+        *matched = anyMatch;
+    }
+
+    return isBackground;
+}
+
+void MixtureModel::updateRow(unsigned int firstPixel, unsigned int count, const Vec3b *pixels, double threshold, uchar *foreground, unsigned int *unmatched)
+{
+    (this->*updateRowFunction)(firstPixel, count, pixels, threshold, foreground, unmatched);
+}
+
+template <int K, typename T>
+void MixtureModel::updateRowK(unsigned int firstPixel, unsigned int count, const Vec3b *pixels, double threshold, uchar *foreground, unsigned int *unmatched)
+{
+    unsigned int processed = 0;
+    if (this->rowKernel != nullptr)
+    {
+        MixturePlanes planes;
+        planes.meanB = this->meanB;
+        planes.meanG = this->meanG;
+        planes.meanR = this->meanR;
+        planes.variance = this->variance;
+        planes.weight = this->weight;
+        planes.weightDistrRatio = this->weightDistrRatio;
+        planes.precision = this->precision;
+        planes.stride = this->pixelStride;
+        planes.numberOfGaussians = this->numberOfGaussians;
+        planes.alpha = this->alpha;
+        planes.lowerboundVariance = this->lowerboundVariance;
+        planes.upperboundVariance = this->upperboundVariance;
+
+        processed = this->rowKernel(planes, firstPixel, count, reinterpret_cast<const uint8_t *>(pixels), threshold, foreground, unmatched);
+    }
+
+    // Pixels that do not fill a whole vector take the scalar path
+    for (unsigned int j = processed; j < count; j++)
+    {
+        bool matched;
+        foreground[j] = this->updatePixelK<K, T>(firstPixel + j, pixels[j], threshold, &matched) ? 0 : 255;
+        if (unmatched != nullptr && !matched)
+        {
+            (*unmatched)++;
+        }
+    }
+}
+
+void MixtureModel::selectSpecialization()
+{
+    switch (this->precision)
+    {
+    case PRECISION_FLOAT:
+        this->selectSpecialization<float>();
+        break;
+    case PRECISION_FIXED16:
+        this->selectSpecialization<uint16_t>();
+        break;
+    default:
+        this->selectSpecialization<double>();
+        break;
+    }
+}
+
+template <typename T>
+void MixtureModel::selectSpecialization()
+{
+    // Component counts with a fully unrolled update, others use the runtime loop
+    switch (this->numberOfGaussians)
+    {
+    case 3:
+        this->updatePixelFunction = &MixtureModel::updatePixelK<3, T>;
+        this->updateRowFunction = &MixtureModel::updateRowK<3, T>;
+        break;
+    case 5:
+        this->updatePixelFunction = &MixtureModel::updatePixelK<5, T>;
+        this->updateRowFunction = &MixtureModel::updateRowK<5, T>;
+        break;
+    case 7:
+        this->updatePixelFunction = &MixtureModel::updatePixelK<7, T>;
+        this->updateRowFunction = &MixtureModel::updateRowK<7, T>;
+        break;
+    default:
+        this->updatePixelFunction = &MixtureModel::updatePixelK<0, T>;
+        this->updateRowFunction = &MixtureModel::updateRowK<0, T>;
+        break;
+    }
+}
+
+void MixtureModel::setKernel(MixtureKernelType kernelType)
+{
+    this->kernelType = kernelType;
+    this->rowKernel = getMixtureRowKernel(this->kernelType);
+}
+
+MixtureKernelType MixtureModel::getKernel() const
+{
+    return this->kernelType;
+}
+
+int MixtureModel::getNumberOfGaussians() const
+{
+    return this->numberOfGaussians;
+}
+
+unsigned int MixtureModel::getNumberOfPixels() const
+{
+    return this->numberOfPixels;
+}
+
+unsigned int MixtureModel::getPixelStride() const
+{
+    return this->pixelStride;
+}
+
+double MixtureModel::getAlpha() const
+{
+    return this->alpha;
+}
+
+double MixtureModel::getUpperboundVariance() const
+{
+    return this->upperboundVariance;
+}
+
+double MixtureModel::getLowerboundVariance() const
+{
+    return this->lowerboundVariance;
+}
+
+ModelPrecision MixtureModel::getPrecision() const
+{
+    return this->precision;
+}
+
+size_t MixtureModel::getMemorySize() const
+{
+    return 6 * static_cast<size_t>(this->numberOfGaussians) * this->pixelStride * getPrecisionSize(this->precision);
+}
+
+const void *MixtureModel::getPlanes() const
+{
+    return this->buffer;
+}
+
+double MixtureModel::getValue(const void *plane, double scale, unsigned int pixel, int component) const
+{
+    size_t index = static_cast<size_t>(component) * this->pixelStride + pixel;
+
+    switch (this->precision)
+    {
+    case PRECISION_FLOAT:
+        return decodeValue<float>(static_cast<const float *>(plane)[index], scale);
+    case PRECISION_FIXED16:
+        return decodeValue<uint16_t>(static_cast<const uint16_t *>(plane)[index], scale);
+    default:
+        return decodeValue<double>(static_cast<const double *>(plane)[index], scale);
+    }
+}
+
+double MixtureModel::getMeanB(unsigned int pixel, int component) const
+{
+    return this->getValue(this->meanB, FixedPointScale::mean, pixel, component);
+}
+
+double MixtureModel::getMeanG(unsigned int pixel, int component) const
+{
+    return this->getValue(this->meanG, FixedPointScale::mean, pixel, component);
+}
+
+double MixtureModel::getMeanR(unsigned int pixel, int component) const
+{
+    return this->getValue(this->meanR, FixedPointScale::mean, pixel, component);
+}
+
+double MixtureModel::getVariance(unsigned int pixel, int component) const
+{
+    return this->getValue(this->variance, FixedPointScale::variance, pixel, component);
+}
+
+double MixtureModel::getWeight(unsigned int pixel, int component) const
+{
+    return this->getValue(this->weight, FixedPointScale::weight, pixel, component);
+}
+
+double MixtureModel::getWeightDistrRatio(unsigned int pixel, int component) const
+{
+    return this->getValue(this->weightDistrRatio, FixedPointScale::ratio, pixel, component);
+}
@@ -0,0 +1,82 @@
+#include "../include/MixtureReservoir.h"
+#include <opencv2/opencv.hpp>
+
+using namespace cv;
+using namespace std;
+
+namespace
+{
+    // splitmix64 finalizer. Neighbouring runs get unrelated generators, which seeding
+    // cv::RNG with consecutive values would not give.
+    uint64 mixSeed(uint64 x)
+    {
+        x += 0x9E3779B97F4A7C15ULL;
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+        return x ^ (x >> 31);
+    }
+}
+
+MixtureReservoir::MixtureReservoir(unsigned int numberOfPixels, int numberOfSamples, uint64 seed)
+{
+    this->numberOfPixels = numberOfPixels;
+    this->numberOfSamples = numberOfSamples;
+    this->numberOfFrames = 0;
+    this->seed = seed;
+    this->samples.resize(static_cast<size_t>(numberOfPixels) * numberOfSamples);
+}
+
+void MixtureReservoir::addPixels(unsigned int firstPixel, unsigned int count, const Vec3b *pixels)
+{
+    const int K = this->numberOfSamples;
+    const int frame = this->numberOfFrames;
+    Vec3b *slots = &this->samples[static_cast<size_t>(firstPixel) * K];
+
+    // The first K frames fill the reservoir
+    if (frame < K)
+    {
+        for (unsigned int j = 0; j < count; j++)
+        {
+            slots[j * K + frame] = pixels[j];
+        }
+        return;
+    }
+
+    // Algorithm R: frame f replaces a random slot with probability K / (f + 1)
+    RNG rng(mixSeed(this->seed ^ mixSeed((static_cast<uint64>(frame) << 32) | firstPixel)));
+    for (unsigned int j = 0; j < count; j++)
+    {
+        int slot = rng.uniform(0, frame + 1);
+        if (slot < K)
+        {
+            slots[j * K + slot] = pixels[j];
+        }
+    }
+}
+
+void MixtureReservoir::finishFrame()
+{
+    this->numberOfFrames++;
+}
+
+void MixtureReservoir::initializeModel(MixtureModel &model, unsigned int firstPixel, unsigned int count) const
+{
+    const int K = this->numberOfSamples;
+    const int available = min(this->numberOfFrames, K);
+
+    for (unsigned int j = 0; j < count; j++)
+    {
+        unsigned int pixel = firstPixel + j;
+        model.initializePixel(pixel, &this->samples[static_cast<size_t>(pixel) * K], available);
+    }
+}
+
+int MixtureReservoir::getNumberOfFrames() const
+{
+    return this->numberOfFrames;
+}
+
+size_t MixtureReservoir::getMemorySize() const
+{
+    return this->samples.size() * sizeof(Vec3b);
+}
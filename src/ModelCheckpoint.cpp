@@ -0,0 +1,169 @@
+#include "../include/ModelCheckpoint.h"
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <opencv2/opencv.hpp>
+
+using namespace cv;
+using namespace std;
+
+// The layout is part of the file format
+static_assert(sizeof(ModelCheckpointHeader) == 112, "ModelCheckpointHeader must not change size");
+
+namespace
+{
+    const char checkpointMagic[8] = {'A', 'G', 'M', 'M', 'C', 'K', 'P', 'T'};
+    const uint32_t checkpointByteOrder = 0x01020304;
+
+    // Planes start on a page boundary of any common page size, so the mapping keeps them aligned
+    const uint64_t planesAlignment = 65536;
+}
+
+ModelCheckpoint::~ModelCheckpoint()
+{
+    this->unmap();
+}
+
+void ModelCheckpoint::unmap()
+{
+    if (this->mapping != nullptr)
+    {
+        munmap(this->mapping, this->mappingSize);
+    }
+
+    this->mapping = nullptr;
+    this->mappingSize = 0;
+}
+
+bool ModelCheckpoint::write(const string &path, ModelCheckpointHeader header, const void *planes, const Mat &background)
+{
+    memcpy(header.magic, checkpointMagic, sizeof(header.magic));
+    header.version = currentVersion;
+    header.byteOrder = checkpointByteOrder;
+    header.planesOffset = planesAlignment;
+    header.backgroundOffset = alignSize(header.planesOffset + header.planesSize, 64);
+    header.backgroundSize = static_cast<uint64_t>(header.modelRows) * header.modelCols * 3;
+
+    string temporaryPath = path + ".tmp";
+    ofstream out(temporaryPath, ios::binary | ios::trunc);
+    if (!out.is_open())
+    {
+        this->error = temporaryPath + " cannot be written.";
+        return false;
+    }
+
+    vector<char> padding(planesAlignment, 0);
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(padding.data(), header.planesOffset - sizeof(header));
+    out.write(static_cast<const char *>(planes), header.planesSize);
+    out.write(padding.data(), header.backgroundOffset - header.planesOffset - header.planesSize);
+    for (uint32_t i = 0; i < header.modelRows; i++)
+    {
+        out.write(background.ptr<char>(i), static_cast<streamsize>(header.modelCols) * 3);
+    }
+    out.close();
+
+    if (!out || rename(temporaryPath.c_str(), path.c_str()) != 0)
+    {
+        this->error = path + " cannot be written.";
+        remove(temporaryPath.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool ModelCheckpoint::map(const string &path)
+{
+    this->unmap();
+
+    int file = open(path.c_str(), O_RDONLY);
+    if (file < 0)
+    {
+        this->error = path + " cannot be opened.";
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(file, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(ModelCheckpointHeader))
+    {
+        close(file);
+        this->error = path + " is not a model checkpoint.";
+        return false;
+    }
+
+    // Private and writable: the model updates its copy, the file stays as it was saved
+    void *mapping = mmap(nullptr, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+    close(file);
+    if (mapping == MAP_FAILED)
+    {
+        this->error = path + " cannot be mapped.";
+        return false;
+    }
+    this->mapping = mapping;
+    this->mappingSize = info.st_size;
+
+    const ModelCheckpointHeader &header = this->getHeader();
+    if (memcmp(header.magic, checkpointMagic, sizeof(header.magic)) != 0)
+    {
+        this->error = path + " is not a model checkpoint.";
+    }
+    else if (header.byteOrder != checkpointByteOrder)
+    {
+        this->error = path + " was written on a machine of another byte order.";
+    }
+    else if (header.version != currentVersion)
+    {
+        this->error = path + " has version " + to_string(header.version) + ", expected " + to_string(currentVersion) + ".";
+    }
+    else if (header.planesOffset % planesAlignment != 0 ||
+             header.planesOffset + header.planesSize > this->mappingSize ||
+             header.backgroundOffset + header.backgroundSize > this->mappingSize ||
+             header.backgroundSize != static_cast<uint64_t>(header.modelRows) * header.modelCols * 3)
+    {
+        this->error = path + " is truncated or damaged.";
+    }
+    else
+    {
+        return true;
+    }
+
+    this->unmap();
+    return false;
+}
+
+const ModelCheckpointHeader &ModelCheckpoint::getHeader() const
+{
+    return *static_cast<const ModelCheckpointHeader *>(this->mapping);
+}
+
+void *ModelCheckpoint::getPlanes() const
+{
+    return static_cast<uchar *>(this->mapping) + this->getHeader().planesOffset;
+}
+
+Mat ModelCheckpoint::getBackground() const
+{
+    const ModelCheckpointHeader &header = this->getHeader();
+    return Mat(header.modelRows, header.modelCols, CV_8UC3, static_cast<uchar *>(this->mapping) + header.backgroundOffset);
+}
+
+function<void()> ModelCheckpoint::releaseMapping()
+{
+    void *mapping = this->mapping;
+    size_t mappingSize = this->mappingSize;
+    this->mapping = nullptr;
+    this->mappingSize = 0;
+
+    return [mapping, mappingSize]()
+    { munmap(mapping, mappingSize); };
+}
+
+const string &ModelCheckpoint::getError() const
+{
+    return this->error;
+}
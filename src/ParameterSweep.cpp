@@ -0,0 +1,241 @@
+#include "../include/ParameterSweep.h"
+#include "../include/ThreadPool.h"
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <opencv2/opencv.hpp>
+
+using namespace cv;
+using namespace std;
+
+namespace
+{
+    /**
+     * Model and running score of one configuration.
+     */
+    struct SweepState
+    {
+        unique_ptr<AGMM> agmm;
+        Mat mask;
+        Mat result;
+        Mat overlap;
+        unsigned long frames = 0;
+        unsigned long scoredFrames = 0;
+        double seconds = 0;
+        uint64 truePositives = 0;
+        uint64 falsePositives = 0;
+        uint64 falseNegatives = 0;
+    };
+
+    /**
+     * A frame of a batch with its ground truth split into the scored classes.
+     */
+    struct SweepFrame
+    {
+        Mat frame;
+        Mat groundTruth;
+        Mat foreground;
+        Mat background;
+        int foregroundPixels = 0;
+        bool scored = false;
+    };
+}
+
+ParameterSweep::ParameterSweep(const vector<AGMMParameters> &configurations, int numberOfJobs)
+{
+    this->configurations = configurations;
+    this->numberOfJobs = numberOfJobs > 0 ? numberOfJobs : static_cast<int>(max(1u, thread::hardware_concurrency()));
+}
+
+void ParameterSweep::setModelPrecision(ModelPrecision modelPrecision)
+{
+    this->modelPrecision = modelPrecision;
+}
+
+void ParameterSweep::setRandomSeed(uint64 seed)
+{
+    this->seed = seed;
+}
+
+void ParameterSweep::setWarmup(int frames)
+{
+    this->warmupFrames = max(frames, 0);
+}
+
+void ParameterSweep::setBatchSize(int frames)
+{
+    this->batchSize = max(frames, 1);
+}
+
+vector<SweepResult> ParameterSweep::run(const function<bool(Mat &frame, Mat &groundTruth)> &nextFrame, unsigned long maximumFrames)
+{
+    this->error.clear();
+    this->skipped.clear();
+
+    // A model that cannot hold the variance bounds would saturate them, so those configurations are not scored
+    vector<AGMMParameters> configurations;
+    for (const AGMMParameters &parameters : this->configurations)
+    {
+        if (fitsPrecision(this->modelPrecision, parameters.lowerboundVariance, parameters.upperboundVariance))
+        {
+            configurations.push_back(parameters);
+        }
+        else
+        {
+            this->skipped.push_back(parameters);
+        }
+    }
+
+    const int count = static_cast<int>(configurations.size());
+    if (count == 0)
+    {
+        if (!this->skipped.empty())
+        {
+            this->error = string("No configuration has variance bounds ") + getPrecisionName(this->modelPrecision) + " models can hold.";
+        }
+        return vector<SweepResult>();
+    }
+
+    // The calling thread takes configurations as well, a single job runs them in turn
+    vector<SweepState> states(count);
+    unique_ptr<ThreadPool> pool;
+    if (this->numberOfJobs > 1)
+    {
+        pool.reset(new ThreadPool(this->numberOfJobs - 1));
+    }
+    auto forEachConfiguration = [&](const function<void(SweepState &, const AGMMParameters &)> &body)
+    {
+        auto tile = [&](const Range &range)
+        {
+            for (int i = range.start; i < range.end; i++)
+            {
+                body(states[i], configurations[i]);
+            }
+        };
+
+        if (pool)
+        {
+            pool->parallelFor(Range(0, count), count, PRIORITY_NORMAL, tile);
+        }
+        else
+        {
+            tile(Range(0, count));
+        }
+    };
+
+    // Every model is initialized from the same frames
+    vector<Mat> initialization(this->initializationFrames);
+    Mat groundTruth;
+    for (Mat &frame : initialization)
+    {
+        if (!nextFrame(frame, groundTruth))
+        {
+            this->error = "The clip is shorter than the " + to_string(this->initializationFrames) + " initialization frames.";
+            return vector<SweepResult>();
+        }
+    }
+    const int rows = initialization[0].rows;
+    const int cols = initialization[0].cols;
+
+    forEachConfiguration([&](SweepState &state, const AGMMParameters &parameters)
+                         {
+        state.agmm.reset(new AGMM(rows, cols));
+        state.agmm->setParameters(parameters);
+        state.agmm->setModelPrecision(this->modelPrecision);
+        state.agmm->setRandomSeed(this->seed);
+        state.agmm->initializeModel(initialization); });
+    initialization.clear();
+
+    // Frames are read into the buffers of the batch, which the source may reuse
+    vector<SweepFrame> batch(this->batchSize);
+    unsigned long framesRead = this->initializationFrames;
+    bool finished = false;
+    while (!finished)
+    {
+        int size = 0;
+        while (size < this->batchSize)
+        {
+            if ((maximumFrames > 0 && framesRead >= maximumFrames) || !nextFrame(batch[size].frame, batch[size].groundTruth))
+            {
+                finished = true;
+                break;
+            }
+
+            SweepFrame &frame = batch[size];
+            if (frame.frame.rows != rows || frame.frame.cols != cols || frame.frame.type() != CV_8UC3 ||
+                frame.groundTruth.rows != rows || frame.groundTruth.cols != cols || frame.groundTruth.type() != CV_8UC1)
+            {
+                this->error = "Frame " + to_string(framesRead) + " or its ground truth does not have the size of the clip.";
+                return vector<SweepResult>();
+            }
+
+            frame.scored = framesRead - this->initializationFrames >= static_cast<unsigned long>(this->warmupFrames);
+            if (frame.scored)
+            {
+                compare(frame.groundTruth, 192, frame.foreground, CMP_GT);
+                compare(frame.groundTruth, 64, frame.background, CMP_LT);
+                frame.foregroundPixels = countNonZero(frame.foreground);
+            }
+            framesRead++;
+            size++;
+        }
+
+        if (size == 0)
+        {
+            break;
+        }
+
+        forEachConfiguration([&](SweepState &state, const AGMMParameters &)
+                             {
+            for (int b = 0; b < size; b++)
+            {
+                const SweepFrame &frame = batch[b];
+                int64 startTicks = getTickCount();
+                state.agmm->processFrame(frame.frame, state.mask, state.result);
+                state.seconds += (getTickCount() - startTicks) / getTickFrequency();
+                state.frames++;
+
+                if (frame.scored)
+                {
+                    bitwise_and(state.mask, frame.foreground, state.overlap);
+                    int hits = countNonZero(state.overlap);
+                    bitwise_and(state.mask, frame.background, state.overlap);
+                    state.truePositives += hits;
+                    state.falsePositives += countNonZero(state.overlap);
+                    state.falseNegatives += frame.foregroundPixels - hits;
+                    state.scoredFrames++;
+                }
+            } });
+    }
+
+    vector<SweepResult> results(count);
+    for (int i = 0; i < count; i++)
+    {
+        const SweepState &state = states[i];
+        SweepResult &result = results[i];
+        double truePositives = static_cast<double>(state.truePositives);
+
+        result.parameters = configurations[i];
+        result.frames = state.frames;
+        result.scoredFrames = state.scoredFrames;
+        result.seconds = state.seconds;
+        result.framesPerSecond = state.seconds > 0 ? state.frames / state.seconds : 0;
+        result.precision = state.truePositives + state.falsePositives > 0 ? truePositives / (state.truePositives + state.falsePositives) : 0;
+        result.recall = state.truePositives + state.falseNegatives > 0 ? truePositives / (state.truePositives + state.falseNegatives) : 0;
+        result.f1 = result.precision + result.recall > 0 ? 2 * result.precision * result.recall / (result.precision + result.recall) : 0;
+    }
+
+    stable_sort(results.begin(), results.end(), [](const SweepResult &a, const SweepResult &b)
+                { return a.f1 != b.f1 ? a.f1 > b.f1 : a.framesPerSecond > b.framesPerSecond; });
+    return results;
+}
+
+const string &ParameterSweep::getError() const
+{
+    return this->error;
+}
+
+const vector<AGMMParameters> &ParameterSweep::getSkipped() const
+{
+    return this->skipped;
+}
@@ -0,0 +1,210 @@
+#include "../include/Prefilter.h"
+#include <cmath>
+#include <opencv2/opencv.hpp>
+
+using namespace cv;
+using namespace std;
+
+namespace
+{
+    // Index of a pixel outside of the frame as with BORDER_REFLECT_101: -1 is 1, n is n - 2
+    int reflectIndex(int index, int size)
+    {
+        if (size == 1)
+        {
+            return 0;
+        }
+
+        while (index < 0 || index >= size)
+        {
+            index = index < 0 ? -index : 2 * (size - 1) - index;
+        }
+        return index;
+    }
+}
+
+const char *getPrefilterName(PrefilterType type)
+{
+    switch (type)
+    {
+    case PREFILTER_FIXED_GAUSSIAN:
+        return "fixed-gaussian";
+    case PREFILTER_BOX:
+        return "box";
+    case PREFILTER_NONE:
+        return "none";
+    default:
+        return "gaussian";
+    }
+}
+
+Prefilter::Prefilter(PrefilterType type, double sigma, int kernelSize)
+{
+    this->type = type;
+    this->sigma = sigma;
+
+    // The size GaussianBlur derives for 8-bit images
+    this->kernelSize = kernelSize > 0 ? kernelSize : cvRound(sigma * 3 * 2 + 1) | 1;
+
+    // Rounding error goes to the centre weight, so the weights sum to exactly 1
+    const int radius = this->kernelSize / 2;
+    vector<double> gaussian(this->kernelSize);
+    double sum = 0;
+    for (int i = 0; i < this->kernelSize; i++)
+    {
+        gaussian[i] = exp(-(i - radius) * (i - radius) / (2 * sigma * sigma));
+        sum += gaussian[i];
+    }
+
+    this->weights.resize(this->kernelSize);
+    int total = 0;
+    for (int i = 0; i < this->kernelSize; i++)
+    {
+        this->weights[i] = cvRound(gaussian[i] / sum * 256);
+        total += this->weights[i];
+    }
+    this->weights[radius] += 256 - total;
+
+    // A box of width w has the variance (w^2 - 1) / 12
+    this->boxSize = 2 * cvRound((sqrt(12 * sigma * sigma + 1) - 1) / 2) + 1;
+}
+
+PrefilterType Prefilter::getType() const
+{
+    return this->type;
+}
+
+bool Prefilter::isRowParallel() const
+{
+    return this->type == PREFILTER_FIXED_GAUSSIAN;
+}
+
+void Prefilter::allocate(PrefilterRows &rows, int cols) const
+{
+    rows.sums.resize(static_cast<size_t>(cols + 2 * (this->kernelSize / 2)) * 3);
+    rows.accumulators.resize(static_cast<size_t>(cols) * 3);
+}
+
+void Prefilter::applyFrame(const Mat &frame, Mat &filtered) const
+{
+    switch (this->type)
+    {
+    case PREFILTER_GAUSSIAN:
+        GaussianBlur(frame, filtered, Size(this->kernelSize, this->kernelSize), this->sigma, this->sigma);
+        break;
+    case PREFILTER_BOX:
+        if (this->boxSize > 1)
+        {
+            blur(frame, filtered, Size(this->boxSize, this->boxSize));
+        }
+        else
+        {
+            frame.copyTo(filtered);
+        }
+        break;
+    case PREFILTER_FIXED_GAUSSIAN:
+    {
+        PrefilterRows rows;
+        this->allocate(rows, frame.cols);
+        filtered.create(frame.rows, frame.cols, CV_8UC3);
+        this->applyFixedGaussian(frame, filtered, Range(0, frame.rows), rows);
+        break;
+    }
+    default:
+        frame.copyTo(filtered);
+        break;
+    }
+}
+
+void Prefilter::apply(const Mat &frame, Mat &filtered, const Range &range, PrefilterRows &rows) const
+{
+    // Headers on the rows, without BORDER_ISOLATED OpenCV reads past them into the frame
+    const Mat source = frame.rowRange(range);
+    Mat output = filtered.rowRange(range);
+    switch (this->type)
+    {
+    case PREFILTER_GAUSSIAN:
+        GaussianBlur(source, output, Size(this->kernelSize, this->kernelSize), this->sigma, this->sigma);
+        break;
+    case PREFILTER_BOX:
+        if (this->boxSize > 1)
+        {
+            blur(source, output, Size(this->boxSize, this->boxSize));
+        }
+        else
+        {
+            source.copyTo(output);
+        }
+        break;
+    case PREFILTER_FIXED_GAUSSIAN:
+        this->applyFixedGaussian(frame, filtered, range, rows);
+        break;
+    default:
+        source.copyTo(output);
+        break;
+    }
+}
+
+void Prefilter::applyFixedGaussian(const Mat &frame, Mat &filtered, const Range &range, PrefilterRows &rows) const
+{
+    const int cols = frame.cols;
+    const int width = cols * 3;
+    const int radius = this->kernelSize / 2;
+    const int *weights = this->weights.data();
+    ushort *sums = rows.sums.data() + radius * 3;
+    unsigned int *accumulators = rows.accumulators.data();
+
+    for (int i = range.start; i < range.end; i++)
+    {
+        // Vertical pass, at most 255 * 256 per column
+        const uchar *source = frame.ptr<uchar>(reflectIndex(i - radius, frame.rows));
+        int weight = weights[0];
+        for (int k = 0; k < width; k++)
+        {
+            sums[k] = static_cast<ushort>(weight * source[k]);
+        }
+        for (int t = 1; t < this->kernelSize; t++)
+        {
+            source = frame.ptr<uchar>(reflectIndex(i - radius + t, frame.rows));
+            weight = weights[t];
+            for (int k = 0; k < width; k++)
+            {
+                sums[k] = static_cast<ushort>(sums[k] + weight * source[k]);
+            }
+        }
+
+        for (int p = 1; p <= radius; p++)
+        {
+            int left = reflectIndex(-p, cols);
+            int right = reflectIndex(cols - 1 + p, cols);
+            for (int c = 0; c < 3; c++)
+            {
+                sums[-p * 3 + c] = sums[left * 3 + c];
+                sums[(cols - 1 + p) * 3 + c] = sums[right * 3 + c];
+            }
+        }
+
+        // Horizontal pass over pixels of the same channel, then back to 8 bits with rounding
+        const ushort *shifted = sums - radius * 3;
+        weight = weights[0];
+        for (int k = 0; k < width; k++)
+        {
+            accumulators[k] = weight * shifted[k];
+        }
+        for (int t = 1; t < this->kernelSize; t++)
+        {
+            shifted = sums + (t - radius) * 3;
+            weight = weights[t];
+            for (int k = 0; k < width; k++)
+            {
+                accumulators[k] += weight * shifted[k];
+            }
+        }
+
+        uchar *output = filtered.ptr<uchar>(i);
+        for (int k = 0; k < width; k++)
+        {
+            output[k] = static_cast<uchar>((accumulators[k] + (1 << 15)) >> 16);
+        }
+    }
+}
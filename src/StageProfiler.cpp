@@ -0,0 +1,255 @@
+#include "../include/StageProfiler.h"
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <opencv2/opencv.hpp>
+
+using namespace cv;
+using namespace std;
+
+void LatencyHistogram::record(double seconds)
+{
+    double microseconds = seconds * 1e6;
+    int bucket = microseconds > 1 ? static_cast<int>(log2(microseconds) * bucketsPerOctave) : 0;
+    bucket = min(bucket, numberOfBuckets - 1);
+
+    this->buckets[bucket]++;
+    this->count++;
+    this->total += seconds;
+    this->maximum = max(this->maximum, seconds);
+}
+
+double LatencyHistogram::getPercentile(double percentile) const
+{
+    if (this->count == 0)
+    {
+        return 0;
+    }
+
+    unsigned long rank = max(1ul, static_cast<unsigned long>(ceil(percentile / 100 * this->count)));
+    unsigned long cumulative = 0;
+    for (int i = 0; i < numberOfBuckets; i++)
+    {
+        cumulative += this->buckets[i];
+        if (cumulative >= rank)
+        {
+            double centre = exp2((i + 0.5) / bucketsPerOctave) * 1e-6;
+            return min(centre, this->maximum);
+        }
+    }
+
+    return this->maximum;
+}
+
+unsigned long LatencyHistogram::getCount() const
+{
+    return this->count;
+}
+
+double LatencyHistogram::getMean() const
+{
+    return this->count > 0 ? this->total / this->count : 0;
+}
+
+double LatencyHistogram::getMaximum() const
+{
+    return this->maximum;
+}
+
+void LatencyHistogram::reset()
+{
+    *this = LatencyHistogram();
+}
+
+namespace
+{
+    // Statistics of the frames since the last export, read under the profiler lock
+    struct ProfileWindow
+    {
+        const LatencyHistogram *stages;
+        unsigned long frames;
+        unsigned long totalFrames;
+        double foregroundFraction;
+        double unmatchedFraction;
+        double skippedBlockFraction;
+    };
+
+    string formatJSON(const ProfileWindow &window)
+    {
+        ostringstream out;
+        out << "{\"frame\": " << window.totalFrames << ", \"frames\": " << window.frames
+            << ", \"foreground_fraction\": " << window.foregroundFraction
+            << ", \"unmatched_fraction\": " << window.unmatchedFraction
+            << ", \"skipped_block_fraction\": " << window.skippedBlockFraction << ", \"stages\": {";
+        for (int i = 0; i < NUMBER_OF_PROFILE_STAGES; i++)
+        {
+            const LatencyHistogram &stage = window.stages[i];
+            out << (i > 0 ? ", " : "") << "\"" << StageProfiler::getStageName(static_cast<ProfileStage>(i)) << "\": {"
+                << "\"count\": " << stage.getCount() << ", \"mean_ms\": " << stage.getMean() * 1e3
+                << ", \"p50_ms\": " << stage.getPercentile(50) * 1e3 << ", \"p95_ms\": " << stage.getPercentile(95) * 1e3
+                << ", \"p99_ms\": " << stage.getPercentile(99) * 1e3 << ", \"max_ms\": " << stage.getMaximum() * 1e3 << "}";
+        }
+        out << "}}";
+        return out.str();
+    }
+
+    string formatCSV(const ProfileWindow &window, bool header)
+    {
+        ostringstream out;
+        if (header)
+        {
+            out << "frame,frames,stage,count,mean_ms,p50_ms,p95_ms,p99_ms,max_ms,foreground_fraction,unmatched_fraction,skipped_block_fraction\n";
+        }
+        for (int i = 0; i < NUMBER_OF_PROFILE_STAGES; i++)
+        {
+            const LatencyHistogram &stage = window.stages[i];
+            out << window.totalFrames << "," << window.frames << "," << StageProfiler::getStageName(static_cast<ProfileStage>(i)) << ","
+                << stage.getCount() << "," << stage.getMean() * 1e3 << "," << stage.getPercentile(50) * 1e3 << ","
+                << stage.getPercentile(95) * 1e3 << "," << stage.getPercentile(99) * 1e3 << "," << stage.getMaximum() * 1e3 << ","
+                << window.foregroundFraction << "," << window.unmatchedFraction << "," << window.skippedBlockFraction << "\n";
+        }
+        return out.str();
+    }
+}
+
+const char *StageProfiler::getStageName(ProfileStage stage)
+{
+    switch (stage)
+    {
+    case PROFILE_CAPTURE:
+        return "capture";
+    case PROFILE_BLUR:
+        return "blur";
+    case PROFILE_MIXTURE_UPDATE:
+        return "mixture_update";
+    case PROFILE_MASK_REFINEMENT:
+        return "mask_refinement";
+    case PROFILE_SHADOW_TEST:
+        return "shadow_test";
+    case PROFILE_MORPHOLOGY:
+        return "morphology";
+    case PROFILE_CONTOUR_CLEANING:
+        return "contour_cleaning";
+    case PROFILE_FUSED_TILES:
+        return "fused_tiles";
+    default:
+        return "unknown";
+    }
+}
+
+void StageProfiler::setExport(const string &exportPath, unsigned long exportInterval)
+{
+    lock_guard<mutex> guard(this->lock);
+    lock_guard<mutex> exportGuard(this->exportLock);
+    this->exportPath = exportPath;
+    this->exportInterval = exportInterval;
+    this->exportJSON = exportPath.size() >= 5 && exportPath.compare(exportPath.size() - 5, 5, ".json") == 0;
+    this->isHeaderWritten = false;
+
+    // The file stays open for the run, its first export replaces the previous contents
+    this->exportFile.close();
+    if (!exportPath.empty())
+    {
+        this->exportFile.open(exportPath, ios::trunc);
+    }
+}
+
+void StageProfiler::recordStage(ProfileStage stage, double seconds)
+{
+    lock_guard<mutex> guard(this->lock);
+    this->stages[stage].record(seconds);
+}
+
+void StageProfiler::recordUpdate(unsigned long long pixels, unsigned long long unmatchedPixels)
+{
+    lock_guard<mutex> guard(this->lock);
+    this->updatedPixels += pixels;
+    this->unmatchedPixels += unmatchedPixels;
+}
+
+void StageProfiler::recordGate(unsigned long long blocks, unsigned long long skippedBlocks)
+{
+    lock_guard<mutex> guard(this->lock);
+    this->gatedBlocks += blocks;
+    this->skippedBlocks += skippedBlocks;
+}
+
+void StageProfiler::recordFrame(unsigned long long pixels, unsigned long long foregroundPixels)
+{
+    unique_lock<mutex> guard(this->lock);
+    this->frames++;
+    this->totalFrames++;
+    this->pixels += pixels;
+    this->foregroundPixels += foregroundPixels;
+
+    if (this->exportInterval > 0 && this->frames >= this->exportInterval)
+    {
+        this->exportWindow(guard);
+    }
+}
+
+void StageProfiler::flush()
+{
+    unique_lock<mutex> guard(this->lock);
+    if (this->frames > 0)
+    {
+        this->exportWindow(guard);
+    }
+}
+
+void StageProfiler::exportWindow(unique_lock<mutex> &guard)
+{
+    // The window is formatted and cleared under the lock, but written after it is released
+    string text;
+    if (!this->exportPath.empty())
+    {
+        text = this->format(this->exportJSON, !this->isHeaderWritten);
+        if (this->exportJSON)
+        {
+            text += "\n";
+        }
+        this->isHeaderWritten = true;
+    }
+
+    for (LatencyHistogram &stage : this->stages)
+    {
+        stage.reset();
+    }
+    this->frames = 0;
+    this->pixels = 0;
+    this->foregroundPixels = 0;
+    this->updatedPixels = 0;
+    this->unmatchedPixels = 0;
+    this->gatedBlocks = 0;
+    this->skippedBlocks = 0;
+
+    // The export lock is taken before the lock is released, so windows reach the file in order
+    lock_guard<mutex> exportGuard(this->exportLock);
+    guard.unlock();
+    if (!text.empty())
+    {
+        this->exportFile << text;
+        this->exportFile.flush();
+    }
+}
+
+string StageProfiler::format(bool json, bool header) const
+{
+    ProfileWindow window = {this->stages, this->frames, this->totalFrames,
+                            this->pixels > 0 ? static_cast<double>(this->foregroundPixels) / this->pixels : 0,
+                            this->updatedPixels > 0 ? static_cast<double>(this->unmatchedPixels) / this->updatedPixels : 0,
+                            this->gatedBlocks > 0 ? static_cast<double>(this->skippedBlocks) / this->gatedBlocks : 0};
+    return json ? formatJSON(window) : formatCSV(window, header);
+}
+
+string StageProfiler::toJSON() const
+{
+    lock_guard<mutex> guard(this->lock);
+    return this->format(true, false);
+}
+
+string StageProfiler::toCSV() const
+{
+    lock_guard<mutex> guard(this->lock);
+    return this->format(false, true);
+}
@@ -0,0 +1,110 @@
+#include "../include/StreamHost.h"
+#include <opencv2/opencv.hpp>
+
+using namespace cv;
+using namespace std;
+
+StreamHost::StreamHost(int numberOfThreads)
+    : pool(numberOfThreads)
+{
+}
+
+void StreamHost::addStream(const string &name, AGMM &agmm, TaskPriority priority, const function<bool()> &start, const function<bool(const Mat &, const Mat &, const vector<Blob> &)> &consume)
+{
+    agmm.setNumberOfThreads(this->pool.getNumberOfThreads());
+    agmm.setThreadPool(&this->pool, priority);
+
+    unique_ptr<Stream> stream(new Stream());
+    stream->name = name;
+    stream->agmm = &agmm;
+    stream->priority = priority;
+    stream->start = start;
+    stream->consume = consume;
+    stream->stats = {name, priority, 0, 0, 0, 0};
+    stream->totalFrameTime = 0;
+    this->streams.push_back(move(stream));
+}
+
+void StreamHost::run()
+{
+    this->startTicks = getTickCount();
+    {
+        lock_guard<mutex> guard(this->runningLock);
+        this->runningStreams = this->streams.size();
+    }
+
+    for (unique_ptr<Stream> &stream : this->streams)
+    {
+        Stream *started = stream.get();
+        this->pool.submit([this, started]()
+                          { this->startStream(*started); },
+                          stream->priority);
+    }
+
+    unique_lock<mutex> lock(this->runningLock);
+    this->finished.wait(lock, [this]()
+                        { return this->runningStreams == 0; });
+}
+
+void StreamHost::startStream(Stream &stream)
+{
+    if (!stream.start())
+    {
+        this->finishStream(stream);
+        return;
+    }
+
+    this->processFrame(stream);
+}
+
+void StreamHost::processFrame(Stream &stream)
+{
+    int64 frameTicks = getTickCount();
+    if (!stream.agmm->readFrame(stream.frame) || !stream.agmm->processFrame(stream.frame, stream.mask, stream.result, &stream.blobs))
+    {
+        this->finishStream(stream);
+        return;
+    }
+
+    double frameTime = (getTickCount() - frameTicks) * 1000 / getTickFrequency();
+    stream.stats.frames++;
+    stream.totalFrameTime += frameTime;
+    stream.stats.maximumFrameTime = max(stream.stats.maximumFrameTime, frameTime);
+
+    if (!stream.consume(stream.frame, stream.mask, stream.blobs))
+    {
+        this->finishStream(stream);
+        return;
+    }
+
+    // The next frame queues behind the waiting frames of other streams of the same priority
+    Stream *next = &stream;
+    this->pool.submit([this, next]()
+                      { this->processFrame(*next); },
+                      stream.priority);
+}
+
+void StreamHost::finishStream(Stream &stream)
+{
+    stream.stats.seconds = (getTickCount() - this->startTicks) / getTickFrequency();
+    stream.stats.meanFrameTime = stream.stats.frames > 0 ? stream.totalFrameTime / stream.stats.frames : 0;
+
+    lock_guard<mutex> guard(this->runningLock);
+    this->runningStreams--;
+    this->finished.notify_all();
+}
+
+vector<StreamStats> StreamHost::getStats() const
+{
+    vector<StreamStats> stats;
+    for (const unique_ptr<Stream> &stream : this->streams)
+    {
+        stats.push_back(stream->stats);
+    }
+    return stats;
+}
+
+int StreamHost::getNumberOfThreads() const
+{
+    return this->pool.getNumberOfThreads();
+}
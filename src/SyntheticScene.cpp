@@ -0,0 +1,123 @@
+#include "../include/SyntheticScene.h"
+#include <opencv2/opencv.hpp>
+
+using namespace cv;
+using namespace std;
+
+SyntheticScene::SyntheticScene(int rows, int cols, uint64 seed, const SyntheticSceneParameters &parameters)
+    : rows(rows), cols(cols), parameters(parameters), rng(seed)
+{
+    // Backdrop: smooth colour gradients with blurred random texture on top, so the
+    // model sees both flat and detailed regions
+    this->backdrop.create(rows, cols, CV_8UC3);
+    for (int i = 0; i < rows; i++)
+    {
+        Vec3b *row = this->backdrop.ptr<Vec3b>(i);
+        double y = static_cast<double>(i) / rows;
+        for (int j = 0; j < cols; j++)
+        {
+            double x = static_cast<double>(j) / cols;
+            row[j] = Vec3b(saturate_cast<uchar>(70 + 50 * x + 20 * sin(9 * y)),
+                           saturate_cast<uchar>(90 + 40 * y + 20 * sin(7 * x)),
+                           saturate_cast<uchar>(110 + 30 * (1 - x) * y));
+        }
+    }
+
+    Mat texture(rows, cols, CV_8UC3);
+    this->rng.fill(texture, RNG::UNIFORM, Scalar::all(0), Scalar::all(60));
+    GaussianBlur(texture, texture, Size(0, 0), 1.5);
+    this->backdrop += texture;
+    this->backdrop -= Scalar::all(30);
+
+    double radius = parameters.blobRadius * rows;
+    double speed = parameters.blobSpeed * cols;
+    for (int i = 0; i < parameters.numberOfBlobs; i++)
+    {
+        Blob blob;
+        blob.position = Point2d(this->rng.uniform(0.0, static_cast<double>(cols)), this->rng.uniform(0.0, static_cast<double>(rows)));
+        double direction = this->rng.uniform(0.0, 2 * CV_PI);
+        double magnitude = speed * this->rng.uniform(0.5, 1.5);
+        blob.velocity = Point2d(magnitude * cos(direction), magnitude * sin(direction));
+        blob.axes = Size(max(1, cvRound(radius * this->rng.uniform(0.7, 1.3))), max(1, cvRound(radius * this->rng.uniform(1.0, 2.0))));
+        blob.angle = this->rng.uniform(0.0, 180.0);
+        blob.color = Scalar(this->rng.uniform(0, 256), this->rng.uniform(0, 256), this->rng.uniform(0, 256));
+        this->blobs.push_back(blob);
+    }
+}
+
+void SyntheticScene::nextFrame(Mat &frame, Mat *groundTruth)
+{
+    const SyntheticSceneParameters &p = this->parameters;
+
+    double gain = 1 + p.lightingDrift * sin(2 * CV_PI * this->frameIndex / p.lightingPeriod);
+    this->backdrop.convertTo(frame, CV_8UC3, gain);
+
+    // Shadows are cast down and to the right of each blob, drawn first so blobs cover them
+    this->shadowMask.create(this->rows, this->cols, CV_8U);
+    this->shadowMask.setTo(Scalar(0));
+    for (const Blob &blob : this->blobs)
+    {
+        Point centre(cvRound(blob.position.x + 0.5 * blob.axes.width), cvRound(blob.position.y + 0.4 * blob.axes.height));
+        ellipse(this->shadowMask, centre, blob.axes, blob.angle, 0, 360, Scalar(255), FILLED);
+    }
+    frame.convertTo(this->shadedFrame, CV_8UC3, p.shadowStrength);
+    this->shadedFrame.copyTo(frame, this->shadowMask);
+
+    if (groundTruth != nullptr)
+    {
+        groundTruth->create(this->rows, this->cols, CV_8U);
+        groundTruth->setTo(Scalar(0));
+    }
+
+    for (const Blob &blob : this->blobs)
+    {
+        Point centre(cvRound(blob.position.x), cvRound(blob.position.y));
+        ellipse(frame, centre, blob.axes, blob.angle, 0, 360, blob.color * gain, FILLED);
+        if (groundTruth != nullptr)
+        {
+            ellipse(*groundTruth, centre, blob.axes, blob.angle, 0, 360, Scalar(255), FILLED);
+        }
+    }
+
+    if (p.noiseSigma > 0)
+    {
+        this->noise.create(this->rows, this->cols, CV_16SC3);
+        this->rng.fill(this->noise, RNG::NORMAL, Scalar::all(0), Scalar::all(p.noiseSigma));
+        frame.convertTo(this->noisyFrame, CV_16SC3);
+        this->noisyFrame += this->noise;
+        this->noisyFrame.convertTo(frame, CV_8UC3);
+    }
+
+    // Blobs bounce off the borders
+    for (Blob &blob : this->blobs)
+    {
+        blob.position += blob.velocity;
+        if (blob.position.x < 0 || blob.position.x >= this->cols)
+        {
+            blob.velocity.x = -blob.velocity.x;
+            blob.position.x = min(max(blob.position.x, 0.0), this->cols - 1.0);
+        }
+        if (blob.position.y < 0 || blob.position.y >= this->rows)
+        {
+            blob.velocity.y = -blob.velocity.y;
+            blob.position.y = min(max(blob.position.y, 0.0), this->rows - 1.0);
+        }
+    }
+
+    this->frameIndex++;
+}
+
+int SyntheticScene::getRows() const
+{
+    return this->rows;
+}
+
+int SyntheticScene::getCols() const
+{
+    return this->cols;
+}
+
+unsigned long SyntheticScene::getFrameIndex() const
+{
+    return this->frameIndex;
+}
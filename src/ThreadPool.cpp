@@ -0,0 +1,214 @@
+#include "../include/ThreadPool.h"
+#include <opencv2/opencv.hpp>
+
+using namespace cv;
+using namespace std;
+
+namespace
+{
+    // The pool the current thread works for, and its index there
+    thread_local const ThreadPool *currentPool = nullptr;
+    thread_local int currentWorker = -1;
+}
+
+ThreadPool::ThreadPool(int numberOfThreads)
+{
+    if (numberOfThreads <= 0)
+    {
+        numberOfThreads = max(1u, thread::hardware_concurrency());
+    }
+
+    for (int i = 0; i < numberOfThreads; i++)
+    {
+        this->workers.push_back(unique_ptr<Worker>(new Worker()));
+    }
+    for (int i = 0; i < numberOfThreads; i++)
+    {
+        this->threads.emplace_back(&ThreadPool::runWorker, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        lock_guard<mutex> guard(this->sleepLock);
+        this->stopping = true;
+    }
+    this->wakeUp.notify_all();
+
+    for (thread &t : this->threads)
+    {
+        t.join();
+    }
+}
+
+int ThreadPool::getNumberOfThreads() const
+{
+    return static_cast<int>(this->workers.size());
+}
+
+int ThreadPool::getCurrentWorker() const
+{
+    return currentPool == this ? currentWorker : -1;
+}
+
+void ThreadPool::push(Task &&task, TaskPriority priority)
+{
+    // A worker keeps its tasks, other threads spread theirs so idle workers start at once
+    int index = this->getCurrentWorker();
+    if (index < 0)
+    {
+        index = this->nextWorker++ % this->workers.size();
+    }
+
+    Worker &worker = *this->workers[index];
+    {
+        lock_guard<mutex> guard(worker.lock);
+        if (task.group != nullptr)
+        {
+            worker.tiles[priority].push_back(move(task));
+        }
+        else
+        {
+            worker.jobs[priority].push_back(move(task));
+        }
+    }
+
+    this->pendingTasks++;
+    {
+        // Taken so a worker cannot miss the task between its check and its wait
+        lock_guard<mutex> guard(this->sleepLock);
+    }
+    this->wakeUp.notify_one();
+}
+
+void ThreadPool::submit(const function<void()> &job, TaskPriority priority)
+{
+    Task task;
+    task.job = job;
+    this->push(move(task), priority);
+}
+
+bool ThreadPool::pop(bool tile, Task &task)
+{
+    int self = this->getCurrentWorker();
+    int count = static_cast<int>(this->workers.size());
+
+    for (int priority = numberOfPriorities - 1; priority >= 0; priority--)
+    {
+        // Own tiles newest first, while their data is still in the cache, jobs in order.
+        // Other workers give up their oldest task.
+        for (int i = 0; i < count; i++)
+        {
+            int index = self >= 0 ? (self + i) % count : i;
+            Worker &worker = *this->workers[index];
+            lock_guard<mutex> guard(worker.lock);
+
+            deque<Task> &queue = tile ? worker.tiles[priority] : worker.jobs[priority];
+            if (queue.empty())
+            {
+                continue;
+            }
+
+            if (index == self && tile)
+            {
+                task = move(queue.back());
+                queue.pop_back();
+            }
+            else
+            {
+                task = move(queue.front());
+                queue.pop_front();
+            }
+            this->pendingTasks--;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ThreadPool::runTask(Task &task)
+{
+    if (task.group != nullptr)
+    {
+        task.group->invoke(task.group->body, task.range);
+        task.group->remaining--;
+    }
+    else
+    {
+        task.job();
+    }
+}
+
+void ThreadPool::runWorker(int index)
+{
+    currentPool = this;
+    currentWorker = index;
+
+    Task task;
+    while (true)
+    {
+        // Tiles first, a job is waiting for them
+        if (this->pop(true, task) || this->pop(false, task))
+        {
+            this->runTask(task);
+            task = Task();
+            continue;
+        }
+
+        unique_lock<mutex> lock(this->sleepLock);
+        this->wakeUp.wait(lock, [this]()
+                          { return this->stopping || this->pendingTasks > 0; });
+        if (this->stopping && this->pendingTasks <= 0)
+        {
+            return;
+        }
+    }
+}
+
+void ThreadPool::runTiles(TileGroup &group, const Range &range, int numberOfTiles, TaskPriority priority)
+{
+    int length = range.end - range.start;
+    int tiles = min(max(numberOfTiles, 1), length);
+    if (tiles <= 1)
+    {
+        if (length > 0)
+        {
+            group.invoke(group.body, range);
+        }
+        return;
+    }
+
+    auto getTile = [&](int tile)
+    {
+        return Range(range.start + static_cast<int>(static_cast<int64>(length) * tile / tiles),
+                     range.start + static_cast<int>(static_cast<int64>(length) * (tile + 1) / tiles));
+    };
+
+    group.remaining = tiles;
+    for (int tile = 1; tile < tiles; tile++)
+    {
+        Task task;
+        task.group = &group;
+        task.range = getTile(tile);
+        this->push(move(task), priority);
+    }
+
+    group.invoke(group.body, getTile(0));
+    group.remaining--;
+
+    // Tiles are short, so the wait spins and helps with whatever tiles are waiting
+    Task task;
+    while (group.remaining > 0)
+    {
+        if (this->pop(true, task))
+        {
+            this->runTask(task);
+        }
+        else
+        {
+            this_thread::yield();
+        }
+    }
+}